@@ -3,8 +3,11 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+#include <functional>
 #include <SmaModbusLowLevel.hpp>
 #include <SmaModbusValue.hpp>
+#include <SmaModbusDeviceLimits.hpp>
 
 namespace libsmamodbus {
 
@@ -25,6 +28,7 @@ namespace libsmamodbus {
             RW = 0x03   //!< Read-write
         };
         static std::string toString(const AccessMode& mode);
+        static const char* toName(const AccessMode& mode);          //!< same as toString(mode), without heap allocation
 
         /**
          *  Enumeration for additional SMA modbus register related information
@@ -36,6 +40,7 @@ namespace libsmamodbus {
             CyclicWritingWarning   = 0x04   //<! cyclic writes will destroy the underlying memory cells
         };
         static std::string toString(const Category& category);
+        static const char* toName(const Category& category);    //!< same as toString(category), without heap allocation
 
         /**
          *  Class encapsulating all relevant information for a given SMA modbus registers.
@@ -58,6 +63,105 @@ namespace libsmamodbus {
                 addr(address), size(numwords), type(dtype), format(fmt), mode(access), category(cat), identifier(id), description(descr) {}
 
             std::string toString(void) const;
+
+            /**
+             *  Write the same representation as toString() to the given buffer, without heap allocations.
+             *  Like snprintf, the output is truncated to size - 1 characters and always null-terminated.
+             *  @return the number of characters written, excluding the terminating '\0' character
+             */
+            size_t toChars(char* buffer, size_t size) const;
+        };
+
+        /**
+         *  Class describing a single modbus read request covering one or more registers of a read plan.
+         */
+        class ReadBlock {
+        public:
+            SmaModbusUnitID unitID;     //!< Modbus unit id
+            uint16_t addr;              //!< Modbus address of the first word
+            uint16_t size;              //!< Number of 16-bit words, including any gaps between registers
+            size_t first;               //!< Index of the first register in ReadPlan::order
+            size_t count;               //!< Number of registers covered by this block
+            ReadBlock(SmaModbusUnitID unit_id, uint16_t address, uint16_t numwords, size_t first_index, size_t num_registers) :
+                unitID(unit_id), addr(address), size(numwords), first(first_index), count(num_registers) {}
+        };
+
+        /**
+         *  Class providing lazy access to the raw words of a register, without decoding or copying them in advance.
+         *  A view does not own the words; it is valid as long as the underlying buffer, e.g. the words of a ReadPlan, is not modified.
+         */
+        class RawRegisterView {
+        protected:
+            const RegisterDefinition* reg;  //!< Register definition
+            const uint16_t* words;          //!< Raw words of the register, NULL if the register could not be read
+
+        public:
+            /** Constructor; pass NULL words for a register that could not be read. */
+            RawRegisterView(const RegisterDefinition& definition, const uint16_t* raw_words) : reg(&definition), words(raw_words) {}
+
+            /** Get the register definition. */
+            const RegisterDefinition& getRegister(void) const { return *reg; }
+
+            /** Get the raw words of the register, NULL if the register could not be read. */
+            const uint16_t* getWords(void) const { return words; }
+
+            /** Get the number of raw words of the register. */
+            size_t getNumWords(void) const { return (words != NULL ? reg->size : 0); }
+
+            /** Check if the register could be read and holds a numeric data type with at most 4 words. */
+            bool isNumeric(void) const {
+                return words != NULL && reg->type != DataType::STR32 && reg->type != DataType::INVALID && reg->size * 2u <= sizeof(uint64_t);
+            }
+
+            /** Get the numeric bit pattern with leading zeroes, 0 for non-numeric registers. */
+            uint64_t u64(void) const { return (isNumeric() ? SmaModbusValue::joinWords(words, reg->size) : 0); }
+
+            /** Check if the value is valid; see SmaModbusValue::isValid(). */
+            bool isValid(void) const { return isNumeric() && SmaModbusValue::isValid(u64(), reg->type); }
+
+            /** Convert numeric value to floating point; see SmaModbusValue::toDouble(). */
+            double toDouble(void) const { return (isNumeric() ? SmaModbusValue::toDouble(u64(), reg->type, reg->format) : SmaModbusValue::Double_NaN); }
+
+            /** Get the string value of STR32 registers, an empty string otherwise. */
+            std::string str(void) const { return (words != NULL && reg->type == DataType::STR32 ? SmaModbusValue::joinString(words, reg->size) : std::string()); }
+
+            /** Convert value to a string representation; see SmaModbusValue::toString(). */
+            std::string toString(void) const { return toValue().toString(); }
+
+            /** Decode the register into a value object; registers that could not be read result in DataType::INVALID values. */
+            SmaModbusValue toValue(void) const {
+                if (isNumeric()) {
+                    return SmaModbusValue(u64(), reg->type, reg->format);
+                }
+                if (words != NULL && reg->type == DataType::STR32) {
+                    return SmaModbusValue(str(), reg->type, reg->format);
+                }
+                return SmaModbusValue();
+            }
+        };
+
+        /**
+         *  Class holding a set of registers together with the block requests used to read them.
+         *  Blocks are split automatically, whenever the device rejects a block with an IllegalDataAddress exception.
+         *  The raw words of all registers are kept in a single buffer, which is reused by each poll.
+         */
+        class ReadPlan {
+        public:
+            std::vector<RegisterDefinition> registers;  //!< Registers in the order given by the caller
+            std::vector<SmaModbusUnitID> unitIDs;       //!< Unit id of each register, in the order of registers
+            std::vector<size_t> order;                  //!< Register indices sorted by unit id and modbus address
+            std::vector<ReadBlock> blocks;              //!< Block requests sorted by unit id and modbus address
+            std::vector<uint16_t> words;                //!< Raw words of all registers, in the order of registers
+            std::vector<size_t> offsets;                //!< Offset of each register in words
+            std::vector<bool> valid;                    //!< Flag for each register, indicating if the last poll succeeded
+
+            /**
+             *  Get a view of the raw words of the given register from the last poll.
+             *  @param index register index in the order of registers
+             */
+            RawRegisterView getView(size_t index) const {
+                return RawRegisterView(registers[index], (valid[index] ? &words[offsets[index]] : NULL));
+            }
         };
 
 
@@ -75,7 +179,7 @@ namespace libsmamodbus {
         SmaModbusValue readRegister(const RegisterDefinition& reg, bool print = false);
 
         /**
-         *  Write SMA modbus register.
+         *  Write SMA modbus register; device control objects are written with Control priority, see SmaModbusArbiter.
          *  @param reg the SMA modbus register definition
          *  @param value the value object holding the value itself and associated metadata
          *  @return true if successful, false otherwise
@@ -85,6 +189,170 @@ namespace libsmamodbus {
             return writeRegister(reg, SmaModbusValue(value, reg.type, reg.format), print);
         }
 
+        /**
+         *  Read a typed SMA modbus register; see SmaModbusRegister and SmaModbusRegisters.
+         *  Decoding is resolved at compile time from the register type.
+         *  @param value output parameter receiving the native register value; the SMA NaN value if the register cannot be read
+         *  @return true if the register was read and holds a valid value
+         */
+        template <typename Register>
+        bool read(typename Register::native_type& value) {
+            uint16_t words[Register::size];
+            SmaModbusException exception;
+            if (readWords(getUnitID(), Register::addr, words, Register::size, exception, false, true) != Register::size) {
+                value = Register::nan();
+                return false;
+            }
+            return Register::decode(words, value);
+        }
+
+        /**
+         *  Write a typed SMA modbus register; see SmaModbusRegister and SmaModbusRegisters.
+         *  Encoding is resolved at compile time from the register type. Device control objects are written with Control priority.
+         *  @param value the native register value
+         *  @return true if successful, false otherwise
+         */
+        template <typename Register>
+        bool write(const typename Register::native_type& value) {
+            static_assert(Register::mode != AccessMode::RO, "register is read-only");
+            uint16_t words[Register::size];
+            Register::encode(value, words);
+            SmaModbusArbiter::PriorityScope scope(getWritePriority(Register::category));
+            SmaModbusException exception;
+            return writeWords(getUnitID(), Register::addr, words, Register::size, exception, false, true);
+        }
+
+        /**
+         *  Create a plan to read the given registers with as few modbus requests as possible.
+         *  Registers are coalesced into blocks of up to SmaModbusFrame::MAX_READ_WORDS words, unless the learned device
+         *  limits indicate that a block would be rejected. Spans known to be readable are used regardless of max_gap.
+         *  @param registers the SMA modbus register definitions; all registers are read from the current unit id
+         *  @param max_gap maximum number of unused words between two registers of the same block, if the span is not known to be readable
+         *  @return the read plan
+         */
+        ReadPlan createReadPlan(const std::vector<RegisterDefinition>& registers, uint16_t max_gap = 125) {
+            return createReadPlan(registers, std::vector<SmaModbusUnitID>(registers.size(), getUnitID()), max_gap);
+        }
+
+        /**
+         *  Create a plan to read the given registers from several unit ids, e.g. plant totals from unit id 2 together with
+         *  the sma and sunspec registers of a device from unit ids 3 and 126. Blocks never span more than one unit id;
+         *  all blocks are read on the same connection, see readRegisters(ReadPlan&).
+         *  @param registers the SMA modbus register definitions
+         *  @param unit_ids the unit id of each register, in the order of registers
+         *  @param max_gap maximum number of unused words between two registers of the same block, if the span is not known to be readable
+         *  @return the read plan
+         */
+        ReadPlan createReadPlan(const std::vector<RegisterDefinition>& registers, const std::vector<SmaModbusUnitID>& unit_ids, uint16_t max_gap = 125);
+
+        /**
+         *  Read all registers of the given read plan.
+         *  All blocks are sent by a single call of SmaModbusLowLevel::readBlocks(), regardless of their unit ids; they are
+         *  pipelined if a pipeline window larger than 1 has been set with setPipelineWindow(), and sent one at a time otherwise.
+         *  Blocks rejected with an IllegalDataAddress exception are bisected and retried; the plan and the device limits
+         *  are updated accordingly, such that subsequent reads use the refined blocks.
+         *  @param plan the read plan
+         *  @return a value object for each register, in the order of ReadPlan::registers; failed reads return DataType::INVALID values
+         */
+        std::vector<SmaModbusValue> readRegisters(ReadPlan& plan);
+
+        /**
+         *  Read the raw words of all registers of the given read plan into the plan's word buffer, without decoding them.
+         *  Use ReadPlan::getView() to access the register values lazily. The requests are sent with Bulk priority, such that
+         *  reads and writes of other threads sharing the connection overtake a long poll, see SmaModbusArbiter.
+         *  @param plan the read plan
+         *  @return the number of registers read successfully
+         */
+        size_t pollRegisters(ReadPlan& plan);
+        std::vector<SmaModbusValue> readRegisters(const std::vector<RegisterDefinition>& registers) {
+            ReadPlan plan = createReadPlan(registers);
+            return readRegisters(plan);
+        }
+
+        /**
+         *  Get the device limits learned from block reads; they can be saved and loaded to preserve them across restarts.
+         *  @return the device limits
+         */
+        SmaModbusDeviceLimits& getDeviceLimits(void) { return limits; }
+        const SmaModbusDeviceLimits& getDeviceLimits(void) const { return limits; }
+
+        /**
+         *  Class holding the position and throughput of a register sweep. A sweep interrupted by the sink, by a request
+         *  limit or by a transport error continues at the cursor position, when the cursor is passed to sweepRegisters() again.
+         */
+        class SweepCursor {
+        public:
+            SmaModbusUnitID unitID;     //!< Modbus unit id
+            uint32_t next;              //!< Modbus address where the sweep continues
+            uint32_t end;               //!< Modbus address where the sweep ends, exclusive
+            uint64_t requests;          //!< Number of read requests sent so far
+            uint64_t wordsRead;         //!< Number of words read so far
+            uint64_t wordsRejected;     //!< Number of words rejected by the device with an IllegalDataAddress exception
+            double seconds;             //!< Accumulated sweep time in seconds
+            SweepCursor(SmaModbusUnitID unit_id, uint16_t first, uint32_t last) :
+                unitID(unit_id), next(first), end(last), requests(0), wordsRead(0), wordsRejected(0), seconds(0.0) {}
+
+            /** Check if the sweep has reached its end address. */
+            bool isDone(void) const { return next >= end; }
+
+            /** Get the number of words read or rejected per second. */
+            double getWordsPerSecond(void) const { return (seconds > 0.0 ? (double)(wordsRead + wordsRejected) / seconds : 0.0); }
+
+            /** Get the number of requests per second. */
+            double getRequestsPerSecond(void) const { return (seconds > 0.0 ? (double)requests / seconds : 0.0); }
+        };
+
+        /**
+         *  Sink receiving each run of readable words of a register sweep, in ascending address order.
+         *  The words are valid during the call only. Return false to interrupt the sweep.
+         */
+        typedef std::function<bool(SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* words, size_t num_words)> SweepSink;
+
+        /**
+         *  Sweep the address range of the given cursor and stream all readable words to the sink, e.g. to dump all registers
+         *  of a device for commissioning. The range is read in blocks of up to 124 words; blocks rejected with an
+         *  IllegalDataAddress exception are bisected down to single registers of 2 words, which are skipped if rejected.
+         *  As sma registers start at odd addresses, a sweep starting at an even address starts at the next odd address,
+         *  and a register starting right before the end address is read completely. Registers of the register catalog
+         *  starting at an even address, like Register40236(), are off this register grid; they are read on their own.
+         *  Memory use is constant, independent of the size of the range. The learned device limits are updated.
+         *  The requests are sent with Bulk priority, see pollRegisters().
+         *  @param cursor the sweep range and position; updated while sweeping
+         *  @param sink the sink receiving the readable words
+         *  @param max_requests maximum number of requests sent by this call, 0 for no limit; bisecting a rejected block
+         *  takes up to 6 requests, so smaller limits only make progress if the device limits are kept between calls
+         *  @return true if the sweep is complete, false if it has been interrupted
+         */
+        bool sweepRegisters(SweepCursor& cursor, const SweepSink& sink, uint64_t max_requests = 0);
+
+        /**
+         *  Sink receiving each register of the register catalog found by a register sweep, in ascending address order.
+         *  The view is valid during the call only. Return false to interrupt the sweep.
+         */
+        typedef std::function<bool(SmaModbusUnitID unit_id, const RawRegisterView& view)> SweepRegisterSink;
+
+        /**
+         *  Sweep the address range of the given cursor like sweepRegisters(), and pass each readable register of the
+         *  register catalog to the sink for decoding; words of registers not in the catalog are skipped.
+         *  @param cursor the sweep range and position; updated while sweeping
+         *  @param sink the sink receiving the registers
+         *  @param max_requests maximum number of requests sent by this call, 0 for no limit
+         *  @return true if the sweep is complete, false if it has been interrupted
+         */
+        bool sweepKnownRegisters(SweepCursor& cursor, const SweepRegisterSink& sink, uint64_t max_requests = 0);
+
+        /**
+         *  Get the register catalog, i.e. all register definitions below, sorted by modbus address.
+         *  @return the register definitions
+         */
+        static const std::vector<RegisterDefinition>& getRegisterCatalog(void);
+
+        /**
+         *  Find the register of the register catalog starting at the given modbus address.
+         *  @return the register definition, NULL if there is none
+         */
+        static const RegisterDefinition* findRegister(uint16_t addr);
+
         /**
          *  Set the default unit id to be used for readRegister and writeRegister.
          *  The default unit id is choose to be the first map entry of the device map, if it is between 1 and 255
@@ -164,6 +432,67 @@ namespace libsmamodbus {
          *  @return a value object holding the value itself and associated metadata
          */
         std::vector<SmaModbusDeviceEntry> getDeviceMap(void);
+
+        /**
+         *  Class holding the nameplate identity of a device.
+         */
+        class Nameplate {
+        public:
+            uint32_t susyID;            //!< Nameplate.SusyId, register 30003
+            uint32_t serialNumber;      //!< Nameplate.SerNum, register 30005
+            uint32_t mainModel;         //!< Nameplate.MainModel, register 30051
+            uint32_t model;             //!< Nameplate.Model, register 30053
+            uint32_t packageRevision;   //!< Nameplate.PkgRev, register 30059
+            Nameplate(void) : susyID(0), serialNumber(0), mainModel(0), model(0), packageRevision(0) {}
+        };
+
+        /**
+         *  Read the nameplate registers 30003 to 30059 of the current unit id.
+         *  @return the nameplate; registers that cannot be read are set to 0
+         */
+        Nameplate readNameplate(void);
+
+        /** Get the nameplate obtained by the last call to readNameplate or loadState. */
+        const Nameplate& getNameplate(void) const { return nameplate; }
+
+        /**
+         *  Save the discovered device state to the given file: the unit id, the device map, the nameplate,
+         *  the learned device limits and optionally the block requests of a read plan.
+         *  @param path file path
+         *  @param plan optional read plan, whose blocks are saved
+         *  @return true if successful
+         */
+        bool saveState(const std::string& path, const ReadPlan* plan = NULL) const;
+
+        /**
+         *  Load device state saved by saveState and validate it by a single read of the serial number register 30005.
+         *  Files written with a different STATE_VERSION are rejected; version 1 did not store the unit id of each register.
+         *  If the serial number matches, the unit id, device map, nameplate and device limits are restored, and the blocks of the given
+         *  read plan are replaced by the saved blocks, if the plan holds the same registers. The state is rejected, if these blocks
+         *  do not cover each register of the plan exactly once within the maximum read size. This avoids a device map scan through
+         *  setDefaultUnitID and the nameplate reads on startup.
+         *  @param path file path
+         *  @param plan optional read plan, whose blocks are restored
+         *  @param plan_restored optional output parameter, set to true if the blocks of the plan have been restored, and to
+         *  false otherwise, e.g. if the plan holds other registers than the saved plan; its blocks are kept then
+         *  @return true if the state was restored, false if the file cannot be read or describes a different device
+         */
+        bool loadState(const std::string& path, ReadPlan* plan = NULL, bool* plan_restored = NULL);
+
+        static const unsigned STATE_VERSION = 2;    //!< version of the state file format; files of other versions are rejected
+
+    protected:
+        SmaModbusDeviceLimits limits;   //!< address ranges learned to be readable or unreadable as a single block
+        std::vector<SmaModbusDeviceEntry> device_map;   //!< device map obtained by the last call to getDeviceMap or loadState
+        Nameplate nameplate;            //!< nameplate obtained by the last call to readNameplate or loadState
+
+        //!< read the raw words of all registers of the given read plan with the priority of the calling thread
+        size_t readPlan(ReadPlan& plan);
+
+        //!< get the priority used to write a register of the given category; control objects preempt polling reads
+        static SmaModbusArbiter::Priority getWritePriority(Category category) {
+            return (category == Category::DeviceControlObject ? SmaModbusArbiter::Priority::Control : SmaModbusArbiter::getThreadPriority());
+        }
     };
 
 }   // namespace libsmamodbus
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <string>
 #include <SmaModbus.hpp>
+#include <SmaModbusRegister.hpp>
 
 namespace libsmamodbus {
 
@@ -22,7 +23,7 @@ namespace libsmamodbus {
          * the mode switch  can be verified by event messages in the UI
          */
         bool setSelfConsumptionMode(void) {
-            bool result1 = writeRegister(Register40151(), 803);     // set external power control to inactive (803)
+            bool result1 = write<SmaModbusRegisters::Register40151>(803);     // set external power control to inactive (803)
             //bool result2 = writeRegister(Register40236(), 1438);    // set bms operation mode to automatic (1438)
             return result1/* && result2*/;
         }
@@ -34,8 +35,8 @@ namespace libsmamodbus {
          */
         bool setExternalPowerControlMode(double watts) {
             bool result = true;
-            result &= writeRegister(Register40151(), 802);          // set external power control to active (802), i.e. self-consumption becomes deactivated
-            result &= writeRegister(Register40149(), watts);        // set external power in watts, negative means charging, positive means discharging
+            result &= write<SmaModbusRegisters::Register40151>(802);          // set external power control to active (802), i.e. self-consumption becomes deactivated
+            result &= write<SmaModbusRegisters::Register40149>(SmaModbusRegisters::Register40149::fromDouble(watts));  // set external power in watts, negative means charging, positive means discharging
             //if (watts < 0) {    // force charge
             //    result &= writeRegister(Register40236(), 2289);     // set bms operation mode to charge (2289)
             //    result &= setBatteryPowerRange(-watts, -watts, 0.0, 0.0);
@@ -49,10 +50,11 @@ namespace libsmamodbus {
 
         bool setBatteryPowerRange(double min_charge_watts, double max_charge_watts, double min_discharge_watts, double max_discharge_watts) {
             bool result = true;
-            result &= writeRegister(Register40793(), min_charge_watts);     // set minimum battery charging power in watts
-            result &= writeRegister(Register40795(), max_charge_watts);     // set maximum battery charging power in watts
-            result &= writeRegister(Register40797(), min_discharge_watts);  // set minimum battery discharging power in watts
-            result &= writeRegister(Register40799(), max_discharge_watts);  // set maximum battery discharging power in watts
+            typedef SmaModbusRegisters R;
+            result &= write<R::Register40793>(R::Register40793::fromDouble(min_charge_watts));     // set minimum battery charging power in watts
+            result &= write<R::Register40795>(R::Register40795::fromDouble(max_charge_watts));     // set maximum battery charging power in watts
+            result &= write<R::Register40797>(R::Register40797::fromDouble(min_discharge_watts));  // set minimum battery discharging power in watts
+            result &= write<R::Register40799>(R::Register40799::fromDouble(max_discharge_watts));  // set maximum battery discharging power in watts
             return result;
         }
 
@@ -73,8 +75,8 @@ namespace libsmamodbus {
          * @return true if successful, false otherwise
          */
         bool setPowerRangeInPercent(double minPercent, double maxPercent) {
-            bool result1 = writeRegister(Register44039(), maxPercent);  // set maximum power range in percent
-            bool result2 = writeRegister(Register44041(), minPercent);  // set minimum power range in percent
+            bool result1 = write<SmaModbusRegisters::Register44039>(SmaModbusRegisters::Register44039::fromDouble(maxPercent));  // set maximum power range in percent
+            bool result2 = write<SmaModbusRegisters::Register44041>(SmaModbusRegisters::Register44041::fromDouble(minPercent));  // set minimum power range in percent
             return result1 && result2;
         }
 
@@ -98,9 +100,9 @@ namespace libsmamodbus {
          * @return power in watts
          */
         double getNominalPower(void) {
-            SmaModbusValue value = readRegister(Register30233());   // get inverter nominal power in watts
-            if (value.isValid()) {
-                return value.toDouble();
+            uint32_t watts = 0;
+            if (read<SmaModbusRegisters::Register30233>(watts)) {   // get inverter nominal power in watts
+                return (double)watts;
             }
             return SmaModbusValue::Double_NaN;
         }
@@ -110,9 +112,11 @@ namespace libsmamodbus {
          * @return power in watts; >0 means power import, <0 means power export
          */
         double getGridPowerInWatts(void) {
-            double total_in  = readRegister(SmaModbus::Register30865()).toDouble();
-            double total_out = readRegister(SmaModbus::Register30867()).toDouble();
-            return total_in - total_out;
+            typedef SmaModbusRegisters R;
+            int32_t total_in = 0, total_out = 0;
+            read<R::Register30865>(total_in);
+            read<R::Register30867>(total_out);
+            return R::Register30865::toDouble(total_in) - R::Register30867::toDouble(total_out);
         }
 
         /**
@@ -121,12 +125,20 @@ namespace libsmamodbus {
          */
         void getGridPowerInWatts(double &total, double& phaseL1, double& phaseL2, double& phaseL3) {
             total = getGridPowerInWatts();
-            double l1_out = readRegister(SmaModbus::Register31259()).toDouble();
-            double l2_out = readRegister(SmaModbus::Register31261()).toDouble();
-            double l3_out = readRegister(SmaModbus::Register31263()).toDouble();
-            double l1_in  = readRegister(SmaModbus::Register31265()).toDouble();
-            double l2_in  = readRegister(SmaModbus::Register31267()).toDouble();
-            double l3_in  = readRegister(SmaModbus::Register31269()).toDouble();
+            typedef SmaModbusRegisters R;
+            uint32_t out[3] = {}, in[3] = {};
+            read<R::Register31259>(out[0]);
+            read<R::Register31261>(out[1]);
+            read<R::Register31263>(out[2]);
+            read<R::Register31265>(in[0]);
+            read<R::Register31267>(in[1]);
+            read<R::Register31269>(in[2]);
+            double l1_out = R::Register31259::toDouble(out[0]);
+            double l2_out = R::Register31261::toDouble(out[1]);
+            double l3_out = R::Register31263::toDouble(out[2]);
+            double l1_in  = R::Register31265::toDouble(in[0]);
+            double l2_in  = R::Register31267::toDouble(in[1]);
+            double l3_in  = R::Register31269::toDouble(in[2]);
             phaseL1 = l1_in - l1_out;
             phaseL2 = l2_in - l2_out;
             phaseL3 = l3_in - l3_out;
@@ -0,0 +1,141 @@
+#ifndef __SMAMODBUSARBITER_HPP__
+#define __SMAMODBUSARBITER_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class arbitrating access to a shared modbus tcp connection between threads, by priority classes:
+     *  - Control: writes to device control objects, e.g. power setpoints
+     *  - Normal:  default class of all requests
+     *  - Bulk:    background polling of large read plans
+     *  Each thread requests the connection with the priority set by a PriorityScope, Normal by default. Whenever the connection
+     *  is released, it is granted to the oldest request of the highest priority class. To protect lower classes from starvation,
+     *  the oldest request of a lower class is granted first, if it has been bypassed max_bypass times or has waited max_wait_age.
+     */
+    class SmaModbusArbiter {
+    public:
+        /** Priority classes, from highest to lowest priority. */
+        enum class Priority : uint8_t {
+            Control = 0,
+            Normal  = 1,
+            Bulk    = 2
+        };
+        static const size_t NUM_PRIORITIES = 3;
+
+        /**
+         *  Class holding latency statistics of a priority class; all times are given in microseconds.
+         */
+        class Statistics {
+        public:
+            uint64_t grants;            //!< Number of granted requests
+            uint64_t promotions;        //!< Number of grants made ahead of higher priority requests by the starvation protection
+            uint64_t totalWaitTime;     //!< Accumulated time between request and grant
+            uint64_t maxWaitTime;       //!< Maximum time between request and grant
+            uint64_t totalHoldTime;     //!< Accumulated time between grant and release
+            uint64_t maxHoldTime;       //!< Maximum time between grant and release
+            Statistics(void) : grants(0), promotions(0), totalWaitTime(0), maxWaitTime(0), totalHoldTime(0), maxHoldTime(0) {}
+
+            /** Get the average time between request and release. */
+            double getAverageLatency(void) const { return (grants > 0 ? (double)(totalWaitTime + totalHoldTime) / (double)grants : 0.0); }
+        };
+
+        /**
+         *  Class setting the priority of the calling thread for the lifetime of the scope; scopes can be nested.
+         */
+        class PriorityScope {
+            Priority previous;
+        public:
+            PriorityScope(Priority priority) : previous(thread_priority) { thread_priority = priority; }
+            ~PriorityScope(void) { thread_priority = previous; }
+            PriorityScope(const PriorityScope&) = delete;
+            PriorityScope& operator=(const PriorityScope&) = delete;
+        };
+
+        /**
+         *  Class holding the connection for the lifetime of the scope, using the priority of the calling thread.
+         */
+        class Grant {
+            SmaModbusArbiter& arbiter;
+        public:
+            Grant(SmaModbusArbiter& a) : arbiter(a) { arbiter.acquire(thread_priority); }
+            ~Grant(void) { arbiter.release(); }
+            Grant(const Grant&) = delete;
+            Grant& operator=(const Grant&) = delete;
+        };
+
+    protected:
+        typedef std::chrono::steady_clock Clock;
+
+        //!< pending request of a thread waiting for the connection
+        class Ticket {
+        public:
+            uint64_t number;
+            Clock::time_point time;
+        };
+
+        mutable std::mutex mutex;
+        std::condition_variable granted;
+        std::deque<Ticket> queues[NUM_PRIORITIES];  //!< pending requests of each class, oldest first
+        size_t bypassed[NUM_PRIORITIES];            //!< number of grants to higher classes since the last grant to each class
+        uint64_t next_ticket;
+        uint64_t granted_ticket;
+        bool busy;
+        Priority holder;                            //!< class of the current holder of the connection
+        Clock::time_point grant_time;
+        size_t max_bypass;
+        std::chrono::milliseconds max_wait_age;
+        Statistics statistics[NUM_PRIORITIES];
+
+        static thread_local Priority thread_priority;
+
+    public:
+        /** Constructor; by default a lower class is served after 8 bypasses or 500 ms of waiting. */
+        SmaModbusArbiter(void);
+
+        SmaModbusArbiter(const SmaModbusArbiter&) = delete;
+        SmaModbusArbiter& operator=(const SmaModbusArbiter&) = delete;
+
+        /** Get the priority of the calling thread. */
+        static Priority getThreadPriority(void) { return thread_priority; }
+
+        /**
+         *  Wait until the connection is granted to the calling thread; each call must be followed by a call to release().
+         *  @param priority the priority class of the request
+         */
+        void acquire(Priority priority);
+
+        /** Release the connection and grant it to the next pending request. */
+        void release(void);
+
+        /**
+         *  Set the starvation protection limits.
+         *  @param bypass_count number of grants to higher classes after which the oldest request of a lower class is served
+         *  @param wait_age_ms waiting time in milliseconds after which the oldest request of a lower class is served
+         */
+        void setStarvationLimits(size_t bypass_count, uint32_t wait_age_ms);
+
+        /** Get the latency statistics of the given priority class. */
+        Statistics getStatistics(Priority priority) const;
+
+        /** Reset the latency statistics of all priority classes. */
+        void resetStatistics(void);
+
+    protected:
+        //!< grant the connection to the next pending request; the mutex must be held
+        void grantNext(Clock::time_point now);
+
+        //!< convert a duration to microseconds
+        static uint64_t toMicroseconds(Clock::duration duration) { return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(duration).count(); }
+    };
+
+}   // namespace libsmamodbus
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef __SMAMODBUSDEVICELIMITS_HPP__
+#define __SMAMODBUSDEVICELIMITS_HPP__
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class collecting the address ranges a device is known to accept or reject as a single read request.
+     *  Some SMA firmware versions reject reads spanning undefined register holes, while others allow them.
+     *  The limits are learned from IllegalDataAddress exceptions and from successful block reads, and can be
+     *  persisted to a file, such that block read plans can use the largest safe spans right from the start.
+     */
+    class SmaModbusDeviceLimits {
+    public:
+        /**
+         *  Class describing a contiguous range of modbus registers for a given unit id.
+         */
+        class Span {
+        public:
+            uint8_t  unitID;    //!< Modbus unit id
+            uint16_t addr;      //!< Modbus address of the first register
+            uint16_t size;      //!< Number of 16-bit words
+            Span(uint8_t unit_id, uint16_t address, uint16_t numwords) : unitID(unit_id), addr(address), size(numwords) {}
+
+            /** Check if this span fully covers the given span. */
+            bool contains(const Span& span) const {
+                return unitID == span.unitID && addr <= span.addr && (uint32_t)addr + size >= (uint32_t)span.addr + span.size;
+            }
+        };
+
+    protected:
+        std::vector<Span> readable;     //!< spans known to be readable as a single block
+        std::vector<Span> unreadable;   //!< spans known to be rejected as a single block
+
+    public:
+        /**
+         *  Check if the given span is known to be readable as a single block, i.e. it is covered by a successful read.
+         *  @return true if the span is known to be readable, false if it is unknown or known to be unreadable
+         */
+        bool isReadable(uint8_t unit_id, uint16_t addr, uint16_t size) const;
+
+        /**
+         *  Check if the given span is known to be rejected as a single block, i.e. it covers a span that failed to be read.
+         *  @return true if the span is known to be unreadable, false if it is unknown or known to be readable
+         */
+        bool isUnreadable(uint8_t unit_id, uint16_t addr, uint16_t size) const;
+
+        /** Record a successful block read of the given span. */
+        void markReadable(uint8_t unit_id, uint16_t addr, uint16_t size);
+
+        /** Record a block read of the given span rejected with an IllegalDataAddress exception. */
+        void markUnreadable(uint8_t unit_id, uint16_t addr, uint16_t size);
+
+        /** Forget all learned limits. */
+        void clear(void) { readable.clear(); unreadable.clear(); }
+
+        /** Get spans known to be readable. */
+        const std::vector<Span>& getReadableSpans(void) const { return readable; }
+
+        /** Get spans known to be unreadable. */
+        const std::vector<Span>& getUnreadableSpans(void) const { return unreadable; }
+
+        /**
+         *  Write the learned limits to the given file stream, one span per line.
+         *  @return true if successful
+         */
+        bool write(FILE* file) const;
+
+        /**
+         *  Read learned limits from the given file stream and merge them into this instance.
+         *  Reading stops at the first line not describing a span.
+         *  @return true if successful
+         */
+        bool read(FILE* file);
+
+        /**
+         *  Save the learned limits to the given file.
+         *  @return true if successful
+         */
+        bool save(const std::string& path) const;
+
+        /**
+         *  Load learned limits from the given file and merge them into this instance.
+         *  @return true if successful
+         */
+        bool load(const std::string& path);
+    };
+
+}   // namespace libsmamodbus
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef __SMAMODBUSFLEET_HPP__
+#define __SMAMODBUSFLEET_HPP__
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include <SmaModbus.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class holding register values of a fleet of devices for site-level aggregation.
+     *  Values are stored as doubles in a struct-of-arrays layout indexed by [register][device], such that
+     *  reductions across all devices run over contiguous memory. Each register row is padded with NaN values
+     *  to a multiple of LANES, which keeps the reduction loops free of tail handling and lets the compiler vectorize them.
+     *  NaN values, i.e. invalid or missing register values, are ignored by all reductions.
+     */
+    class SmaModbusFleetSnapshot {
+    public:
+        static const size_t LANES = 8;                  //!< row padding and number of independent accumulators
+        static const size_t npos = (size_t)-1;          //!< return value of findRegister, if the register is not part of the snapshot
+
+        /**
+         *  Class holding the result of a single pass reduction of a register across all devices.
+         */
+        class Reduction {
+        public:
+            double sum;     //!< sum of all valid values, 0 if there are none
+            double min;     //!< minimum of all valid values, NaN if there are none
+            double max;     //!< maximum of all valid values, NaN if there are none
+            size_t count;   //!< number of valid values
+        };
+
+    protected:
+        std::vector<SmaModbus::RegisterDefinition> registers;
+        size_t num_devices;
+        size_t stride;                  //!< number of devices rounded up to a multiple of LANES
+        std::vector<double> current;    //!< values of the current cycle
+        std::vector<double> previous;   //!< values of the previous cycle
+
+    public:
+        /**
+         *  Constructor.
+         *  @param regs the registers collected for each device
+         *  @param devices the number of devices in the fleet
+         */
+        SmaModbusFleetSnapshot(const std::vector<SmaModbus::RegisterDefinition>& regs, size_t devices);
+
+        /** Get the registers of this snapshot. */
+        const std::vector<SmaModbus::RegisterDefinition>& getRegisters(void) const { return registers; }
+
+        /** Get the number of registers. */
+        size_t getNumRegisters(void) const { return registers.size(); }
+
+        /** Get the number of devices. */
+        size_t getNumDevices(void) const { return num_devices; }
+
+        /**
+         *  Find the index of the register with the given modbus address.
+         *  @return the register index, or npos if the register is not part of this snapshot
+         */
+        size_t findRegister(uint16_t addr) const;
+
+        /** Start a new cycle; the current values become the previous values and all current values are set to NaN. */
+        void beginCycle(void);
+
+        /**
+         *  Set the value of the given register and device.
+         *  Indices are not range checked in release builds: reg must be less than getNumRegisters() and device less than
+         *  getNumDevices(); a device index within the row padding would silently add a value to all reductions.
+         */
+        void set(size_t reg, size_t device, double value) {
+            assert(reg < registers.size() && device < num_devices);
+            current[reg * stride + device] = value;
+        }
+        void set(size_t reg, size_t device, const SmaModbusValue& value) { set(reg, device, value.toDouble()); }
+
+        /**
+         *  Set all register values of the given device.
+         *  @param device device index; must be less than getNumDevices(), see set()
+         *  @param values one value per register in the order of getRegisters(), e.g. as returned by SmaModbus::readRegisters()
+         */
+        void setDevice(size_t device, const std::vector<SmaModbusValue>& values);
+
+        /** Get the value of the given register and device from the current cycle. */
+        double get(size_t reg, size_t device) const { return current[reg * stride + device]; }
+
+        /** Get the values of the given register for all devices from the current cycle. */
+        const double* getValues(size_t reg) const { return &current[reg * stride]; }
+
+        /** Get the values of the given register for all devices from the previous cycle. */
+        const double* getPreviousValues(size_t reg) const { return &previous[reg * stride]; }
+
+        /** Get the sum of all valid values of the given register. */
+        double sum(size_t reg) const;
+
+        /** Get the minimum of all valid values of the given register, NaN if there are none. */
+        double min(size_t reg) const;
+
+        /** Get the maximum of all valid values of the given register, NaN if there are none. */
+        double max(size_t reg) const;
+
+        /** Get the number of valid values of the given register. */
+        size_t count(size_t reg) const;
+
+        /** Compute sum, minimum, maximum and number of valid values of the given register in a single pass. */
+        Reduction reduce(size_t reg) const;
+
+        /**
+         *  Compute the per-device change of the given register since the previous cycle.
+         *  @param reg register index
+         *  @param diffs output buffer receiving getNumDevices() values; NaN if either value is invalid
+         */
+        void diff(size_t reg, double* diffs) const;
+
+        /** Get the sum of all valid per-device changes of the given register since the previous cycle. */
+        double sumDiff(size_t reg) const;
+    };
+
+}   // namespace libsmamodbus
+
+#endif
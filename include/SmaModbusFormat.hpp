@@ -0,0 +1,105 @@
+#ifndef __SMAMODBUSFORMAT_HPP__
+#define __SMAMODBUSFORMAT_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <SmaModbus.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class appending formatted register values to a caller provided character buffer, without heap allocations.
+     *  Numeric values are converted straight from their register bit pattern by SmaModbusValue::toChars().
+     *  If an append operation does not fit into the remaining buffer space, nothing is appended and the overflow flag is set;
+     *  json objects, json strings and line protocol lines are appended either completely or not at all.
+     *  The buffer is not null-terminated.
+     */
+    class SmaModbusFormatter {
+    protected:
+        char*  buffer;
+        size_t capacity;
+        size_t length;
+        bool   overflow;
+
+    public:
+        /** Constructor; use the given buffer for output. */
+        SmaModbusFormatter(char* buf, size_t size) : buffer(buf), capacity(size), length(0), overflow(false) {}
+
+        /** Discard all buffer content and reset the overflow flag. */
+        void clear(void) { length = 0; overflow = false; }
+
+        /** Get the buffer content. */
+        const char* data(void) const { return buffer; }
+
+        /** Get the number of characters in the buffer. */
+        size_t size(void) const { return length; }
+
+        /** Check if any append operation did not fit into the buffer. */
+        bool hasOverflow(void) const { return overflow; }
+
+        /** Append the given characters. */
+        SmaModbusFormatter& append(const char* str, size_t len) {
+            if (len > capacity - length) {
+                overflow = true;
+                return *this;
+            }
+            memcpy(buffer + length, str, len);
+            length += len;
+            return *this;
+        }
+        SmaModbusFormatter& append(const char* str) { return append(str, strlen(str)); }
+        SmaModbusFormatter& append(char c) { return append(&c, 1); }
+
+        /** Append the given unsigned integer in decimal notation. */
+        SmaModbusFormatter& appendUnsigned(uint64_t value);
+
+        /** Append the string representation of the given value; see SmaModbusValue::toString(). */
+        SmaModbusFormatter& appendValue(const SmaModbusValue& value);
+
+        /** Append the string representation of the given register view; see SmaModbusValue::toString(). */
+        SmaModbusFormatter& appendValue(const SmaModbus::RawRegisterView& view);
+
+        /** Append the given characters as a quoted and escaped json string. */
+        SmaModbusFormatter& appendJsonString(const char* str, size_t len);
+
+        /**
+         *  Append all registers of the given read plan from its last poll as a json object, using register identifiers as keys.
+         *  Invalid values are written as null, STR32 values as strings without trailing '\0' characters.
+         *  Example: {"Bat.Amp":-1.234,"Bat.ChaStt":80}
+         */
+        SmaModbusFormatter& appendJson(const SmaModbus::ReadPlan& plan);
+
+        /**
+         *  Append all registers of the given read plan from its last poll as a single InfluxDB line protocol line,
+         *  using register identifiers as field keys. Invalid values are omitted; no line is appended if there is no valid value.
+         *  Example: sma,device=sbs37 Bat.Amp=-1.234,Bat.ChaStt=80 1700000000000000000
+         *  @param measurement the measurement name
+         *  @param tags preformatted tag set without leading comma, e.g. "device=sbs37"; may be NULL or empty
+         *  @param plan the read plan
+         *  @param timestamp timestamp in the precision configured for the database; 0 to omit the timestamp
+         */
+        SmaModbusFormatter& appendLineProtocol(const char* measurement, const char* tags, const SmaModbus::ReadPlan& plan, uint64_t timestamp = 0);
+
+    protected:
+        //!< append characters escaped for line protocol keys, i.e. commas, equal signs and spaces are escaped by backslashes
+        SmaModbusFormatter& appendLineProtocolKey(const char* str, size_t len, bool escape_equals);
+
+        //!< append characters as a quoted line protocol string field value
+        SmaModbusFormatter& appendLineProtocolString(const char* str, size_t len);
+
+        //!< copy the characters of a STR32 register view to the given buffer, return the number of characters
+        static size_t getString(const SmaModbus::RawRegisterView& view, char* str, size_t size);
+
+        //!< get the length of the given register string without trailing '\0' characters
+        static size_t trimmedLength(const char* str, size_t len) {
+            while (len > 0 && str[len - 1] == '\0') {
+                --len;
+            }
+            return len;
+        }
+    };
+
+}   // namespace libsmamodbus
+
+#endif
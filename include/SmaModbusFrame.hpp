@@ -0,0 +1,137 @@
+#ifndef __SMAMODBUSFRAME_HPP__
+#define __SMAMODBUSFRAME_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <SmaModbusLowLevel.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class implementing a minimal modbus tcp framing, i.e. the MBAP header and the PDU, for the function codes used with sma devices:
+     *  - 0x03 read holding registers
+     *  - 0x10 write multiple holding registers
+     *  All methods work on caller provided buffers; there are no heap allocations involved.
+     */
+    class SmaModbusFrame {
+    public:
+        static const size_t MBAP_HEADER_SIZE   = 7;     //!< transaction id, protocol id, length, unit id
+        static const size_t MAX_FRAME_SIZE     = 260;   //!< MBAP header and the maximum PDU size of 253 bytes
+        static const size_t MAX_READ_WORDS     = 125;   //!< maximum number of registers for function code 0x03
+        static const size_t MAX_WRITE_WORDS    = 123;   //!< maximum number of registers for function code 0x10
+        static const size_t READ_REQUEST_SIZE  = 12;    //!< size of a function code 0x03 request frame
+        static const size_t WRITE_RESPONSE_SIZE = 12;   //!< size of a function code 0x10 response frame
+        static const size_t EXCEPTION_RESPONSE_SIZE = 9; //!< size of an exception response frame
+        static const uint8_t GATEWAY_TARGET_FAILED = 0x0B;  //!< modbus exception code: gateway target device failed to respond
+
+        /**
+         *  Encode a read holding registers request (function code 0x03).
+         *  @param buffer output buffer; must provide at least READ_REQUEST_SIZE bytes
+         *  @param transaction_id modbus tcp transaction id
+         *  @param unit_id modbus unit id
+         *  @param addr modbus address
+         *  @param num_words number of uint16 words to be read; must be between 1 and MAX_READ_WORDS
+         *  @return number of bytes written to the buffer, 0 in case of invalid arguments
+         */
+        static size_t encodeReadRequest(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, size_t num_words);
+
+        /**
+         *  Encode a write multiple holding registers request (function code 0x10).
+         *  @param buffer output buffer; must provide at least MAX_FRAME_SIZE bytes
+         *  @param transaction_id modbus tcp transaction id
+         *  @param unit_id modbus unit id
+         *  @param addr modbus address
+         *  @param words uint16 words to be written
+         *  @param num_words number of uint16 words to be written; must be between 1 and MAX_WRITE_WORDS
+         *  @return number of bytes written to the buffer, 0 in case of invalid arguments
+         */
+        static size_t encodeWriteRequest(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, const uint16_t* words, size_t num_words);
+
+        /**
+         *  Get the total frame size from the given MBAP header.
+         *  @param header the first MBAP_HEADER_SIZE bytes of a frame
+         *  @return the total frame size including the MBAP header, 0 if the header is not a valid modbus tcp header
+         */
+        static size_t getFrameSize(const uint8_t* header);
+
+        /** Get the transaction id from the given MBAP header. */
+        static uint16_t getTransactionID(const uint8_t* header) { return getWord(header); }
+
+        /** Get the unit id from the given MBAP header. */
+        static uint8_t getUnitID(const uint8_t* header) { return header[6]; }
+
+        /** Get the function code from the given frame, including the exception flag 0x80. */
+        static uint8_t getFunctionCode(const uint8_t* frame) { return frame[7]; }
+
+        /**
+         *  Decode a read holding registers response (function code 0x03).
+         *  @param frame the response frame including the MBAP header
+         *  @param frame_size the size of the response frame
+         *  @param words output buffer receiving the register values
+         *  @param num_words number of uint16 words expected in the response
+         *  @return NoError if successful, the modbus exception code or a library error code otherwise
+         */
+        static SmaModbusErrorCode decodeReadResponse(const uint8_t* frame, size_t frame_size, uint16_t* words, size_t num_words);
+
+        /**
+         *  Decode a write multiple holding registers response (function code 0x10).
+         *  @param frame the response frame including the MBAP header
+         *  @param frame_size the size of the response frame
+         *  @param addr modbus address of the request
+         *  @param num_words number of uint16 words of the request
+         *  @return NoError if successful, the modbus exception code or a library error code otherwise
+         */
+        static SmaModbusErrorCode decodeWriteResponse(const uint8_t* frame, size_t frame_size, uint16_t addr, size_t num_words);
+
+        /**
+         *  Decode a request frame as received by a modbus tcp server.
+         *  @param frame the request frame including the MBAP header
+         *  @param frame_size the size of the request frame
+         *  @param addr output parameter receiving the modbus address
+         *  @param num_words output parameter receiving the number of uint16 words
+         *  @param words output buffer receiving the register values of write requests; must provide MAX_WRITE_WORDS words
+         *  @return NoError if successful, the modbus exception code to be sent to the client otherwise
+         */
+        static SmaModbusErrorCode decodeRequest(const uint8_t* frame, size_t frame_size, uint16_t& addr, uint16_t& num_words, uint16_t* words);
+
+        /**
+         *  Encode a read holding registers response (function code 0x03).
+         *  @param buffer output buffer; must provide at least MAX_FRAME_SIZE bytes
+         *  @return number of bytes written to the buffer, 0 in case of invalid arguments
+         */
+        static size_t encodeReadResponse(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, const uint16_t* words, size_t num_words);
+
+        /**
+         *  Encode a write multiple holding registers response (function code 0x10).
+         *  @param buffer output buffer; must provide at least WRITE_RESPONSE_SIZE bytes
+         *  @return number of bytes written to the buffer
+         */
+        static size_t encodeWriteResponse(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, size_t num_words);
+
+        /**
+         *  Encode an exception response.
+         *  @param buffer output buffer; must provide at least EXCEPTION_RESPONSE_SIZE bytes
+         *  @param function_code the function code of the request, without the exception flag 0x80
+         *  @param exception_code the modbus exception code
+         *  @return number of bytes written to the buffer
+         */
+        static size_t encodeExceptionResponse(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, uint8_t exception_code);
+
+        /** Read a big endian uint16 value from the given buffer. */
+        static uint16_t getWord(const uint8_t* buffer) { return (uint16_t)((buffer[0] << 8) | buffer[1]); }
+
+        /** Write a big endian uint16 value to the given buffer. */
+        static void setWord(uint8_t* buffer, uint16_t value) { buffer[0] = (uint8_t)(value >> 8); buffer[1] = (uint8_t)value; }
+
+    private:
+        //!< write the MBAP header and the function code, return the pdu offset after the function code
+        static size_t encodeHeader(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, size_t pdu_size);
+
+        //!< check function code and exception flag of a response frame
+        static SmaModbusErrorCode checkResponse(const uint8_t* frame, size_t frame_size, uint8_t function_code);
+    };
+
+}   // namespace libsmamodbus
+
+#endif
@@ -5,6 +5,9 @@
 #include <string>
 #include <vector>
 #include <MB/TCP/connection.hpp>
+#include <SmaModbusSocket.hpp>
+#include <SmaModbusArbiter.hpp>
+#include <SmaModbusStatistics.hpp>
 
 
 namespace libsmamodbus {
@@ -62,27 +65,76 @@ namespace libsmamodbus {
 
 
     /**
-     *  Class encapsulating the modbus API from libmodbus.
+     *  Class encapsulating the modbus tcp transport.
      *  It provides low-level read and write operations for the most basic data types defined for sma modbus registers:
      *  - S32, U32, S64, U64, ENUM are all mapped to uint64_t with leading zeroes
      *  - STR32 is mapped to std::string, potentially including '\0' characters
+     *  Modbus tcp frames are encoded and decoded by SmaModbusFrame on stack buffers. If SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+     *  is defined, requests are sent through the ModbusRequest / ModbusResponse classes from libmodbus instead.
+     *  The connection may be shared between threads; each request holds it through SmaModbusArbiter, using the priority
+     *  class set for the calling thread by SmaModbusArbiter::PriorityScope.
      */
     class SmaModbusLowLevel {
+    public:
+
+        /**
+         *  Class describing a single read request of a pipelined read; see readBlocks().
+         */
+        class ReadRequest {
+        public:
+            SmaModbusUnitID unitID;         //!< Modbus unit id
+            uint16_t addr;                  //!< Modbus address of the first word
+            uint16_t size;                  //!< Number of 16-bit words to be read
+            uint16_t* words;                //!< Output buffer receiving size words
+            SmaModbusException exception;   //!< Error information of this request, NoError if successful
+            ReadRequest(SmaModbusUnitID unit_id, uint16_t address, uint16_t numwords, uint16_t* buffer) :
+                unitID(unit_id), addr(address), size(numwords), words(buffer) {}
+        };
+
+        static const size_t MAX_PIPELINE_WINDOW = 16;   //!< maximum number of outstanding requests of a pipelined read
 
     private:
         std::string peer_ip;
         uint16_t    peer_port;
         SmaModbusUnitID unit_id;
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
         MB::TCP::Connection modbus;
+#else
+        SmaModbusSocket modbus;
+        uint16_t transaction_id;
+        bool connected;             // the socket closes itself on some transport errors; track the connection for the statistics
+#endif
+        size_t pipeline_window;
+        SmaModbusSocket::Options socket_options;
+        SmaModbusArbiter arbiter;
+        SmaModbusStatistics statistics;
 
         //!< ensure that the tcp connection is established, called by read and write methods for lazy initialization
         bool ensureConnection(void);
 
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+        //!< send the given request and wait for its response
+        MB::ModbusResponse sendAndAwait(const MB::ModbusRequest& request);
+#else
+        //!< send the given request frame and receive the matching response frame into the given buffer of size SmaModbusFrame::MAX_FRAME_SIZE
+        size_t transact(const uint8_t* request, size_t request_size, uint8_t* response);
+
+        //!< receive a single response frame into the given buffer of size SmaModbusFrame::MAX_FRAME_SIZE
+        size_t receiveFrame(uint8_t* response);
+
+        //!< close the tcp connection after a transport error; the next request reconnects
+        void closeConnection(void);
+#endif
+
     public:
         /**
          *  Constructor; set member variables.
          */
-        SmaModbusLowLevel(const std::string& peer, uint16_t port = 502, const SmaModbusUnitID unitid = SmaModbusUnitID::DEVICE_0) : peer_ip(peer), peer_port(port), unit_id(unitid), modbus(-1) {}
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+        SmaModbusLowLevel(const std::string& peer, uint16_t port = 502, const SmaModbusUnitID unitid = SmaModbusUnitID::DEVICE_0) : peer_ip(peer), peer_port(port), unit_id(unitid), modbus(-1), pipeline_window(1) {}
+#else
+        SmaModbusLowLevel(const std::string& peer, uint16_t port = 502, const SmaModbusUnitID unitid = SmaModbusUnitID::DEVICE_0) : peer_ip(peer), peer_port(port), unit_id(unitid), transaction_id(0), connected(false), pipeline_window(1) {}
+#endif
 
         /**
          *  Destructor; close the tcp connection.
@@ -102,6 +154,49 @@ namespace libsmamodbus {
         void setUnitID(SmaModbusUnitID id) { unit_id = id; }
         void setUnitID(uint8_t id) { setUnitID((SmaModbusUnitID)id); }
 
+        /**
+         *  Get the arbiter granting the connection to concurrent requests, e.g. to query its latency statistics.
+         *  @return the arbiter
+         */
+        SmaModbusArbiter& getArbiter(void) { return arbiter; }
+
+        /**
+         *  Get the request and connection statistics, e.g. to monitor error rates and latency percentiles of long-running pollers.
+         *  Request latencies include the time waiting for the connection to be granted by the arbiter.
+         *  @return the statistics
+         */
+        SmaModbusStatistics& getStatistics(void) { return statistics; }
+        const SmaModbusStatistics& getStatistics(void) const { return statistics; }
+
+        /**
+         *  Get the tcp options applied to the connection.
+         *  @return the socket options
+         */
+        const SmaModbusSocket::Options& getSocketOptions(void) const { return socket_options; }
+
+        /**
+         *  Set the tcp options applied to the connection, e.g. to tune keepalive probes or the connect timeout.
+         *  They are applied to an open connection where possible, and to each new connection.
+         *  With SMAMODBUS_USE_LIBMODBUS_TRANSPORT, the options are applied after libmodbus has connected; the connect timeout
+         *  is not supported, and the send and receive timeout is set as SO_SNDTIMEO and SO_RCVTIMEO.
+         *  @param options the socket options
+         */
+        void setSocketOptions(const SmaModbusSocket::Options& options);
+
+        /**
+         *  Get the maximum number of requests sent ahead of their responses by readBlocks().
+         *  @return the pipeline window
+         */
+        size_t getPipelineWindow(void) const { return pipeline_window; }
+
+        /**
+         *  Set the maximum number of requests sent ahead of their responses by readBlocks().
+         *  The default window of 1 disables pipelining, as not all devices queue requests; enable it only for devices
+         *  known to answer several outstanding requests on the same connection.
+         *  @param window the pipeline window, between 1 and MAX_PIPELINE_WINDOW
+         */
+        void setPipelineWindow(size_t window) { pipeline_window = (window < 1 ? 1 : window > MAX_PIPELINE_WINDOW ? MAX_PIPELINE_WINDOW : window); }
+
         /**
          *  Read an integral value of nbytes from the given modbus address.
          *  @param addr modbus address
@@ -136,6 +231,32 @@ namespace libsmamodbus {
          */
         std::vector<uint16_t> readWords(SmaModbusUnitID unit_id, uint16_t addr, size_t num_words, SmaModbusException& exception = SmaModbusException(), bool allow_exception = false, bool print_exception = true);
 
+        /**
+         *  Read uint16 values from the given modbus address into a caller provided buffer.
+         *  @param unit_id modbus unit id
+         *  @param addr modbus address
+         *  @param words output buffer receiving num_words uint16 values
+         *  @param num_words number of uint16 words to be read from the modbus address
+         *  @param exception output parameter to receive any modbus exception information
+         *  @param allow_exception if true, the method will throw an SmaModbusException in case of an error
+         *  @param print_exception if true, the method will print exception information to stdout
+         *  @return the number of uint16 values read, 0 in case of an error
+         */
+        size_t readWords(SmaModbusUnitID unit_id, uint16_t addr, uint16_t* words, size_t num_words, SmaModbusException& exception, bool allow_exception, bool print_exception);
+
+        /**
+         *  Read several blocks of uint16 values on the same connection, keeping up to getPipelineWindow() requests outstanding.
+         *  Responses are matched to their requests by the modbus tcp transaction id, so the device may answer them in any order.
+         *  The connection is released after each window of requests, so that requests of higher priority classes get in between.
+         *  A modbus exception response fails only the affected request; a transport error fails all requests not completed so far.
+         *  If SMAMODBUS_USE_LIBMODBUS_TRANSPORT is defined, the requests are sent one after the other.
+         *  @param requests the read requests; their exception members receive the error information of each request
+         *  @param num_requests number of read requests
+         *  @param print_exception if true, the method will print exception information to stdout
+         *  @return the number of successful requests
+         */
+        size_t readBlocks(ReadRequest* requests, size_t num_requests, bool print_exception = true);
+
         /**
          *  Write an integral value of nbytes to the given modbus address.
          *  @param addr modbus address
@@ -170,7 +291,22 @@ namespace libsmamodbus {
          *  @param print_exception if true, the method will print exception information to stdout
          *  @return true if successful
          */
-        bool writeWords(SmaModbusUnitID unit_id, uint16_t addr, const std::vector<uint16_t>& value, SmaModbusException& exception, bool allow_exception, bool print_exception);
+        bool writeWords(SmaModbusUnitID unit_id, uint16_t addr, const std::vector<uint16_t>& value, SmaModbusException& exception, bool allow_exception, bool print_exception) {
+            return writeWords(unit_id, addr, value.data(), value.size(), exception, allow_exception, print_exception);
+        }
+
+        /**
+         *  Write uint16 values from a caller provided buffer to the given modbus address.
+         *  @param unit_id modbus unit id
+         *  @param addr modbus address
+         *  @param words uint16 values to be written to the modbus address
+         *  @param num_words number of uint16 values to be written
+         *  @param exception output parameter to receive any modbus exception information
+         *  @param allow_exception if true, the method will throw an SmaModbusException in case of an error
+         *  @param print_exception if true, the method will print exception information to stdout
+         *  @return true if successful
+         */
+        bool writeWords(SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* words, size_t num_words, SmaModbusException& exception, bool allow_exception, bool print_exception);
     };
 
 }   // namespace libsmamodbus
@@ -0,0 +1,200 @@
+#ifndef __SMAMODBUSPROXY_HPP__
+#define __SMAMODBUSPROXY_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <SmaModbusLowLevel.hpp>
+#include <SmaModbusSocket.hpp>
+#include <SmaModbusFrame.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class implementing a modbus tcp gateway that fans many local modbus tcp clients into a single connection to an sma device.
+     *  SMA inverters accept only a few concurrent modbus tcp connections; the proxy serves any number of local clients through
+     *  the upstream connection of an SmaModbusLowLevel instance:
+     *  - read requests (function code 0x03) are answered from a short-lived cache if all requested words are fresh enough
+     *  - the remaining read requests received within one poll cycle are deduplicated and overlapping or adjacent ranges of
+     *    the same unit id are coalesced into upstream reads of up to 125 words, which are sent pipelined by readBlocks();
+     *    the proxy sets the pipeline window of the upstream instance, see SmaModbusLowLevel::setPipelineWindow()
+     *  - write requests (function code 0x10) are forwarded immediately and invalidate the cached words they overwrite;
+     *    reads received before from the same client are answered first, so that a write never overtakes them
+     *  - any other function code is answered by an IllegalFunction exception response
+     *  The proxy is single-threaded; it runs in the thread calling poll() or run(), which must be the only user of the upstream instance.
+     *  As clients match responses by their transaction id, responses are not necessarily sent in request order.
+     */
+    class SmaModbusProxy {
+    public:
+
+        static const size_t DEFAULT_PIPELINE_WINDOW = 4;    //!< default number of outstanding upstream reads
+
+        /**
+         *  Class holding proxy statistics.
+         */
+        class Statistics {
+        public:
+            uint64_t requests;          //!< Number of client requests received
+            uint64_t cacheHits;         //!< Number of read requests answered from the cache
+            uint64_t coalesced;         //!< Number of read requests answered by an upstream read shared with other requests
+            uint64_t upstreamReads;     //!< Number of upstream read requests
+            uint64_t upstreamWrites;    //!< Number of upstream write requests
+            uint64_t exceptions;        //!< Number of exception responses sent to clients
+            Statistics(void) : requests(0), cacheHits(0), coalesced(0), upstreamReads(0), upstreamWrites(0), exceptions(0) {}
+        };
+
+    protected:
+        typedef std::chrono::steady_clock Clock;
+
+        //!< connected client with its receive buffer
+        class Client {
+        public:
+            SmaModbusSocket socket;
+            uint8_t buffer[2 * SmaModbusFrame::MAX_FRAME_SIZE];
+            size_t size;
+            Client(void) : size(0) {}
+        };
+
+        //!< read request of a client waiting for its upstream read
+        class PendingRead {
+        public:
+            Client* client;
+            uint16_t transactionID;
+            uint8_t unitID;
+            uint16_t addr;
+            uint16_t size;
+            size_t block;               //!< index of the upstream block covering this request
+            PendingRead(Client* c, uint16_t transaction_id, uint8_t unit_id, uint16_t address, uint16_t numwords) :
+                client(c), transactionID(transaction_id), unitID(unit_id), addr(address), size(numwords), block(0) {}
+        };
+
+        //!< upstream read covering one or more pending reads
+        class Block {
+        public:
+            uint8_t unitID;
+            uint16_t addr;
+            uint16_t size;
+            size_t numRanges;           //!< number of distinct client ranges covered by this block
+            SmaModbusException exception;
+            uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+            Block(uint8_t unit_id, uint16_t address, uint16_t numwords) : unitID(unit_id), addr(address), size(numwords), numRanges(1) {}
+        };
+
+        //!< cached register word
+        class CacheEntry {
+        public:
+            uint16_t word;
+            Clock::time_point time;
+        };
+
+        SmaModbusLowLevel& upstream;
+        std::string listen_addr;
+        uint16_t listen_port;
+        SmaModbusSocket server;
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<PendingRead> pending;
+        std::vector<Block> blocks;
+        std::vector<SmaModbusLowLevel::ReadRequest> requests;
+        std::unordered_map<uint32_t, CacheEntry> cache;     //!< cached words, keyed by unit id << 16 | address
+        std::chrono::milliseconds cache_ttl;
+        size_t max_clients;
+        std::atomic<bool> running;
+        Statistics statistics;
+
+    public:
+        /**
+         *  Constructor; the proxy does not listen before open() is called.
+         *  @param upstream the connection to the sma device
+         *  @param port local tcp port to listen on
+         *  @param addr local ip address to listen on; an empty string listens on all local addresses
+         *  @param pipeline_window the pipeline window set on the upstream instance for coalesced reads; 1 disables pipelining
+         *  for devices that do not queue requests
+         */
+        SmaModbusProxy(SmaModbusLowLevel& upstream, uint16_t port = 502, const std::string& addr = "127.0.0.1", size_t pipeline_window = DEFAULT_PIPELINE_WINDOW);
+
+        /**
+         *  Start listening for client connections.
+         *  @return true if successful
+         */
+        bool open(void);
+
+        /**
+         *  Stop listening and close all client connections.
+         */
+        void close(void);
+
+        /**
+         *  Get the time in milliseconds a word read from upstream is used to answer subsequent read requests.
+         */
+        uint32_t getCacheTTL(void) const { return (uint32_t)cache_ttl.count(); }
+
+        /**
+         *  Set the time in milliseconds a word read from upstream is used to answer subsequent read requests; 0 disables the cache.
+         */
+        void setCacheTTL(uint32_t milliseconds) { cache_ttl = std::chrono::milliseconds(milliseconds); cache.clear(); }
+
+        /**
+         *  Set the maximum number of concurrent client connections; further connections are closed right after they are accepted.
+         */
+        void setMaxClients(size_t num_clients) { max_clients = num_clients; }
+
+        /**
+         *  Get the number of connected clients.
+         */
+        size_t getNumClients(void) const { return clients.size(); }
+
+        /**
+         *  Get the proxy statistics.
+         */
+        const Statistics& getStatistics(void) const { return statistics; }
+
+        /**
+         *  Run a single poll cycle: wait for client activity, accept new connections, receive requests and answer them.
+         *  @param timeout_ms maximum time to wait for client activity in milliseconds
+         */
+        void poll(int timeout_ms);
+
+        /**
+         *  Run poll cycles until stop() is called; open() must have been called before.
+         */
+        void run(void);
+
+        /**
+         *  Make run() return after its current poll cycle; this may be called from any thread.
+         */
+        void stop(void) { running = false; }
+
+    protected:
+        //!< accept a pending client connection
+        void acceptClient(void);
+
+        //!< receive the available bytes of the given client and handle all complete request frames
+        void receiveRequests(Client& client);
+
+        //!< handle a single request frame
+        void handleRequest(Client& client, const uint8_t* frame, size_t frame_size);
+
+        //!< answer all pending reads from the cache or from coalesced upstream reads
+        void processReads(void);
+
+        //!< read the blocks starting at the given index from upstream and add the results to the cache
+        void readBlocks(size_t first);
+
+        //!< copy the requested words from the cache, return false if any of them is missing or expired
+        bool lookupCache(const PendingRead& read, Clock::time_point now, uint16_t* words) const;
+
+        //!< send a response frame to the given client; the client is closed if sending fails
+        void sendResponse(Client& client, const uint8_t* frame, size_t frame_size);
+
+        //!< send an exception response to the given client, mapping library error codes to the gateway exception code
+        void sendException(Client& client, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, SmaModbusErrorCode error);
+    };
+
+}   // namespace libsmamodbus
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef __SMAMODBUSREGISTER_HPP__
+#define __SMAMODBUSREGISTER_HPP__
+
+#include <cstdint>
+#include <type_traits>
+#include <SmaModbus.hpp>
+#include <SmaModbusValue.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class holding a fixed-point value as scaled integer, as used by SMA data formats FIX1 to FIX4.
+     *  @tparam Rep integral type holding the scaled value
+     *  @tparam Decimals number of decimal places
+     */
+    template <typename Rep, unsigned Decimals>
+    class SmaModbusFixed {
+    public:
+        static constexpr Rep scale(void) { Rep result = 1; for (unsigned i = 0; i < Decimals; ++i) { result *= 10; } return result; }
+
+        Rep raw;    //!< scaled integer value, i.e. the value multiplied by 10^Decimals
+
+        constexpr SmaModbusFixed(void) : raw(0) {}
+        constexpr explicit SmaModbusFixed(Rep scaled) : raw(scaled) {}
+
+        /** Convert to floating point. */
+        double toDouble(void) const { return (double)raw / (double)scale(); }
+
+        bool operator==(const SmaModbusFixed& other) const { return raw == other.raw; }
+        bool operator!=(const SmaModbusFixed& other) const { return raw != other.raw; }
+    };
+
+
+    /**
+     *  Type trait mapping SMA data type and data format to the native C++ type of a register value:
+     *  - U32, ENUM: uint32_t; S32: int32_t; U64: uint64_t; S64: int64_t
+     *  - FIX1 to FIX4: SmaModbusFixed holding the scaled integer of the above types
+     */
+    template <DataType Type, DataFormat Format>
+    class SmaModbusNativeType {
+        static_assert(Type == DataType::U32 || Type == DataType::S32 || Type == DataType::U64 || Type == DataType::S64 || Type == DataType::ENUM,
+            "typed registers support numeric data types only");
+        typedef typename std::conditional<Type == DataType::S32, int32_t,
+                typename std::conditional<Type == DataType::U64, uint64_t,
+                typename std::conditional<Type == DataType::S64, int64_t, uint32_t>::type>::type>::type integral_type;
+        static constexpr unsigned decimals =
+            (Format == DataFormat::FIX1 ? 1 : Format == DataFormat::FIX2 ? 2 : Format == DataFormat::FIX3 ? 3 : Format == DataFormat::FIX4 ? 4 : 0);
+    public:
+        typedef typename std::conditional<decimals == 0, integral_type, SmaModbusFixed<integral_type, decimals>>::type type;
+    };
+
+
+    /**
+     *  Class template describing an SMA modbus register at compile time.
+     *  Decoding and encoding are resolved from the template arguments, i.e. without any runtime dispatch on DataType or DataFormat.
+     *  @tparam Addr modbus address
+     *  @tparam Type SMA data type; numeric types only
+     *  @tparam Format SMA data format
+     *  @tparam Mode SMA access mode
+     *  @tparam Cat SMA register category
+     *  @tparam Native native C++ type of the register value; defaults to SmaModbusNativeType, may be an enum type for ENUM registers
+     */
+    template <uint16_t Addr, DataType Type, DataFormat Format,
+              SmaModbus::AccessMode Mode = SmaModbus::AccessMode::RO, SmaModbus::Category Cat = SmaModbus::Category::Normal,
+              typename Native = typename SmaModbusNativeType<Type, Format>::type>
+    class SmaModbusRegister {
+    public:
+        typedef Native native_type;
+        static constexpr uint16_t addr = Addr;
+        static constexpr uint16_t size = (Type == DataType::U64 || Type == DataType::S64 ? 4 : 2);
+        static constexpr DataType type = Type;
+        static constexpr DataFormat format = Format;
+        static constexpr SmaModbus::AccessMode mode = Mode;
+        static constexpr SmaModbus::Category category = Cat;
+
+        /** Convert a register bit pattern to the native value. */
+        static native_type fromBits(uint64_t bits) {
+            if constexpr (std::is_class<native_type>::value) {
+                return native_type((decltype(native_type::raw))bits);
+            }
+            else {
+                return (native_type)bits;
+            }
+        }
+
+        /** Convert a native value to the register bit pattern. */
+        static uint64_t toBits(const native_type& value) {
+            uint64_t bits = 0;
+            if constexpr (std::is_class<native_type>::value) {
+                bits = (uint64_t)value.raw;
+            }
+            else {
+                bits = (uint64_t)value;
+            }
+            return (size == 2 ? bits & 0xffffffffu : bits);
+        }
+
+        /** Get the native value representing the SMA NaN value of the register. */
+        static native_type nan(void) {
+            switch (Type) {
+            case DataType::S32:  return fromBits((uint32_t)SmaModbusValue::S32_NaN);
+            case DataType::U64:  return fromBits(SmaModbusValue::U64_NaN);
+            case DataType::S64:  return fromBits((uint64_t)SmaModbusValue::S64_NaN);
+            case DataType::ENUM: return fromBits(SmaModbusValue::Enum_NaN);
+            default:             return fromBits(SmaModbusValue::U32_NaN);
+            }
+        }
+
+        /** Check if the given native value is valid, i.e. not the SMA NaN value. */
+        static bool isValid(const native_type& value) { return SmaModbusValue::isValid(toBits(value), Type); }
+
+        /** Convert a floating point value to the native value, applying the same rounding and NaN mapping as SmaModbusValue. */
+        static native_type fromDouble(double value) { return fromBits(SmaModbusValue(value, Type, Format).u64); }
+
+        /** Convert the native value to floating point, NaN for invalid values. */
+        static double toDouble(const native_type& value) { return SmaModbusValue::toDouble(toBits(value), Type, Format); }
+
+        /**
+         *  Decode the register words.
+         *  @param words the words as read from the modbus register
+         *  @param value output parameter receiving the native value
+         *  @return true if the value is valid, false if it is the SMA NaN value
+         */
+        static bool decode(const uint16_t* words, native_type& value) {
+            uint64_t bits = SmaModbusValue::joinWords(words, size);
+            value = fromBits(bits);
+            return SmaModbusValue::isValid(bits, Type);
+        }
+
+        /** Encode the native value into register words. */
+        static void encode(const native_type& value, uint16_t* words) {
+            uint64_t bits = toBits(value);
+            for (size_t i = 0; i < size; ++i) {
+                words[i] = (uint16_t)(bits >> (16u * (size - 1 - i)));
+            }
+        }
+    };
+
+
+    /**
+     *  Typed counterparts of the register definitions provided by SmaModbus.
+     */
+    class SmaModbusRegisters {
+        typedef SmaModbus::AccessMode AccessMode;
+        typedef SmaModbus::Category Category;
+    public:
+        typedef SmaModbusRegister<30001, DataType::U32,  DataFormat::RAW>      Register30001;  //!< Modbus.Profile
+        typedef SmaModbusRegister<30003, DataType::U32,  DataFormat::RAW>      Register30003;  //!< Nameplate.SusyId
+        typedef SmaModbusRegister<30005, DataType::U32,  DataFormat::RAW>      Register30005;  //!< Nameplate.SerNum
+        typedef SmaModbusRegister<30051, DataType::ENUM, DataFormat::RAW>      Register30051;  //!< Nameplate.MainModel
+        typedef SmaModbusRegister<30053, DataType::ENUM, DataFormat::RAW>      Register30053;  //!< Nameplate.Model
+        typedef SmaModbusRegister<30059, DataType::U32,  DataFormat::FIRMWARE> Register30059;  //!< Nameplate.PkgRev
+        typedef SmaModbusRegister<30193, DataType::U32,  DataFormat::DATETIME> Register30193;  //!< DtTm.Tm
+        typedef SmaModbusRegister<30233, DataType::U32,  DataFormat::FIX0>     Register30233;  //!< Inverter.WMax
+
+        typedef SmaModbusRegister<30843, DataType::S32,  DataFormat::FIX3>     Register30843;  //!< Bat.Amp
+        typedef SmaModbusRegister<30845, DataType::U32,  DataFormat::FIX0>     Register30845;  //!< Bat.ChaStt
+        typedef SmaModbusRegister<30847, DataType::U32,  DataFormat::FIX0>     Register30847;  //!< Bat.Diag.ActlCapacNom
+        typedef SmaModbusRegister<30857, DataType::S32,  DataFormat::FIX0>     Register30857;  //!< Bat.Diag.CapacThrpCnt
+        typedef SmaModbusRegister<30955, DataType::ENUM, DataFormat::RAW>      Register30955;  //!< Bat.OpStt
+
+        typedef SmaModbusRegister<30865, DataType::S32,  DataFormat::FIX0>     Register30865;  //!< Metering.GridMs.W.TotIn
+        typedef SmaModbusRegister<30867, DataType::S32,  DataFormat::FIX0>     Register30867;  //!< Metering.GridMs.W.TotOut
+        typedef SmaModbusRegister<31259, DataType::U32,  DataFormat::FIX0, AccessMode::RO, Category::DeviceControlObject> Register31259;  //!< Metering.GridMs.W.phsA
+        typedef SmaModbusRegister<31261, DataType::U32,  DataFormat::FIX0, AccessMode::RO, Category::DeviceControlObject> Register31261;  //!< Metering.GridMs.W.phsB
+        typedef SmaModbusRegister<31263, DataType::U32,  DataFormat::FIX0, AccessMode::RO, Category::DeviceControlObject> Register31263;  //!< Metering.GridMs.W.phsC
+        typedef SmaModbusRegister<31265, DataType::U32,  DataFormat::FIX0, AccessMode::RO, Category::DeviceControlObject> Register31265;  //!< Metering.GridMs.WIn.phsA
+        typedef SmaModbusRegister<31267, DataType::U32,  DataFormat::FIX0, AccessMode::RO, Category::DeviceControlObject> Register31267;  //!< Metering.GridMs.WIn.phsB
+        typedef SmaModbusRegister<31269, DataType::U32,  DataFormat::FIX0, AccessMode::RO, Category::DeviceControlObject> Register31269;  //!< Metering.GridMs.WIn.phsC
+
+        typedef SmaModbusRegister<40149, DataType::S32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40149;  //!< Inverter.WModCfg.WCtlComCfg.WSpt
+        typedef SmaModbusRegister<40151, DataType::ENUM, DataFormat::RAW,  AccessMode::WO, Category::DeviceControlObject> Register40151;  //!< Inverter.WModCfg.WCtlComCfg.WCtlComAct
+        typedef SmaModbusRegister<40153, DataType::S32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40153;  //!< Inverter.WModCfg.WCtlComCfg.VarSpt
+
+        typedef SmaModbusRegister<40236, DataType::ENUM, DataFormat::RAW,  AccessMode::RW, Category::DeviceControlObject> Register40236;  //!< CmpBMS.OpMod
+
+        // same addresses as the corresponding SmaModbus::RegisterXXXXX() definitions
+        typedef SmaModbusRegister<44431, DataType::U32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40793;  //!< CmpBMS.BatChaMinW
+        typedef SmaModbusRegister<44433, DataType::U32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40795;  //!< CmpBMS.BatChaMaxW
+        typedef SmaModbusRegister<44435, DataType::U32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40797;  //!< CmpBMS.BatDschMinW
+        typedef SmaModbusRegister<44437, DataType::U32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40799;  //!< CmpBMS.BatDschMaxW
+        typedef SmaModbusRegister<44439, DataType::S32,  DataFormat::FIX0, AccessMode::WO, Category::DeviceControlObject> Register40801;  //!< CmpBMS.GridWSpt
+
+        typedef SmaModbusRegister<44039, DataType::S32,  DataFormat::FIX2, AccessMode::WO, Category::DeviceControlObject> Register44039;  //!< Inverter.WModCfg.WCtlComCfg.WSptMaxNom
+        typedef SmaModbusRegister<44041, DataType::S32,  DataFormat::FIX2, AccessMode::WO, Category::DeviceControlObject> Register44041;  //!< Inverter.WModCfg.WCtlComCfg.WSptMinNom
+    };
+
+}   // namespace libsmamodbus
+
+#endif
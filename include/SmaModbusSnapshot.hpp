@@ -0,0 +1,182 @@
+#ifndef __SMAMODBUSSNAPSHOT_HPP__
+#define __SMAMODBUSSNAPSHOT_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <SmaModbus.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class publishing the registers of a read plan into a named shared memory region, such that local processes can access the
+     *  latest values without any modbus traffic, serialization or copying.
+     *  The region holds a register table laid out from the read plan and two data buffers, each guarded by a sequence counter.
+     *  The publisher writes each poll into the buffer not currently published and then switches the published buffer;
+     *  readers access the words in place and never block the publisher. A read only has to be retried, if the publisher
+     *  started to overwrite the same buffer in the meantime, i.e. if the read overlapped two publications.
+     *  Each register carries the timestamp of its last successful read; registers that could not be read by a poll keep
+     *  their previous words and timestamp.
+     */
+    class SmaModbusSnapshot {
+    public:
+        static const uint32_t MAGIC = 0x534d5348;   //!< "SMSH"
+        static const uint32_t VERSION = 1;          //!< layout version
+
+        /**
+         *  Class describing the region header; all offsets are in bytes from the start of the region.
+         */
+        class Header {
+        public:
+            uint32_t magic;                     //!< MAGIC
+            uint32_t version;                   //!< VERSION
+            uint32_t numRegisters;              //!< Number of registers
+            uint32_t numWords;                  //!< Number of words of all registers
+            uint64_t size;                      //!< Size of the region
+            uint64_t bufferOffset[2];           //!< Offsets of both data buffers
+            std::atomic<uint64_t> generation;   //!< Number of publications; the published buffer is bufferOffset[generation & 1]
+        };
+
+        /**
+         *  Class describing a register in the register table, which follows the header.
+         */
+        class Entry {
+        public:
+            uint16_t addr;              //!< Modbus address
+            uint16_t size;              //!< Number of 16-bit words
+            uint8_t unitID;             //!< Modbus unit id
+            uint8_t type;               //!< SMA data type
+            uint8_t format;             //!< SMA data format
+            uint8_t mode;               //!< SMA access mode
+            uint8_t category;           //!< SMA register category
+            uint8_t reserved[3];
+            uint32_t offset;            //!< Offset of the register words in the words of a data buffer
+        };
+
+        /**
+         *  Class describing a data buffer header; it is followed by a timestamp for each register and the words of all registers.
+         */
+        class BufferHeader {
+        public:
+            std::atomic<uint64_t> sequence;     //!< Sequence counter; odd while the buffer is being written
+            uint64_t timestamp;                 //!< Time of the publication in microseconds since the epoch
+        };
+
+        /**
+         *  Class providing zero-copy access to a published buffer; check isConsistent() after accessing the words,
+         *  to ensure they have not been overwritten by the publisher while being accessed.
+         */
+        class View {
+        protected:
+            const SmaModbusSnapshot* snapshot;
+            const BufferHeader* buffer;
+            uint64_t sequence;
+            uint64_t generation;
+
+        public:
+            View(const SmaModbusSnapshot* owner, const BufferHeader* published, uint64_t seq, uint64_t gen) :
+                snapshot(owner), buffer(published), sequence(seq), generation(gen) {}
+
+            /** Get the publication number of the buffer; 0 if nothing has been published yet. */
+            uint64_t getGeneration(void) const { return generation; }
+
+            /** Get the time of the publication in microseconds since the epoch. */
+            uint64_t getTimestamp(void) const { return buffer->timestamp; }
+
+            /** Get the time of the last successful read of the given register in microseconds since the epoch; 0 if never read. */
+            uint64_t getTimestamp(size_t index) const { return snapshot->getTimestamps(buffer)[index]; }
+
+            /** Get the words of the given register; NULL if the register has never been read. */
+            const uint16_t* getWords(size_t index) const {
+                return (getTimestamp(index) != 0 ? snapshot->getWords(buffer) + snapshot->entries[index].offset : NULL);
+            }
+
+            /** Get a view of the given register for decoding; see SmaModbus::RawRegisterView. */
+            SmaModbus::RawRegisterView getView(size_t index) const { return SmaModbus::RawRegisterView(snapshot->definitions[index], getWords(index)); }
+
+            /** Check if the buffer has not been overwritten since the view was taken. */
+            bool isConsistent(void) const {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return buffer->sequence.load(std::memory_order_relaxed) == sequence;
+            }
+        };
+
+    protected:
+        std::string name;
+        uint8_t* region;
+        size_t region_size;
+        bool owner;
+        const Entry* entries;
+        std::vector<SmaModbus::RegisterDefinition> definitions;
+#ifdef _WIN32
+        void* mapping;
+#endif
+
+        Header* getHeader(void) const { return (Header*)region; }
+        BufferHeader* getBuffer(size_t index) const { return (BufferHeader*)(region + getHeader()->bufferOffset[index]); }
+        const uint64_t* getTimestamps(const BufferHeader* buffer) const { return (const uint64_t*)(buffer + 1); }
+        const uint16_t* getWords(const BufferHeader* buffer) const { return (const uint16_t*)(getTimestamps(buffer) + getHeader()->numRegisters); }
+        bool map(size_t size, bool create);
+        bool validate(void);
+
+    public:
+        /** Constructor; the snapshot is not open. */
+        SmaModbusSnapshot(void);
+
+        /** Destructor; close the snapshot. */
+        ~SmaModbusSnapshot(void) { close(); }
+
+        SmaModbusSnapshot(const SmaModbusSnapshot&) = delete;
+        SmaModbusSnapshot& operator=(const SmaModbusSnapshot&) = delete;
+
+        /**
+         *  Create the shared memory region for publishing the registers of the given read plan; an existing region of the
+         *  same name is replaced. The region is removed when the publisher closes it; readers keep their mapping until they close.
+         *  @param region_name name of the region, e.g. "/smamodbus" on posix systems or "Local\\smamodbus" on windows
+         *  @param plan the read plan; the registers must not change afterwards
+         *  @return true if successful
+         */
+        bool create(const std::string& region_name, const SmaModbus::ReadPlan& plan);
+
+        /**
+         *  Open an existing shared memory region for reading.
+         *  @param region_name name of the region
+         *  @return true if successful, false if the region does not exist or has an incompatible layout
+         */
+        bool open(const std::string& region_name);
+
+        /** Close the region; the region is removed if it has been created by this snapshot. */
+        void close(void);
+
+        /** Check if the region is open. */
+        bool isOpen(void) const { return region != NULL; }
+
+        /**
+         *  Publish the words of the last poll of the given read plan; see SmaModbus::pollRegisters().
+         *  @param plan the read plan passed to create()
+         */
+        void publish(const SmaModbus::ReadPlan& plan);
+
+        /** Get the number of registers. */
+        size_t getNumRegisters(void) const { return definitions.size(); }
+
+        /** Get the definition of the given register; the identifier and description are not shared and left empty. */
+        const SmaModbus::RegisterDefinition& getRegister(size_t index) const { return definitions[index]; }
+
+        /** Get the unit id of the given register. */
+        SmaModbusUnitID getUnitID(size_t index) const { return (SmaModbusUnitID)entries[index].unitID; }
+
+        /**
+         *  Get a view of the latest published buffer; this does not wait for the publisher, unless it is about to
+         *  overwrite the latest buffer.
+         *  @return the view
+         */
+        View getView(void) const;
+    };
+
+}   // namespace libsmamodbus
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef __SMAMODBUSSOCKET_HPP__
+#define __SMAMODBUSSOCKET_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class encapsulating a blocking tcp socket for modbus tcp communication.
+     *  A socket is either connected to a peer, or listening for incoming connections as used by a modbus tcp server.
+     *  Errors are reported by throwing MB::ModbusException with error codes ConnectionClosed or Timeout.
+     */
+    class SmaModbusSocket {
+    public:
+#ifdef _WIN32
+        typedef uintptr_t SocketHandle;     //!< SOCKET type from winsock2.h
+#else
+        typedef int SocketHandle;           //!< posix file descriptor
+#endif
+        static const SocketHandle INVALID_HANDLE = (SocketHandle)-1;
+
+        /**
+         *  Class holding the tcp options applied to connected sockets.
+         *  The defaults disable Nagle's algorithm, as modbus requests are small and wait for their response, and enable
+         *  keepalive probes, such that a dead peer is detected before the next request fails.
+         */
+        class Options {
+        public:
+            bool noDelay;               //!< Set TCP_NODELAY, i.e. send small frames without delay
+            bool keepAlive;             //!< Enable tcp keepalive probes
+            int keepAliveIdle;          //!< Idle time in seconds before the first keepalive probe, 0 for the system default
+            int keepAliveInterval;      //!< Time in seconds between keepalive probes, 0 for the system default
+            int keepAliveCount;         //!< Number of unanswered keepalive probes before the connection is dropped, 0 for the system default
+            int sendBufferSize;         //!< Socket send buffer size in bytes, 0 for the system default
+            int receiveBufferSize;      //!< Socket receive buffer size in bytes, 0 for the system default
+            int connectTimeout;         //!< Connect timeout in milliseconds, -1 to wait for the system connect timeout
+            int timeout;                //!< Timeout in milliseconds applied to send and receive operations
+
+            Options(void) : noDelay(true), keepAlive(true), keepAliveIdle(30), keepAliveInterval(10), keepAliveCount(3),
+                sendBufferSize(0), receiveBufferSize(0), connectTimeout(3000), timeout(5000) {}
+        };
+
+    private:
+        SocketHandle handle;
+        Options options;
+
+    public:
+        /** Constructor; the socket is not connected. */
+        SmaModbusSocket(void) : handle(INVALID_HANDLE) {}
+
+        /** Destructor; close the socket. */
+        ~SmaModbusSocket(void) { close(); }
+
+        SmaModbusSocket(const SmaModbusSocket&) = delete;
+        SmaModbusSocket& operator=(const SmaModbusSocket&) = delete;
+
+        /**
+         *  Connect to the given peer, applying the tcp options; an already open connection is closed before.
+         *  Each address of the peer is tried for at most the connect timeout.
+         *  @param peer ip address or host name of the peer
+         *  @param port tcp port of the peer
+         */
+        void connect(const std::string& peer, uint16_t port);
+
+        /**
+         *  Listen for incoming connections on the given local address; an already open socket is closed before.
+         *  @param addr local ip address or host name to bind to, e.g. "127.0.0.1"; an empty string binds to all local addresses
+         *  @param port local tcp port
+         *  @param backlog maximum number of pending connections
+         */
+        void listen(const std::string& addr, uint16_t port, int backlog = 16);
+
+        /**
+         *  Accept a pending connection of a listening socket; the tcp options of the client socket are applied to the connection.
+         *  @param client socket receiving the accepted connection; an already open connection is closed before
+         *  @return true if a connection was accepted
+         */
+        bool accept(SmaModbusSocket& client);
+
+        /** Close the socket. */
+        void close(void);
+
+        /** Check if the socket is connected. */
+        bool isOpen(void) const { return handle != INVALID_HANDLE; }
+
+        /** Get the underlying socket handle. */
+        SocketHandle getHandle(void) const { return handle; }
+
+        /** Get the timeout in milliseconds applied to send and receive operations. */
+        int getTimeout(void) const { return options.timeout; }
+
+        /** Set the timeout in milliseconds applied to send and receive operations. */
+        void setTimeout(int milliseconds) { options.timeout = milliseconds; }
+
+        /** Get the tcp options. */
+        const Options& getOptions(void) const { return options; }
+
+        /**
+         *  Set the tcp options; they are applied by the next connect(), and to an already connected socket where possible.
+         *  @param socket_options the options
+         */
+        void setOptions(const Options& socket_options);
+
+        /**
+         *  Apply the given tcp options to a socket handle, e.g. to the connection of another modbus implementation.
+         *  Options not supported by the platform are skipped; buffer sizes apply best before the socket is connected.
+         *  @param fd the socket handle
+         *  @param socket_options the options
+         *  @param set_io_timeouts also set SO_RCVTIMEO and SO_SNDTIMEO from the timeout, for sockets read without polling
+         *  @return true if all supported options have been applied
+         */
+        static bool applyOptions(SocketHandle fd, const Options& socket_options, bool set_io_timeouts = false);
+
+        /**
+         *  Send all bytes of the given buffer.
+         *  @param buffer data to be sent
+         *  @param size number of bytes to be sent
+         */
+        void send(const uint8_t* buffer, size_t size);
+
+        /**
+         *  Receive exactly size bytes into the given buffer.
+         *  @param buffer buffer receiving the data
+         *  @param size number of bytes to be received
+         */
+        void receive(uint8_t* buffer, size_t size);
+
+        /**
+         *  Receive the bytes that are available without blocking, i.e. after waitReadable() reported the socket as readable.
+         *  @param buffer buffer receiving the data
+         *  @param size size of the buffer; must be greater than 0
+         *  @return number of bytes received
+         */
+        size_t receiveAvailable(uint8_t* buffer, size_t size);
+
+        /**
+         *  Wait until at least one of the given sockets is readable, has a pending connection, or has been closed by the peer.
+         *  @param sockets the open sockets to wait for
+         *  @param num_sockets number of sockets
+         *  @param timeout_ms maximum time to wait in milliseconds, -1 to wait without time limit
+         *  @param readable output array of num_sockets elements receiving the indices of the readable sockets
+         *  @return the number of readable sockets, 0 in case of a timeout
+         */
+        static size_t waitReadable(SmaModbusSocket* const* sockets, size_t num_sockets, int timeout_ms, size_t* readable);
+
+    private:
+        //!< wait until the socket becomes readable or writable, throw a timeout exception otherwise
+        void wait(bool for_write);
+    };
+
+}   // namespace libsmamodbus
+
+#endif
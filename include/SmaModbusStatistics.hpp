@@ -0,0 +1,99 @@
+#ifndef __SMAMODBUSSTATISTICS_HPP__
+#define __SMAMODBUSSTATISTICS_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <string>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class counting requests, errors and connections of a modbus connection, together with a histogram of request latencies.
+     *  Counters are updated without locks, so they can be sampled periodically by a monitoring thread, e.g. to detect
+     *  latency creep, growing error rates or leaking connections in long-running installations.
+     */
+    class SmaModbusStatistics {
+    public:
+        static const size_t NUM_BUCKETS = 32;   //!< latency bucket i counts latencies below 2^(i+1) microseconds and not below 2^i
+
+        /**
+         *  Class holding a copy of all counters.
+         */
+        class Snapshot {
+        public:
+            uint64_t requests;                  //!< Number of requests sent
+            uint64_t errors;                    //!< Number of failed requests, including timeouts
+            uint64_t timeouts;                  //!< Number of requests failed by a timeout
+            uint64_t connects;                  //!< Number of connections established, including reconnects after transport errors
+            uint64_t disconnects;               //!< Number of connections closed after transport errors
+            uint64_t wordsRead;                 //!< Number of words read successfully
+            uint64_t wordsWritten;              //!< Number of words written successfully
+            uint64_t histogram[NUM_BUCKETS];    //!< Request latency histogram, see NUM_BUCKETS
+
+            Snapshot(void);
+
+            /** Get the number of connections currently open, or opened during the interval of a difference of snapshots. */
+            uint64_t getOpenConnections(void) const { return connects - disconnects; }
+
+            /** Get the fraction of failed requests. */
+            double getErrorRate(void) const { return (requests > 0 ? (double)errors / (double)requests : 0.0); }
+
+            /**
+             *  Get the given latency percentile from the histogram.
+             *  @param percentile the percentile, between 0 and 100, e.g. 99 for the 99th percentile
+             *  @return the upper bound of the histogram bucket holding the percentile in microseconds, 0 if there are no requests
+             */
+            uint64_t getPercentile(double percentile) const;
+
+            /** Add the counters of another snapshot, e.g. to aggregate the connections of a fleet. */
+            Snapshot& operator+=(const Snapshot& other);
+
+            /** Subtract the counters of an earlier snapshot, to get the counters of the interval in between. */
+            Snapshot& operator-=(const Snapshot& other);
+
+            /** Convert to a single-line summary of counters and latency percentiles. */
+            std::string toString(void) const;
+        };
+
+        SmaModbusStatistics(void) : connects(0), disconnects(0) { reset(); }
+        SmaModbusStatistics(const SmaModbusStatistics&) = delete;
+        SmaModbusStatistics& operator=(const SmaModbusStatistics&) = delete;
+
+        /**
+         *  Record a completed request.
+         *  @param latency_us time from issuing the request until its completion in microseconds
+         *  @param success true if the request succeeded
+         *  @param timeout true if the request failed by a timeout
+         *  @param num_words_read number of words read by a successful request
+         *  @param num_words_written number of words written by a successful request
+         */
+        void recordRequest(uint64_t latency_us, bool success, bool timeout, size_t num_words_read, size_t num_words_written);
+
+        /** Record an established connection. */
+        void recordConnect(void) { connects.fetch_add(1, std::memory_order_relaxed); }
+
+        /** Record a closed connection. */
+        void recordDisconnect(void) { disconnects.fetch_add(1, std::memory_order_relaxed); }
+
+        /** Get a copy of all counters; concurrent updates may be partially included. */
+        Snapshot getSnapshot(void) const;
+
+        /** Reset all counters to 0, except for the connection counters. */
+        void reset(void);
+
+    protected:
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> errors;
+        std::atomic<uint64_t> timeouts;
+        std::atomic<uint64_t> connects;
+        std::atomic<uint64_t> disconnects;
+        std::atomic<uint64_t> words_read;
+        std::atomic<uint64_t> words_written;
+        std::atomic<uint64_t> histogram[NUM_BUCKETS];
+    };
+
+}   // namespace libsmamodbus
+
+#endif
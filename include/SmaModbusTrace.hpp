@@ -0,0 +1,97 @@
+#ifndef __SMAMODBUSTRACE_HPP__
+#define __SMAMODBUSTRACE_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <atomic>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class recording trace spans of request phases, e.g. connection setup, encoding, network wait and decoding.
+     *  Each thread records into its own ring buffer without locks; the buffers are registered in a global list once per thread,
+     *  so that all recorded spans can be exported as Chrome trace event json, which can be opened by chrome://tracing or Perfetto.
+     *  The buffer of a finished thread is handed to the next thread that starts recording, discarding the spans not yet exported;
+     *  the number of buffers is therefore bounded by the maximum number of threads recording at the same time, using
+     *  BUFFER_SIZE * 24 bytes, i.e. 96 KiB, each.
+     *  Spans are placed by the SMAMODBUS_TRACE_SPAN macro, which compiles to nothing unless SMAMODBUS_ENABLE_TRACE is defined.
+     */
+    class SmaModbusTrace {
+    public:
+        static const size_t BUFFER_SIZE = 4096;     //!< number of spans kept per thread; older spans are overwritten
+
+        /**
+         *  Class holding a single span.
+         */
+        class Span {
+        public:
+            const char* name;   //!< Span name; must be a string literal or otherwise outlive the trace
+            uint64_t begin;     //!< Begin timestamp in nanoseconds, see now()
+            uint64_t end;       //!< End timestamp in nanoseconds, see now()
+        };
+
+        /** Get a monotonic timestamp in nanoseconds. */
+        static uint64_t now(void);
+
+        /**
+         *  Record a span into the ring buffer of the calling thread; spans are dropped while recording is disabled.
+         *  @param name span name; must be a string literal or otherwise outlive the trace
+         *  @param begin begin timestamp in nanoseconds
+         *  @param end end timestamp in nanoseconds
+         */
+        static void record(const char* name, uint64_t begin, uint64_t end);
+
+        /** Enable or disable recording at runtime; recording is enabled by default. */
+        static void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+
+        /** Check if recording is enabled. */
+        static bool isEnabled(void) { return enabled.load(std::memory_order_relaxed); }
+
+        /**
+         *  Write the spans of all threads as Chrome trace event json.
+         *  Spans recorded while the export is running may be missing; spans are never exported partially.
+         *  @param path the file path
+         *  @return true if successful
+         */
+        static bool writeChromeTrace(const std::string& path);
+
+        /** Discard the spans of all threads; must not be called while other threads record spans. */
+        static void clear(void);
+
+        /** Get the number of thread buffers allocated so far, see above. */
+        static size_t getNumBuffers(void);
+
+    protected:
+        static std::atomic<bool> enabled;
+    };
+
+
+    /**
+     *  Class recording a span from its construction to its destruction; see SMAMODBUS_TRACE_SPAN.
+     */
+    class SmaModbusTraceSpan {
+        const char* name;
+        uint64_t begin;
+    public:
+        SmaModbusTraceSpan(const char* span_name) : name(span_name), begin(SmaModbusTrace::now()) {}
+        ~SmaModbusTraceSpan(void) { SmaModbusTrace::record(name, begin, SmaModbusTrace::now()); }
+        SmaModbusTraceSpan(const SmaModbusTraceSpan&) = delete;
+        SmaModbusTraceSpan& operator=(const SmaModbusTraceSpan&) = delete;
+    };
+
+}   // namespace libsmamodbus
+
+
+#define SMAMODBUS_TRACE_CONCAT_(a, b) a##b
+#define SMAMODBUS_TRACE_CONCAT(a, b) SMAMODBUS_TRACE_CONCAT_(a, b)
+
+/** Record a span named by the given string literal until the end of the enclosing scope. */
+#ifdef SMAMODBUS_ENABLE_TRACE
+#define SMAMODBUS_TRACE_SPAN(name) libsmamodbus::SmaModbusTraceSpan SMAMODBUS_TRACE_CONCAT(smamodbus_trace_span_, __LINE__)(name)
+#else
+#define SMAMODBUS_TRACE_SPAN(name) ((void)0)
+#endif
+
+#endif
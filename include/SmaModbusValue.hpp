@@ -22,6 +22,7 @@ namespace libsmamodbus {
         STR32 = 6,
     };
     std::string toString(const DataType& type);
+    const char* toName(const DataType& type);       //!< same as toString(type), without heap allocation
 
     /**
      *  Enumeration of data formats used in SMA modbus registers.
@@ -40,6 +41,7 @@ namespace libsmamodbus {
         FIRMWARE = 11
     };
     std::string toString(const DataFormat& format);
+    const char* toName(const DataFormat& format);   //!< same as toString(format), without heap allocation
 
     /**
      *  Class holding an SMA modbus data value together with its data type and data format.
@@ -89,24 +91,36 @@ namespace libsmamodbus {
                 case DataFormat::FIX4: value *= 10000.0; break;
                 }
             }
+            // round half away from zero; adding 0.5 instead would round values just below 0.5 up. Values outside the range
+            // of the data type are mapped to NaN, as casting them is undefined behaviour
+            const double rounded = std::round(value);
             switch (type) {
-            case DataType::U32:  u64 = (uint64_t)(value >= 0 && isValid ? (uint64_t)(uint32_t)(value + 0.5) : U32_NaN); break;
-            case DataType::S32:  u64 = (uint64_t)(isValid ? (uint64_t)(uint32_t)(int32_t)(value >= 0 ? value + 0.5 : value - 0.5) : S32_NaN); break;
-            case DataType::U64:  u64 = (uint64_t)(value >= 0 && isValid ? (uint64_t)(value + 0.5) : U64_NaN); break;
-            case DataType::S64:  u64 = (uint64_t)(isValid ? (uint64_t)(int64_t)(value >= 0 ? value + 0.5 : value - 0.5) : S64_NaN); break;
-            case DataType::ENUM: u64 = (uint64_t)(value >= 0 && isValid ? (uint64_t)(uint32_t)(value + 0.5) : Enum_NaN); break;
+            case DataType::U32:  u64 = (isValid && rounded >= 0.0 && rounded < 4294967295.0 ? (uint64_t)(uint32_t)rounded : U32_NaN); break;
+            case DataType::S32:  u64 = (isValid && rounded > -2147483648.0 && rounded < 2147483648.0 ? (uint64_t)(uint32_t)(int32_t)rounded : (uint32_t)S32_NaN); break;
+            case DataType::U64:  u64 = (isValid && rounded >= 0.0 && rounded < 18446744073709551616.0 ? (uint64_t)rounded : U64_NaN); break;
+            case DataType::S64:  u64 = (isValid && rounded > -9223372036854775808.0 && rounded < 9223372036854775808.0 ? (uint64_t)(int64_t)rounded : (uint64_t)S64_NaN); break;
+            case DataType::ENUM: u64 = (isValid && rounded >= 0.0 && rounded < 4294967296.0 ? (uint64_t)(uint32_t)rounded : Enum_NaN); break;
             }
         }
 
         /** Convert numeric value to floating point */
-        double toDouble(void) const {
+        double toDouble(void) const { return toDouble(u64, type, format); }
+
+        /**
+         *  Convert the given numeric register bit pattern to floating point.
+         *  @param value the bit pattern as read from the modbus register, with leading zeroes
+         *  @param type the data type of the register
+         *  @param format the data format of the register
+         *  @return the scaled value, or NaN if the value is an SMA NaN value or the data type is not numeric
+         */
+        static double toDouble(uint64_t value, const DataType type, const DataFormat format) {
             double result = nan("2");
             switch (type) {
-            case DataType::U32:  result = (u64 == U32_NaN ? Double_NaN : (double)u64); break;
-            case DataType::S32:  result = (u64 == S32_NaN ? Double_NaN : (double)(int64_t)u64); break;
-            case DataType::U64:  result = (u64 == S32_NaN ? Double_NaN : (double)u64); break;
-            case DataType::S64:  result = (u64 == S32_NaN ? Double_NaN : (double)(int64_t)u64); break;
-            case DataType::ENUM: result = (u64 == Enum_NaN ? Double_NaN : (double)u64); break;
+            case DataType::U32:  result = (value == U32_NaN ? Double_NaN : (double)value); break;
+            case DataType::S32:  result = (value == (uint32_t)S32_NaN ? Double_NaN : (double)(int32_t)value); break;
+            case DataType::U64:  result = (value == U64_NaN ? Double_NaN : (double)value); break;
+            case DataType::S64:  result = (value == (uint64_t)S64_NaN ? Double_NaN : (double)(int64_t)value); break;
+            case DataType::ENUM: result = (value == Enum_NaN ? Double_NaN : (double)value); break;
             }
 
             if (!isNaN(result)) {
@@ -120,42 +134,80 @@ namespace libsmamodbus {
             return result;
         }
 
+        /**
+         *  Join big endian uint16 words to a numeric register bit pattern.
+         *  @param words the words as read from the modbus register
+         *  @param num_words the number of words; at most 4
+         *  @return the bit pattern with leading zeroes
+         */
+        static uint64_t joinWords(const uint16_t* words, size_t num_words) {
+            uint64_t result = 0;
+            for (size_t i = 0; i < num_words; ++i) {
+                result = (result << 16) | words[i];
+            }
+            return result;
+        }
+
+        /**
+         *  Join big endian uint16 words to a string, two characters per word.
+         *  @param words the words as read from the modbus register
+         *  @param num_words the number of words
+         *  @return a string holding 2 * num_words characters; this may include '\0' characters
+         */
+        static std::string joinString(const uint16_t* words, size_t num_words) {
+            std::string result;
+            result.reserve(num_words * 2u);
+            for (size_t i = 0; i < num_words; ++i) {
+                result.append(1, (unsigned char)(words[i] >> 8));
+                result.append(1, (unsigned char)(words[i]));
+            }
+            return result;
+        }
+
         /** Convert value to a string representation. */
         std::string toString(void) const {
-            std::string result;
             if (type == DataType::STR32) {
-                result = str;
-            }
-            else {
-                double dvalue = toDouble();
-                if (isNaN(dvalue)) {
-                    result = "NaN";
-                }
-                else {
-                    char buffer[65];
-                    switch (format) {
-                    case DataFormat::FIX0: snprintf(buffer, sizeof(buffer), "%.0lf", dvalue); break;
-                    case DataFormat::FIX1: snprintf(buffer, sizeof(buffer), "%.1lf", dvalue); break;
-                    case DataFormat::FIX2: snprintf(buffer, sizeof(buffer), "%.2lf", dvalue); break;
-                    case DataFormat::FIX3: snprintf(buffer, sizeof(buffer), "%.3lf", dvalue); break;
-                    case DataFormat::FIX4: snprintf(buffer, sizeof(buffer), "%.4lf", dvalue); break;
-                    default:               snprintf(buffer, sizeof(buffer), "%lf", dvalue);
-                    }
-                    result = std::string(buffer);
-                }
+                return str;
             }
-            return result;
+            char buffer[MAX_FORMAT_SIZE];
+            return std::string(buffer, toChars(buffer, sizeof(buffer), u64, type, format));
         }
 
+        /**
+         *  Append the string representation of the value to the given buffer, without any heap allocation.
+         *  The output is identical to toString(); the buffer is not null-terminated.
+         *  @param buffer output buffer
+         *  @param size size of the output buffer
+         *  @return the number of characters written; 0 if the buffer is too small
+         */
+        size_t toChars(char* buffer, size_t size) const;
+
+        /**
+         *  Write the string representation of the given numeric register bit pattern to the given buffer.
+         *  FIXn values are converted straight from the scaled integer, without a round trip through double.
+         *  @param buffer output buffer
+         *  @param size size of the output buffer; MAX_FORMAT_SIZE is sufficient for all numeric values
+         *  @param value the bit pattern as read from the modbus register, with leading zeroes
+         *  @param type the data type of the register
+         *  @param format the data format of the register
+         *  @return the number of characters written; 0 if the buffer is too small
+         */
+        static size_t toChars(char* buffer, size_t size, uint64_t value, const DataType type, const DataFormat format);
+
+        static const size_t MAX_FORMAT_SIZE = 32;   //!< buffer size sufficient to format any numeric value
+
         /** Check if the value is valid. Invalid data types and NaN values are considered as invalid. */
-        bool isValid(void) const {
+        bool isValid(void) const { return isValid(u64, type); }
+
+        /** Check if the given numeric register bit pattern is valid for the given data type. */
+        static bool isValid(uint64_t value, const DataType type) {
             bool result = false;
             switch (type) {
-            case DataType::U32:  result = (u64 != U32_NaN); break;
-            case DataType::S32:  result = (u64 != (uint32_t)S32_NaN); break;
-            case DataType::U64:  result = (u64 != U64_NaN); break;
-            case DataType::S64:  result = (u64 != S64_NaN); break;
-            case DataType::ENUM: result = (u64 != Enum_NaN); break;
+            case DataType::U32:  result = (value != U32_NaN); break;
+            case DataType::S32:  result = (value != (uint32_t)S32_NaN); break;
+            case DataType::U64:  result = (value != U64_NaN); break;
+            case DataType::S64:  result = (value != S64_NaN); break;
+            case DataType::ENUM: result = (value != Enum_NaN); break;
             }
             return result;
         }
@@ -1,7 +1,13 @@
 #include <vector>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
 #include <SmaModbus.hpp>
 #include <SmaModbusValue.hpp>
+#include <SmaModbusFrame.hpp>
+#include <SmaModbusFormat.hpp>
+#include <SmaModbusTrace.hpp>
 
 using namespace MB;
 using namespace MB::TCP;
@@ -10,6 +16,10 @@ using namespace libsmamodbus;
 
 
 std::string SmaModbus::toString(const AccessMode& mode) {
+    return toName(mode);
+}
+
+const char* SmaModbus::toName(const AccessMode& mode) {
     switch (mode) {
     case AccessMode::RO:  return "RO";
     case AccessMode::WO:  return "WO";
@@ -19,6 +29,10 @@ std::string SmaModbus::toString(const AccessMode& mode) {
 }
 
 std::string SmaModbus::toString(const Category& category) {
+    return toName(category);
+}
+
+const char* SmaModbus::toName(const Category& category) {
     switch (category) {
     case Category::Normal:                  return "Normal";
     case Category::GridGuardCodeProtected:  return "GridGuardCodeProtected";
@@ -30,12 +44,41 @@ std::string SmaModbus::toString(const Category& category) {
 
 std::string SmaModbus::RegisterDefinition::toString(void) const {
     char buff[128];
-    snprintf(buff, sizeof(buff), "%u %-5s %-4s %-2s %-20s", (unsigned)addr, libsmamodbus::toString(type).c_str(), libsmamodbus::toString(format).c_str(), SmaModbus::toString(mode).c_str(), identifier.c_str());
-    return std::string(buff);
+    return std::string(buff, toChars(buff, sizeof(buff)));
+}
+
+size_t SmaModbus::RegisterDefinition::toChars(char* buffer, size_t size) const {
+    // same layout as "%u %-5s %-4s %-2s %-20s", truncated like snprintf
+    if (size == 0) {
+        return 0;
+    }
+    size_t length = 0;
+    auto append = [buffer, size, &length](const char* str, size_t len, size_t width) {
+        for (size_t i = 0; i < len || i < width; ++i) {
+            if (length + 1 < size) {
+                buffer[length++] = (i < len ? str[i] : ' ');
+            }
+        }
+    };
+    char number[8];
+    SmaModbusFormatter out(number, sizeof(number));
+    out.appendUnsigned(addr);
+    append(out.data(), out.size(), 0);
+    append(" ", 1, 0);
+    append(libsmamodbus::toName(type), strlen(libsmamodbus::toName(type)), 5);
+    append(" ", 1, 0);
+    append(libsmamodbus::toName(format), strlen(libsmamodbus::toName(format)), 4);
+    append(" ", 1, 0);
+    append(SmaModbus::toName(mode), strlen(SmaModbus::toName(mode)), 2);
+    append(" ", 1, 0);
+    append(identifier.data(), identifier.size(), 20);
+    buffer[length] = '\0';
+    return length;
 }
 
 
 SmaModbusValue SmaModbus::readRegister(const RegisterDefinition& reg, bool print) {
+    SMAMODBUS_TRACE_SPAN("readRegister");
     SmaModbusException exception;
     SmaModbusValue value;
 
@@ -50,11 +93,13 @@ SmaModbusValue SmaModbus::readRegister(const RegisterDefinition& reg, bool print
         case DataType::U64:
         case DataType::ENUM: {
             uint64_t int_value = readUint(reg.addr, reg.size * 2u, exception, false, true);
+            SMAMODBUS_TRACE_SPAN("decode");
             value = SmaModbusValue(int_value, (exception.hasError() ? DataType::INVALID : reg.type), reg.format);
             break;
         }
         case DataType::STR32:{
             std::string str_value = readString(reg.addr, reg.size * 2u, exception, false, true);
+            SMAMODBUS_TRACE_SPAN("decode");
             value = SmaModbusValue(str_value, (exception.hasError() ? DataType::INVALID : reg.type), reg.format);
             break;
         }
@@ -75,6 +120,7 @@ SmaModbusValue SmaModbus::readRegister(const RegisterDefinition& reg, bool print
 
 
 bool SmaModbus::writeRegister(const RegisterDefinition& reg, const SmaModbusValue& value, bool print) {
+    SmaModbusArbiter::PriorityScope scope(getWritePriority(reg.category));
     SmaModbusException exception;
     bool result = false;
 
@@ -111,6 +157,285 @@ bool SmaModbus::writeRegister(const RegisterDefinition& reg, const SmaModbusValu
 }
 
 
+SmaModbus::ReadPlan SmaModbus::createReadPlan(const std::vector<RegisterDefinition>& registers, const std::vector<SmaModbusUnitID>& unit_ids, uint16_t max_gap) {
+    ReadPlan plan;
+    plan.registers = registers;
+    plan.unitIDs = unit_ids;
+    plan.unitIDs.resize(registers.size(), getUnitID());
+    plan.order.resize(registers.size());
+    for (size_t i = 0; i < plan.order.size(); ++i) {
+        plan.order[i] = i;
+    }
+    const std::vector<SmaModbusUnitID>& ids = plan.unitIDs;
+    std::stable_sort(plan.order.begin(), plan.order.end(), [&registers, &ids](size_t a, size_t b) {
+        return (ids[a] != ids[b] ? ids[a] < ids[b] : registers[a].addr < registers[b].addr);
+    });
+
+    for (size_t i = 0; i < plan.order.size(); ++i) {
+        const RegisterDefinition& reg = plan.registers[plan.order[i]];
+        const SmaModbusUnitID unit_id = plan.unitIDs[plan.order[i]];
+        if (!plan.blocks.empty() && plan.blocks.back().unitID == unit_id) {
+            // try to extend the current block by the next register
+            ReadBlock& block = plan.blocks.back();
+            uint32_t block_end = (uint32_t)block.addr + block.size;
+            uint32_t reg_end = (uint32_t)reg.addr + reg.size;
+            uint32_t size = std::max(block_end, reg_end) - block.addr;
+            uint32_t gap = (reg.addr > block_end ? reg.addr - block_end : 0);
+            if (size <= SmaModbusFrame::MAX_READ_WORDS && !limits.isUnreadable(unit_id, block.addr, (uint16_t)size) &&
+                (gap <= max_gap || limits.isReadable(unit_id, block.addr, (uint16_t)size))) {
+                block.size = (uint16_t)size;
+                block.count++;
+                continue;
+            }
+        }
+        plan.blocks.push_back(ReadBlock(unit_id, reg.addr, reg.size, i, 1));
+    }
+
+    // assign a slot in the shared word buffer to each register
+    plan.offsets.resize(registers.size());
+    size_t num_words = 0;
+    for (size_t i = 0; i < registers.size(); ++i) {
+        plan.offsets[i] = num_words;
+        num_words += registers[i].size;
+    }
+    plan.words.assign(num_words, 0);
+    plan.valid.assign(registers.size(), false);
+    return plan;
+}
+
+
+std::vector<SmaModbusValue> SmaModbus::readRegisters(ReadPlan& plan) {
+    readPlan(plan);
+    SMAMODBUS_TRACE_SPAN("decode");
+    std::vector<SmaModbusValue> values;
+    values.reserve(plan.registers.size());
+    for (size_t i = 0; i < plan.registers.size(); ++i) {
+        values.push_back(plan.getView(i).toValue());
+    }
+    return values;
+}
+
+
+size_t SmaModbus::pollRegisters(ReadPlan& plan) {
+    // background polling must not delay interactive reads and control writes of other threads
+    SmaModbusArbiter::PriorityScope scope(SmaModbusArbiter::Priority::Bulk);
+    return readPlan(plan);
+}
+
+
+size_t SmaModbus::readPlan(ReadPlan& plan) {
+    SMAMODBUS_TRACE_SPAN("pollRegisters");
+    size_t num_valid = 0;
+    std::fill(plan.valid.begin(), plan.valid.end(), false);
+
+    // compute the block covering the given range of registers
+    auto makeBlock = [&plan](SmaModbusUnitID unit_id, size_t first, size_t count) {
+        uint32_t begin = plan.registers[plan.order[first]].addr;
+        uint32_t end = begin;
+        for (size_t i = first; i < first + count; ++i) {
+            const RegisterDefinition& reg = plan.registers[plan.order[i]];
+            end = std::max(end, (uint32_t)reg.addr + reg.size);
+        }
+        return ReadBlock(unit_id, (uint16_t)begin, (uint16_t)(end - begin), first, count);
+    };
+
+    // read all blocks in one burst, pipelined up to the pipeline window; bisected blocks are read in further bursts
+    std::vector<ReadBlock> blocks;
+    std::vector<ReadBlock> pending = plan.blocks;
+    std::vector<uint16_t> words;
+    std::vector<ReadRequest> requests;
+    while (!pending.empty()) {
+        words.resize(pending.size() * SmaModbusFrame::MAX_READ_WORDS);
+        requests.clear();
+        for (size_t b = 0; b < pending.size(); ++b) {
+            requests.push_back(ReadRequest(pending[b].unitID, pending[b].addr, pending[b].size, &words[b * SmaModbusFrame::MAX_READ_WORDS]));
+        }
+        readBlocks(requests.data(), requests.size(), false);
+
+        SMAMODBUS_TRACE_SPAN("copy");
+        std::vector<ReadBlock> retry;
+        for (size_t b = 0; b < pending.size(); ++b) {
+            const ReadBlock& block = pending[b];
+            const SmaModbusException& exception = requests[b].exception;
+            if (!exception.hasError()) {
+                if (block.count > 1) {
+                    limits.markReadable(block.unitID, block.addr, block.size);
+                }
+                const uint16_t* block_words = requests[b].words;
+                for (size_t i = block.first; i < block.first + block.count; ++i) {
+                    const size_t index = plan.order[i];
+                    const RegisterDefinition& reg = plan.registers[index];
+                    std::copy(block_words + (reg.addr - block.addr), block_words + (reg.addr - block.addr + reg.size), plan.words.begin() + plan.offsets[index]);
+                    plan.valid[index] = true;
+                    ++num_valid;
+                }
+            }
+            else if (exception.getErrorCode() == (SmaModbusErrorCode)MBErrorCode::IllegalDataAddress && block.count > 1) {
+                // the block spans an address range the device does not accept; bisect it and retry both halves
+                limits.markUnreadable(block.unitID, block.addr, block.size);
+                size_t half = block.count / 2;
+                retry.push_back(makeBlock(block.unitID, block.first, half));
+                retry.push_back(makeBlock(block.unitID, block.first + half, block.count - half));
+                continue;
+            }
+            else {
+                printf("readRegisters(%lu, %lu) => %s\n", (unsigned long)block.addr, (unsigned long)block.size, exception.toString().c_str());
+            }
+            blocks.push_back(block);
+        }
+        pending.swap(retry);
+    }
+
+    // keep the refined blocks in register order for subsequent polls
+    std::sort(blocks.begin(), blocks.end(), [](const ReadBlock& a, const ReadBlock& b) { return a.first < b.first; });
+    plan.blocks.swap(blocks);
+    return num_valid;
+}
+
+
+bool SmaModbus::sweepRegisters(SweepCursor& cursor, const SweepSink& sink, uint64_t max_requests) {
+    SMAMODBUS_TRACE_SPAN("sweepRegisters");
+    SmaModbusArbiter::PriorityScope scope(SmaModbusArbiter::Priority::Bulk);
+    // sma registers start at odd addresses and span an even number of words; blocks are therefore bisected into even sized
+    // halves, as devices reject reads of partial registers. the few catalog registers starting at an even address are off
+    // this register grid; blocks end right before them, and they are read on their own
+    const std::vector<RegisterDefinition>& catalog = getRegisterCatalog();
+    const uint16_t max_size = (uint16_t)(SmaModbusFrame::MAX_READ_WORDS & ~1u);
+    const uint16_t min_size = 2;
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+    struct { uint16_t addr; uint16_t size; } stack[16];     // bisection depth is log2(max_size / min_size) + 1
+    size_t depth = 0;
+    uint64_t num_requests = 0;
+    bool interrupted = false;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    while (!interrupted && cursor.next < cursor.end) {
+        auto off_grid = std::lower_bound(catalog.begin(), catalog.end(), cursor.next, [](const RegisterDefinition& reg, uint32_t a) { return reg.addr < a; });
+        while (off_grid != catalog.end() && (off_grid->addr & 1u) != 0) {
+            ++off_grid;
+        }
+        uint16_t size;
+        if ((cursor.next & 1u) == 0) {
+            if (off_grid == catalog.end() || off_grid->addr != cursor.next) {
+                // align the sweep to the register grid; a register starting before the end address is read completely
+                ++cursor.next;
+                continue;
+            }
+            size = off_grid->size;
+        }
+        else if (off_grid != catalog.end() && off_grid->addr == cursor.next + 1u) {
+            // the word right before a register off the grid does not start a register
+            ++cursor.next;
+            continue;
+        }
+        else {
+            size = (uint16_t)std::min<uint32_t>({ max_size, (cursor.end - cursor.next + 1u) & ~1u, (0x10000u - cursor.next) & ~1u });
+            if (off_grid != catalog.end() && off_grid->addr < cursor.next + size) {
+                size = (uint16_t)(off_grid->addr - 1u - cursor.next);
+            }
+            if (size < min_size) {
+                // a register cannot start at the last address
+                cursor.next = cursor.end;
+                break;
+            }
+            while (size > min_size && limits.isUnreadable(cursor.unitID, (uint16_t)cursor.next, size)) {
+                size = (uint16_t)(((size / 2u) + 1u) & ~1u);
+            }
+        }
+        stack[0].addr = (uint16_t)cursor.next;
+        stack[0].size = size;
+        depth = 1;
+
+        while (depth > 0) {
+            if (max_requests != 0 && num_requests >= max_requests) {
+                interrupted = true;
+                break;
+            }
+            const uint16_t addr = stack[depth - 1].addr;
+            const uint16_t num_words = stack[depth - 1].size;
+            --depth;
+
+            SmaModbusException exception;
+            ++num_requests;
+            ++cursor.requests;
+            if (readWords(cursor.unitID, addr, words, num_words, exception, false, false) == num_words) {
+                if (num_words > min_size) {
+                    limits.markReadable(cursor.unitID, addr, num_words);
+                }
+                cursor.wordsRead += num_words;
+                cursor.next = (uint32_t)addr + num_words;
+                if (!sink(cursor.unitID, addr, words, num_words)) {
+                    interrupted = true;
+                    break;
+                }
+            }
+            else if (exception.getErrorCode() == (SmaModbusErrorCode)MBErrorCode::IllegalDataAddress) {
+                if (num_words > min_size) {
+                    // push the upper half first, such that the lower half is read first
+                    limits.markUnreadable(cursor.unitID, addr, num_words);
+                    uint16_t half = (uint16_t)((num_words / 2u) & ~1u);
+                    half = std::max(half, min_size);
+                    stack[depth].addr = (uint16_t)(addr + half);
+                    stack[depth++].size = (uint16_t)(num_words - half);
+                    stack[depth].addr = addr;
+                    stack[depth++].size = half;
+                }
+                else {
+                    cursor.wordsRejected += num_words;
+                    cursor.next = (uint32_t)addr + num_words;
+                }
+            }
+            else {
+                // transport errors and other exceptions interrupt the sweep; it can be resumed at the cursor position
+                printf("sweepRegisters(%lu, %lu) => %s\n", (unsigned long)addr, (unsigned long)num_words, exception.toString().c_str());
+                interrupted = true;
+                break;
+            }
+        }
+    }
+    cursor.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    return !interrupted;
+}
+
+
+bool SmaModbus::sweepKnownRegisters(SweepCursor& cursor, const SweepRegisterSink& sink, uint64_t max_requests) {
+    const std::vector<RegisterDefinition>& catalog = getRegisterCatalog();
+    return sweepRegisters(cursor, [&catalog, &sink](SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* words, size_t num_words) {
+        const uint32_t end = (uint32_t)addr + num_words;
+        auto it = std::lower_bound(catalog.begin(), catalog.end(), addr, [](const RegisterDefinition& reg, uint16_t a) { return reg.addr < a; });
+        for (; it != catalog.end() && (uint32_t)it->addr + it->size <= end; ++it) {
+            if (!sink(unit_id, RawRegisterView(*it, words + (it->addr - addr)))) {
+                return false;
+            }
+        }
+        return true;
+    }, max_requests);
+}
+
+
+const std::vector<SmaModbus::RegisterDefinition>& SmaModbus::getRegisterCatalog(void) {
+    static const std::vector<RegisterDefinition> catalog = [] {
+        std::vector<RegisterDefinition> registers = {
+            Register30001(), Register30003(), Register30005(), Register30051(), Register30053(), Register30059(), Register30193(),
+            Register30233(), Register30843(), Register30845(), Register30847(), Register30857(), Register30955(), Register30865(),
+            Register30867(), Register31259(), Register31261(), Register31263(), Register31265(), Register31267(), Register31269(),
+            Register40149(), Register40151(), Register40153(), Register40236(), Register40793(), Register40795(), Register40797(),
+            Register40799(), Register40801(), Register44039(), Register44041()
+        };
+        std::sort(registers.begin(), registers.end(), [](const RegisterDefinition& a, const RegisterDefinition& b) { return a.addr < b.addr; });
+        return registers;
+    }();
+    return catalog;
+}
+
+
+const SmaModbus::RegisterDefinition* SmaModbus::findRegister(uint16_t addr) {
+    const std::vector<RegisterDefinition>& catalog = getRegisterCatalog();
+    auto it = std::lower_bound(catalog.begin(), catalog.end(), addr, [](const RegisterDefinition& reg, uint16_t a) { return reg.addr < a; });
+    return (it != catalog.end() && it->addr == addr ? &*it : NULL);
+}
+
+
 std::vector<SmaModbus::SmaModbusDeviceEntry> SmaModbus::getDeviceMap(void) {
     std::vector <SmaModbusDeviceEntry> entries;
     SmaModbusException exception;
@@ -136,11 +461,14 @@ std::vector<SmaModbus::SmaModbusDeviceEntry> SmaModbus::getDeviceMap(void) {
         addr += 4u;
     }
     setUnitID(previous_id);
+    device_map = entries;
     return entries;
 }
 
 
 void SmaModbus::printRegister(const RegisterDefinition& reg, const SmaModbusValue& value) const {
+    char label[128];
+    reg.toChars(label, sizeof(label));
     switch (reg.type) {
     case DataType::S32:
     case DataType::U32:
@@ -152,18 +480,18 @@ void SmaModbus::printRegister(const RegisterDefinition& reg, const SmaModbusValu
             reg_value = SmaModbusValue(value.toDouble(), reg.type, reg.format).u64; // apply the register type and format to the given value
         }
         if (value.isValid()) {
-            printf("%s:  %08llx %llu\n", reg.toString().c_str(), value.u64, value.u64);
+            printf("%s:  %08llx %llu\n", label, value.u64, value.u64);
         }
         else {
-            printf("%s:  %08llx NaN\n", reg.toString().c_str(), value.u64);
+            printf("%s:  %08llx NaN\n", label, value.u64);
         }
         break;
     }
     case DataType::STR32:
-        printf("%s:  %s\n", reg.toString().c_str(), value.str.c_str());
+        printf("%s:  %s\n", label, value.str.c_str());
         break;
     default: {
-        printf("%s:  %08llx %llu %s\n", reg.toString().c_str(), value.u64, value.u64, value.str.c_str());
+        printf("%s:  %08llx %llu %s\n", label, value.u64, value.u64, value.str.c_str());
         break;
     }
     }
@@ -181,3 +509,149 @@ uint8_t SmaModbus::setDefaultUnitID(void) {
     }
     return SmaModbusUnitID::MAX;
 }
+
+
+SmaModbus::Nameplate SmaModbus::readNameplate(void) {
+    static const std::vector<RegisterDefinition> registers = { Register30003(), Register30005(), Register30051(), Register30053(), Register30059() };
+    std::vector<SmaModbusValue> values = readRegisters(registers);
+    Nameplate result;
+    result.susyID          = (values[0].isValid() ? (uint32_t)values[0].u64 : 0);
+    result.serialNumber    = (values[1].isValid() ? (uint32_t)values[1].u64 : 0);
+    result.mainModel       = (values[2].isValid() ? (uint32_t)values[2].u64 : 0);
+    result.model           = (values[3].isValid() ? (uint32_t)values[3].u64 : 0);
+    result.packageRevision = (values[4].isValid() ? (uint32_t)values[4].u64 : 0);
+    nameplate = result;
+    return result;
+}
+
+
+bool SmaModbus::saveState(const std::string& path, const ReadPlan* plan) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+    fprintf(file, "smamodbus-state %u\n", STATE_VERSION);
+    fprintf(file, "unit %u\n", (unsigned)getUnitID());
+    for (const auto& entry : device_map) {
+        fprintf(file, "device %u %lu %u\n", (unsigned)entry.susyID, (unsigned long)entry.serialNumber, (unsigned)entry.unitID);
+    }
+    fprintf(file, "nameplate %lu %lu %lu %lu %lu\n", (unsigned long)nameplate.susyID, (unsigned long)nameplate.serialNumber,
+        (unsigned long)nameplate.mainModel, (unsigned long)nameplate.model, (unsigned long)nameplate.packageRevision);
+    if (plan != NULL) {
+        for (size_t i = 0; i < plan->registers.size(); ++i) {
+            fprintf(file, "register %u %u\n", (unsigned)plan->registers[i].addr, (unsigned)plan->unitIDs[i]);
+        }
+        for (const auto& block : plan->blocks) {
+            fprintf(file, "block %u %u %u %lu %lu\n", (unsigned)block.unitID, (unsigned)block.addr, (unsigned)block.size, (unsigned long)block.first, (unsigned long)block.count);
+        }
+    }
+    fprintf(file, "limits\n");
+    bool result = limits.write(file);
+    return (fclose(file) == 0) && result;
+}
+
+
+bool SmaModbus::loadState(const std::string& path, ReadPlan* plan, bool* plan_restored) {
+    if (plan_restored != NULL) {
+        *plan_restored = false;
+    }
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    unsigned unit_id = 0;
+    std::vector<SmaModbusDeviceEntry> state_map;
+    Nameplate state_nameplate;
+    std::vector<uint16_t> state_registers;
+    std::vector<unsigned> state_units;
+    std::vector<ReadBlock> state_blocks;
+    SmaModbusDeviceLimits state_limits;
+
+    char line[128];
+    unsigned version = 0;
+    bool valid = (fgets(line, sizeof(line), file) != NULL && sscanf(line, "smamodbus-state %u", &version) == 1 && version == STATE_VERSION);
+    while (valid && fgets(line, sizeof(line), file) != NULL) {
+        unsigned long a = 0, b = 0, c = 0, d = 0, e = 0;
+        if (sscanf(line, "unit %lu", &a) == 1) {
+            unit_id = (unsigned)a;
+        }
+        else if (sscanf(line, "device %lu %lu %lu", &a, &b, &c) == 3) {
+            state_map.push_back(SmaModbusDeviceEntry((uint16_t)a, (uint32_t)b, (uint16_t)c));
+        }
+        else if (sscanf(line, "nameplate %lu %lu %lu %lu %lu", &a, &b, &c, &d, &e) == 5) {
+            state_nameplate.susyID = (uint32_t)a;
+            state_nameplate.serialNumber = (uint32_t)b;
+            state_nameplate.mainModel = (uint32_t)c;
+            state_nameplate.model = (uint32_t)d;
+            state_nameplate.packageRevision = (uint32_t)e;
+        }
+        else if (sscanf(line, "register %lu %lu", &a, &b) == 2) {
+            state_registers.push_back((uint16_t)a);
+            state_units.push_back((unsigned)b);
+        }
+        else if (sscanf(line, "block %lu %lu %lu %lu %lu", &a, &b, &c, &d, &e) == 5) {
+            state_blocks.push_back(ReadBlock((SmaModbusUnitID)a, (uint16_t)b, (uint16_t)c, (size_t)d, (size_t)e));
+        }
+        else if (strncmp(line, "limits", 6) == 0) {
+            valid = state_limits.read(file);
+            break;
+        }
+        else {
+            valid = false;
+        }
+    }
+    fclose(file);
+    if (!valid || unit_id <= SmaModbusUnitID::BROADCAST || unit_id > SmaModbusUnitID::MAX) {
+        return false;
+    }
+
+    // the blocks of the read plan are restored, if it consists of the same registers; they must then cover each register
+    // of the plan exactly once, in the order of ReadPlan::order, otherwise the state file is stale or corrupt
+    bool same_registers = (plan != NULL && plan->registers.size() == state_registers.size());
+    for (size_t i = 0; same_registers && i < state_registers.size(); ++i) {
+        same_registers &= (plan->registers[i].addr == state_registers[i]);
+        same_registers &= (plan->unitIDs[i] == state_units[i]);
+    }
+    if (same_registers) {
+        size_t next = 0;
+        for (const auto& block : state_blocks) {
+            if (block.first != next || block.count == 0 || block.count > plan->order.size() - next ||
+                block.size == 0 || block.size > SmaModbusFrame::MAX_READ_WORDS) {
+                return false;
+            }
+            for (size_t i = block.first; i < block.first + block.count; ++i) {
+                const size_t index = plan->order[i];
+                const RegisterDefinition& reg = plan->registers[index];
+                if (plan->unitIDs[index] != block.unitID || reg.addr < block.addr ||
+                    (uint32_t)reg.addr + reg.size > (uint32_t)block.addr + block.size) {
+                    return false;
+                }
+            }
+            next += block.count;
+        }
+        if (next != plan->order.size()) {
+            return false;
+        }
+    }
+
+    // validate the state by a single read of the serial number
+    SmaModbusException exception;
+    SmaModbusUnitID previous_id = getUnitID();
+    setUnitID((uint8_t)unit_id);
+    uint64_t serial_number = readUint(Register30005().addr, Register30005().size * 2u, exception, false, false);
+    if (exception.hasError() || serial_number != state_nameplate.serialNumber) {
+        setUnitID(previous_id);
+        return false;
+    }
+    device_map = state_map;
+    nameplate = state_nameplate;
+    limits = state_limits;
+
+    if (same_registers) {
+        plan->blocks = state_blocks;
+        if (plan_restored != NULL) {
+            *plan_restored = true;
+        }
+    }
+    return true;
+}
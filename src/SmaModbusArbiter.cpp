@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <SmaModbusArbiter.hpp>
+#include <SmaModbusTrace.hpp>
+
+using namespace libsmamodbus;
+
+
+thread_local SmaModbusArbiter::Priority SmaModbusArbiter::thread_priority = SmaModbusArbiter::Priority::Normal;
+
+
+SmaModbusArbiter::SmaModbusArbiter(void) :
+    next_ticket(0),
+    granted_ticket(0),
+    busy(false),
+    holder(Priority::Normal),
+    max_bypass(8),
+    max_wait_age(500)
+{
+    std::fill(bypassed, bypassed + NUM_PRIORITIES, 0);
+}
+
+
+void SmaModbusArbiter::acquire(Priority priority) {
+    SMAMODBUS_TRACE_SPAN("acquire");
+    std::unique_lock<std::mutex> lock(mutex);
+    const size_t index = (size_t)priority;
+    Ticket ticket;
+    ticket.number = ++next_ticket;
+    ticket.time = Clock::now();
+
+    // fast path without any contention
+    bool pending = false;
+    for (size_t i = 0; i < NUM_PRIORITIES; ++i) {
+        pending |= !queues[i].empty();
+    }
+    if (!busy && !pending) {
+        busy = true;
+        granted_ticket = ticket.number;
+    }
+    else {
+        queues[index].push_back(ticket);
+        granted.wait(lock, [this, &ticket] { return granted_ticket == ticket.number; });
+    }
+
+    // the grant bookkeeping is done by the thread receiving the grant
+    grant_time = Clock::now();
+    holder = priority;
+    uint64_t wait_time = toMicroseconds(grant_time - ticket.time);
+    Statistics& stats = statistics[index];
+    stats.grants++;
+    stats.totalWaitTime += wait_time;
+    stats.maxWaitTime = std::max(stats.maxWaitTime, wait_time);
+}
+
+
+void SmaModbusArbiter::release(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const Clock::time_point now = Clock::now();
+    uint64_t hold_time = toMicroseconds(now - grant_time);
+    Statistics& stats = statistics[(size_t)holder];
+    stats.totalHoldTime += hold_time;
+    stats.maxHoldTime = std::max(stats.maxHoldTime, hold_time);
+    busy = false;
+    grantNext(now);
+}
+
+
+void SmaModbusArbiter::grantNext(Clock::time_point now) {
+    size_t next = NUM_PRIORITIES;
+    for (size_t i = 0; i < NUM_PRIORITIES && next == NUM_PRIORITIES; ++i) {
+        if (!queues[i].empty()) {
+            next = i;
+        }
+    }
+    if (next == NUM_PRIORITIES) {
+        return;
+    }
+
+    // starvation protection: promote the oldest request of a lower class that was bypassed too often or waited too long
+    for (size_t i = next + 1; i < NUM_PRIORITIES; ++i) {
+        if (!queues[i].empty() && (bypassed[i] >= max_bypass || now - queues[i].front().time >= max_wait_age)) {
+            statistics[i].promotions++;
+            next = i;
+            break;
+        }
+    }
+    for (size_t i = 0; i < NUM_PRIORITIES; ++i) {
+        if (i == next) {
+            bypassed[i] = 0;
+        }
+        else if (!queues[i].empty() && i > next) {
+            bypassed[i]++;
+        }
+    }
+
+    busy = true;
+    granted_ticket = queues[next].front().number;
+    queues[next].pop_front();
+    granted.notify_all();
+}
+
+
+void SmaModbusArbiter::setStarvationLimits(size_t bypass_count, uint32_t wait_age_ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    max_bypass = bypass_count;
+    max_wait_age = std::chrono::milliseconds(wait_age_ms);
+}
+
+
+SmaModbusArbiter::Statistics SmaModbusArbiter::getStatistics(Priority priority) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics[(size_t)priority];
+}
+
+
+void SmaModbusArbiter::resetStatistics(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < NUM_PRIORITIES; ++i) {
+        statistics[i] = Statistics();
+    }
+}
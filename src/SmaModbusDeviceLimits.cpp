@@ -0,0 +1,118 @@
+#include <SmaModbusDeviceLimits.hpp>
+
+using namespace libsmamodbus;
+
+
+bool SmaModbusDeviceLimits::isReadable(uint8_t unit_id, uint16_t addr, uint16_t size) const {
+    const Span span(unit_id, addr, size);
+    for (const auto& entry : readable) {
+        if (entry.contains(span)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool SmaModbusDeviceLimits::isUnreadable(uint8_t unit_id, uint16_t addr, uint16_t size) const {
+    // any span covering a rejected span will be rejected as well
+    const Span span(unit_id, addr, size);
+    for (const auto& entry : unreadable) {
+        if (span.contains(entry)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void SmaModbusDeviceLimits::markReadable(uint8_t unit_id, uint16_t addr, uint16_t size) {
+    const Span span(unit_id, addr, size);
+    for (const auto& entry : readable) {
+        if (entry.contains(span)) {
+            return;
+        }
+    }
+    // keep the list minimal; spans covered by the new span are redundant
+    for (auto it = readable.begin(); it != readable.end(); ) {
+        it = (span.contains(*it) ? readable.erase(it) : it + 1);
+    }
+    // a readable span cannot cover a rejected span; drop stale information, e.g. after a firmware update
+    for (auto it = unreadable.begin(); it != unreadable.end(); ) {
+        it = (span.contains(*it) ? unreadable.erase(it) : it + 1);
+    }
+    readable.push_back(span);
+}
+
+
+void SmaModbusDeviceLimits::markUnreadable(uint8_t unit_id, uint16_t addr, uint16_t size) {
+    const Span span(unit_id, addr, size);
+    for (const auto& entry : unreadable) {
+        if (span.contains(entry)) {
+            return;
+        }
+    }
+    // keep the list minimal; spans covering the new span are redundant
+    for (auto it = unreadable.begin(); it != unreadable.end(); ) {
+        it = (it->contains(span) ? unreadable.erase(it) : it + 1);
+    }
+    for (auto it = readable.begin(); it != readable.end(); ) {
+        it = (it->contains(span) ? readable.erase(it) : it + 1);
+    }
+    unreadable.push_back(span);
+}
+
+
+bool SmaModbusDeviceLimits::write(FILE* file) const {
+    for (const auto& span : readable) {
+        fprintf(file, "R %u %u %u\n", (unsigned)span.unitID, (unsigned)span.addr, (unsigned)span.size);
+    }
+    for (const auto& span : unreadable) {
+        fprintf(file, "U %u %u %u\n", (unsigned)span.unitID, (unsigned)span.addr, (unsigned)span.size);
+    }
+    return ferror(file) == 0;
+}
+
+
+bool SmaModbusDeviceLimits::read(FILE* file) {
+    char line[64];
+    long position = ftell(file);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char kind = 0;
+        unsigned unit_id = 0, addr = 0, size = 0;
+        if (sscanf(line, "%c %u %u %u", &kind, &unit_id, &addr, &size) != 4 || (kind != 'R' && kind != 'U') ||
+            unit_id > 0xff || addr > 0xffff || size == 0 || size > 0xffff) {
+            fseek(file, position, SEEK_SET);    // leave the line to the caller
+            break;
+        }
+        if (kind == 'R') {
+            markReadable((uint8_t)unit_id, (uint16_t)addr, (uint16_t)size);
+        }
+        else {
+            markUnreadable((uint8_t)unit_id, (uint16_t)addr, (uint16_t)size);
+        }
+        position = ftell(file);
+    }
+    return ferror(file) == 0;
+}
+
+
+bool SmaModbusDeviceLimits::save(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+    bool result = write(file);
+    return (fclose(file) == 0) && result;
+}
+
+
+bool SmaModbusDeviceLimits::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    bool result = read(file);
+    fclose(file);
+    return result;
+}
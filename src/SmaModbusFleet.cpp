@@ -0,0 +1,176 @@
+#include <limits>
+#include <algorithm>
+#include <SmaModbusFleet.hpp>
+
+using namespace libsmamodbus;
+
+// NaN values are the only values not equal to themselves; the comparisons below compile to branch-free selects
+
+
+SmaModbusFleetSnapshot::SmaModbusFleetSnapshot(const std::vector<SmaModbus::RegisterDefinition>& regs, size_t devices) :
+    registers(regs),
+    num_devices(devices),
+    stride((devices + LANES - 1) / LANES * LANES),
+    current(regs.size() * stride, SmaModbusValue::Double_NaN),
+    previous(regs.size() * stride, SmaModbusValue::Double_NaN) {}
+
+
+size_t SmaModbusFleetSnapshot::findRegister(uint16_t addr) const {
+    for (size_t i = 0; i < registers.size(); ++i) {
+        if (registers[i].addr == addr) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+
+void SmaModbusFleetSnapshot::beginCycle(void) {
+    current.swap(previous);
+    std::fill(current.begin(), current.end(), SmaModbusValue::Double_NaN);
+}
+
+
+void SmaModbusFleetSnapshot::setDevice(size_t device, const std::vector<SmaModbusValue>& values) {
+    assert(device < num_devices);
+    size_t n = (values.size() < registers.size() ? values.size() : registers.size());
+    for (size_t reg = 0; reg < n; ++reg) {
+        current[reg * stride + device] = values[reg].toDouble();
+    }
+}
+
+
+double SmaModbusFleetSnapshot::sum(size_t reg) const {
+    const double* values = getValues(reg);
+    double acc[LANES] = {};
+    for (size_t i = 0; i < stride; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+            double v = values[i + l];
+            acc[l] += (v == v ? v : 0.0);
+        }
+    }
+    double result = 0.0;
+    for (size_t l = 0; l < LANES; ++l) {
+        result += acc[l];
+    }
+    return result;
+}
+
+
+double SmaModbusFleetSnapshot::min(size_t reg) const {
+    const double* values = getValues(reg);
+    double acc[LANES];
+    for (size_t l = 0; l < LANES; ++l) {
+        acc[l] = std::numeric_limits<double>::infinity();
+    }
+    for (size_t i = 0; i < stride; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+            double v = values[i + l];
+            acc[l] = (v < acc[l] ? v : acc[l]);
+        }
+    }
+    double result = acc[0];
+    for (size_t l = 1; l < LANES; ++l) {
+        result = (acc[l] < result ? acc[l] : result);
+    }
+    return (result != std::numeric_limits<double>::infinity() ? result : SmaModbusValue::Double_NaN);
+}
+
+
+double SmaModbusFleetSnapshot::max(size_t reg) const {
+    const double* values = getValues(reg);
+    double acc[LANES];
+    for (size_t l = 0; l < LANES; ++l) {
+        acc[l] = -std::numeric_limits<double>::infinity();
+    }
+    for (size_t i = 0; i < stride; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+            double v = values[i + l];
+            acc[l] = (v > acc[l] ? v : acc[l]);
+        }
+    }
+    double result = acc[0];
+    for (size_t l = 1; l < LANES; ++l) {
+        result = (acc[l] > result ? acc[l] : result);
+    }
+    return (result != -std::numeric_limits<double>::infinity() ? result : SmaModbusValue::Double_NaN);
+}
+
+
+size_t SmaModbusFleetSnapshot::count(size_t reg) const {
+    const double* values = getValues(reg);
+    size_t acc[LANES] = {};
+    for (size_t i = 0; i < stride; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+            double v = values[i + l];
+            acc[l] += (v == v ? 1u : 0u);
+        }
+    }
+    size_t result = 0;
+    for (size_t l = 0; l < LANES; ++l) {
+        result += acc[l];
+    }
+    return result;
+}
+
+
+SmaModbusFleetSnapshot::Reduction SmaModbusFleetSnapshot::reduce(size_t reg) const {
+    const double* values = getValues(reg);
+    double sum_acc[LANES] = {};
+    double min_acc[LANES];
+    double max_acc[LANES];
+    size_t count_acc[LANES] = {};
+    for (size_t l = 0; l < LANES; ++l) {
+        min_acc[l] = std::numeric_limits<double>::infinity();
+        max_acc[l] = -std::numeric_limits<double>::infinity();
+    }
+    for (size_t i = 0; i < stride; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+            double v = values[i + l];
+            bool valid = (v == v);
+            sum_acc[l] += (valid ? v : 0.0);
+            min_acc[l] = (v < min_acc[l] ? v : min_acc[l]);
+            max_acc[l] = (v > max_acc[l] ? v : max_acc[l]);
+            count_acc[l] += (valid ? 1u : 0u);
+        }
+    }
+    Reduction result = { 0.0, min_acc[0], max_acc[0], 0 };
+    for (size_t l = 0; l < LANES; ++l) {
+        result.sum += sum_acc[l];
+        result.min = (min_acc[l] < result.min ? min_acc[l] : result.min);
+        result.max = (max_acc[l] > result.max ? max_acc[l] : result.max);
+        result.count += count_acc[l];
+    }
+    if (result.count == 0) {
+        result.min = SmaModbusValue::Double_NaN;
+        result.max = SmaModbusValue::Double_NaN;
+    }
+    return result;
+}
+
+
+void SmaModbusFleetSnapshot::diff(size_t reg, double* diffs) const {
+    const double* values = getValues(reg);
+    const double* previous_values = getPreviousValues(reg);
+    for (size_t i = 0; i < num_devices; ++i) {
+        diffs[i] = values[i] - previous_values[i];     // NaN propagates, if either value is invalid
+    }
+}
+
+
+double SmaModbusFleetSnapshot::sumDiff(size_t reg) const {
+    const double* values = getValues(reg);
+    const double* previous_values = getPreviousValues(reg);
+    double acc[LANES] = {};
+    for (size_t i = 0; i < stride; i += LANES) {
+        for (size_t l = 0; l < LANES; ++l) {
+            double d = values[i + l] - previous_values[i + l];
+            acc[l] += (d == d ? d : 0.0);
+        }
+    }
+    double result = 0.0;
+    for (size_t l = 0; l < LANES; ++l) {
+        result += acc[l];
+    }
+    return result;
+}
@@ -0,0 +1,193 @@
+#include <SmaModbusFormat.hpp>
+#include <SmaModbusFrame.hpp>
+
+using namespace libsmamodbus;
+
+
+size_t SmaModbusFormatter::getString(const SmaModbus::RawRegisterView& view, char* str, size_t size) {
+    size_t len = 0;
+    for (size_t i = 0; i < view.getNumWords() && len + 2 <= size; ++i) {
+        str[len++] = (char)(view.getWords()[i] >> 8);
+        str[len++] = (char)(view.getWords()[i]);
+    }
+    return len;
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendUnsigned(uint64_t value) {
+    char digits[20];
+    size_t ndigits = 0;
+    do {
+        digits[sizeof(digits) - ++ndigits] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return append(digits + sizeof(digits) - ndigits, ndigits);
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendValue(const SmaModbusValue& value) {
+    size_t n = value.toChars(buffer + length, capacity - length);
+    if (n == 0 && !(value.type == DataType::STR32 && value.str.empty())) {
+        overflow = true;
+    }
+    length += n;
+    return *this;
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendValue(const SmaModbus::RawRegisterView& view) {
+    const SmaModbus::RegisterDefinition& reg = view.getRegister();
+    if (view.getWords() != NULL && reg.type == DataType::STR32) {
+        char str[2 * SmaModbusFrame::MAX_READ_WORDS];
+        size_t len = getString(view, str, sizeof(str));
+        return append(str, len);
+    }
+    // registers that could not be read are formatted as NaN by an invalid data type
+    size_t n = SmaModbusValue::toChars(buffer + length, capacity - length, view.u64(), (view.isNumeric() ? reg.type : DataType::INVALID), reg.format);
+    if (n == 0) {
+        overflow = true;
+    }
+    length += n;
+    return *this;
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendJsonString(const char* str, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const size_t start = length;
+    const bool previous_overflow = overflow;
+    overflow = false;
+
+    append('"');
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)str[i];
+        switch (c) {
+        case '"':  append("\\\"", 2); break;
+        case '\\': append("\\\\", 2); break;
+        case '\n': append("\\n", 2);  break;
+        case '\r': append("\\r", 2);  break;
+        case '\t': append("\\t", 2);  break;
+        default:
+            if (c < 0x20) {
+                char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                append(escaped, sizeof(escaped));
+            }
+            else {
+                append((char)c);
+            }
+        }
+    }
+    append('"');
+
+    // the string is appended either completely or not at all
+    if (overflow) {
+        length = start;
+    }
+    overflow |= previous_overflow;
+    return *this;
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendLineProtocolKey(const char* str, size_t len, bool escape_equals) {
+    for (size_t i = 0; i < len; ++i) {
+        if (str[i] == ',' || str[i] == ' ' || (escape_equals && str[i] == '=')) {
+            append('\\');
+        }
+        append(str[i]);
+    }
+    return *this;
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendLineProtocolString(const char* str, size_t len) {
+    append('"');
+    for (size_t i = 0; i < len; ++i) {
+        if (str[i] == '"' || str[i] == '\\') {
+            append('\\');
+        }
+        append(str[i]);
+    }
+    return append('"');
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendJson(const SmaModbus::ReadPlan& plan) {
+    const size_t start = length;
+    const bool previous_overflow = overflow;
+    overflow = false;
+
+    append('{');
+    for (size_t i = 0; i < plan.registers.size(); ++i) {
+        const SmaModbus::RawRegisterView view = plan.getView(i);
+        const SmaModbus::RegisterDefinition& reg = plan.registers[i];
+        if (i > 0) {
+            append(',');
+        }
+        appendJsonString(reg.identifier.data(), reg.identifier.size());
+        append(':');
+        if (view.getWords() != NULL && reg.type == DataType::STR32) {
+            char str[2 * SmaModbusFrame::MAX_READ_WORDS];
+            size_t len = getString(view, str, sizeof(str));
+            appendJsonString(str, trimmedLength(str, len));
+        }
+        else if (view.isValid()) {
+            appendValue(view);
+        }
+        else {
+            append("null", 4);
+        }
+    }
+    append('}');
+
+    // the object is appended either completely or not at all
+    if (overflow) {
+        length = start;
+    }
+    overflow |= previous_overflow;
+    return *this;
+}
+
+
+SmaModbusFormatter& SmaModbusFormatter::appendLineProtocol(const char* measurement, const char* tags, const SmaModbus::ReadPlan& plan, uint64_t timestamp) {
+    const size_t start = length;
+    const bool previous_overflow = overflow;
+    overflow = false;
+
+    appendLineProtocolKey(measurement, strlen(measurement), false);
+    if (tags != NULL && tags[0] != '\0') {
+        append(',');
+        append(tags);
+    }
+    size_t num_fields = 0;
+    for (size_t i = 0; i < plan.registers.size(); ++i) {
+        const SmaModbus::RawRegisterView view = plan.getView(i);
+        const SmaModbus::RegisterDefinition& reg = plan.registers[i];
+        const bool is_string = (view.getWords() != NULL && reg.type == DataType::STR32);
+        if (!is_string && !view.isValid()) {
+            continue;   // line protocol has no representation for NaN values
+        }
+        append(num_fields++ == 0 ? ' ' : ',');
+        appendLineProtocolKey(reg.identifier.data(), reg.identifier.size(), true);
+        append('=');
+        if (is_string) {
+            char str[2 * SmaModbusFrame::MAX_READ_WORDS];
+            size_t len = getString(view, str, sizeof(str));
+            appendLineProtocolString(str, trimmedLength(str, len));
+        }
+        else {
+            appendValue(view);
+        }
+    }
+    if (timestamp != 0) {
+        append(' ');
+        appendUnsigned(timestamp);
+    }
+    append('\n');
+
+    // the line is appended either completely or not at all; a line without fields is invalid
+    if (overflow || num_fields == 0) {
+        length = start;
+    }
+    overflow |= previous_overflow;
+    return *this;
+}
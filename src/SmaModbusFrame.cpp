@@ -0,0 +1,166 @@
+#include <SmaModbusFrame.hpp>
+
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+
+size_t SmaModbusFrame::encodeHeader(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, size_t pdu_size) {
+    setWord(buffer + 0, transaction_id);
+    setWord(buffer + 2, 0);                         // protocol id is always 0 for modbus
+    setWord(buffer + 4, (uint16_t)(pdu_size + 1));  // length field counts the unit id and the pdu
+    buffer[6] = unit_id;
+    buffer[7] = function_code;
+    return MBAP_HEADER_SIZE + 1;
+}
+
+
+size_t SmaModbusFrame::encodeReadRequest(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, size_t num_words) {
+    if (num_words == 0 || num_words > MAX_READ_WORDS) {
+        return 0;
+    }
+    size_t offset = encodeHeader(buffer, transaction_id, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters, 5);
+    setWord(buffer + offset, addr);
+    setWord(buffer + offset + 2, (uint16_t)num_words);
+    return offset + 4;
+}
+
+
+size_t SmaModbusFrame::encodeWriteRequest(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, const uint16_t* words, size_t num_words) {
+    if (num_words == 0 || num_words > MAX_WRITE_WORDS) {
+        return 0;
+    }
+    size_t offset = encodeHeader(buffer, transaction_id, unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters, 6 + 2 * num_words);
+    setWord(buffer + offset, addr);
+    setWord(buffer + offset + 2, (uint16_t)num_words);
+    buffer[offset + 4] = (uint8_t)(2 * num_words);
+    offset += 5;
+    for (size_t i = 0; i < num_words; ++i, offset += 2) {
+        setWord(buffer + offset, words[i]);
+    }
+    return offset;
+}
+
+
+size_t SmaModbusFrame::getFrameSize(const uint8_t* header) {
+    uint16_t protocol_id = getWord(header + 2);
+    uint16_t length = getWord(header + 4);
+    // the length field covers the unit id and the pdu; a pdu consists of at least a function code and one byte of data
+    if (protocol_id != 0 || length < 3 || length > MAX_FRAME_SIZE - MBAP_HEADER_SIZE + 1) {
+        return 0;
+    }
+    return MBAP_HEADER_SIZE - 1 + length;
+}
+
+
+SmaModbusErrorCode SmaModbusFrame::checkResponse(const uint8_t* frame, size_t frame_size, uint8_t function_code) {
+    if (frame_size < MBAP_HEADER_SIZE + 2 || getFrameSize(frame) != frame_size) {
+        return (SmaModbusErrorCode)MBErrorCode::ProtocolError;
+    }
+    uint8_t fc = getFunctionCode(frame);
+    if (fc == (function_code | 0x80)) {
+        // an exception response is always an error, even if it carries no valid exception code
+        uint8_t exception_code = frame[MBAP_HEADER_SIZE + 1];
+        if (frame_size != EXCEPTION_RESPONSE_SIZE || exception_code == 0) {
+            return (SmaModbusErrorCode)MBErrorCode::ProtocolError;
+        }
+        return (SmaModbusErrorCode)exception_code;                   // modbus exception code
+    }
+    if (fc != function_code) {
+        return (SmaModbusErrorCode)MBErrorCode::ProtocolError;
+    }
+    return SmaModbusErrorCode::NoError;
+}
+
+
+SmaModbusErrorCode SmaModbusFrame::decodeReadResponse(const uint8_t* frame, size_t frame_size, uint16_t* words, size_t num_words) {
+    SmaModbusErrorCode error = checkResponse(frame, frame_size, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
+    if (error != SmaModbusErrorCode::NoError) {
+        return error;
+    }
+    const uint8_t* pdu = frame + MBAP_HEADER_SIZE + 1;
+    size_t byte_count = pdu[0];
+    if (byte_count != 2 * num_words || frame_size != MBAP_HEADER_SIZE + 2 + byte_count) {
+        return SmaModbusErrorCode::InvalidNumberOfRegisters;
+    }
+    for (size_t i = 0; i < num_words; ++i) {
+        words[i] = getWord(pdu + 1 + 2 * i);
+    }
+    return SmaModbusErrorCode::NoError;
+}
+
+
+SmaModbusErrorCode SmaModbusFrame::decodeWriteResponse(const uint8_t* frame, size_t frame_size, uint16_t addr, size_t num_words) {
+    SmaModbusErrorCode error = checkResponse(frame, frame_size, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters);
+    if (error != SmaModbusErrorCode::NoError) {
+        return error;
+    }
+    const uint8_t* pdu = frame + MBAP_HEADER_SIZE + 1;
+    if (frame_size != WRITE_RESPONSE_SIZE || getWord(pdu) != addr) {
+        return (SmaModbusErrorCode)MBErrorCode::ProtocolError;
+    }
+    if (getWord(pdu + 2) != num_words) {
+        return SmaModbusErrorCode::InvalidNumberOfRegisters;
+    }
+    return SmaModbusErrorCode::NoError;
+}
+
+
+SmaModbusErrorCode SmaModbusFrame::decodeRequest(const uint8_t* frame, size_t frame_size, uint16_t& addr, uint16_t& num_words, uint16_t* words) {
+    // a frame passing getFrameSize() holds at least a function code and one byte of data
+    if (frame_size < MBAP_HEADER_SIZE + 2 || getFrameSize(frame) != frame_size) {
+        return (SmaModbusErrorCode)MBErrorCode::IllegalDataValue;
+    }
+    // unsupported function codes are rejected before looking at the data, whatever its size
+    const uint8_t function_code = getFunctionCode(frame);
+    if (function_code != MBFunctionCode::ReadAnalogOutputHoldingRegisters && function_code != MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters) {
+        return (SmaModbusErrorCode)MBErrorCode::IllegalFunction;
+    }
+    if (frame_size < MBAP_HEADER_SIZE + 5) {
+        return (SmaModbusErrorCode)MBErrorCode::IllegalDataValue;
+    }
+    const uint8_t* pdu = frame + MBAP_HEADER_SIZE + 1;
+    addr = getWord(pdu);
+    num_words = getWord(pdu + 2);
+    if (function_code == MBFunctionCode::ReadAnalogOutputHoldingRegisters) {
+        if (frame_size != READ_REQUEST_SIZE || num_words == 0 || num_words > MAX_READ_WORDS) {
+            return (SmaModbusErrorCode)MBErrorCode::IllegalDataValue;
+        }
+        return SmaModbusErrorCode::NoError;
+    }
+    if (num_words == 0 || num_words > MAX_WRITE_WORDS || frame_size < MBAP_HEADER_SIZE + 6 ||
+        pdu[4] != 2 * num_words || frame_size != MBAP_HEADER_SIZE + 6 + 2u * num_words) {
+        return (SmaModbusErrorCode)MBErrorCode::IllegalDataValue;
+    }
+    for (size_t i = 0; i < num_words; ++i) {
+        words[i] = getWord(pdu + 5 + 2 * i);
+    }
+    return SmaModbusErrorCode::NoError;
+}
+
+
+size_t SmaModbusFrame::encodeReadResponse(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, const uint16_t* words, size_t num_words) {
+    if (num_words == 0 || num_words > MAX_READ_WORDS) {
+        return 0;
+    }
+    size_t offset = encodeHeader(buffer, transaction_id, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters, 2 + 2 * num_words);
+    buffer[offset++] = (uint8_t)(2 * num_words);
+    for (size_t i = 0; i < num_words; ++i, offset += 2) {
+        setWord(buffer + offset, words[i]);
+    }
+    return offset;
+}
+
+
+size_t SmaModbusFrame::encodeWriteResponse(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, size_t num_words) {
+    size_t offset = encodeHeader(buffer, transaction_id, unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters, 5);
+    setWord(buffer + offset, addr);
+    setWord(buffer + offset + 2, (uint16_t)num_words);
+    return offset + 4;
+}
+
+
+size_t SmaModbusFrame::encodeExceptionResponse(uint8_t* buffer, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, uint8_t exception_code) {
+    size_t offset = encodeHeader(buffer, transaction_id, unit_id, (uint8_t)(function_code | 0x80), 2);
+    buffer[offset] = exception_code;
+    return offset + 1;
+}
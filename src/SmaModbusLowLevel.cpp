@@ -1,24 +1,117 @@
+#include <chrono>
 #include <SmaModbusLowLevel.hpp>
+#include <SmaModbusFrame.hpp>
+#include <SmaModbusTrace.hpp>
 
 using namespace MB;
 using namespace MB::TCP;
 using namespace MB::utils;
 using namespace libsmamodbus;
 
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t elapsedMicroseconds(Clock::time_point start) {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    }
+}
+
 
 bool SmaModbusLowLevel::ensureConnection(void) {
+    SMAMODBUS_TRACE_SPAN("ensureConnection");
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
     if (modbus.getSockfd() < 0) {
         modbus = MB::TCP::Connection::with(peer_ip, peer_port);
+        if (!SmaModbusSocket::applyOptions((SmaModbusSocket::SocketHandle)modbus.getSockfd(), socket_options, true)) {
+            printf("ensureConnection() => cannot apply all socket options\n");
+        }
+        statistics.recordConnect();
+    }
+#else
+    if (!modbus.isOpen()) {
+        modbus.setOptions(socket_options);
+        closeConnection();
+        modbus.connect(peer_ip, peer_port);
+        connected = true;
+        statistics.recordConnect();
     }
+#endif
     return true;
 }
 
 
+void SmaModbusLowLevel::setSocketOptions(const SmaModbusSocket::Options& options) {
+    SmaModbusArbiter::Grant grant(arbiter);
+    socket_options = options;
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+    if (modbus.getSockfd() >= 0 && !SmaModbusSocket::applyOptions((SmaModbusSocket::SocketHandle)modbus.getSockfd(), socket_options, true)) {
+        printf("setSocketOptions() => cannot apply all socket options\n");
+    }
+#else
+    modbus.setOptions(socket_options);
+#endif
+}
+
+
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+ModbusResponse SmaModbusLowLevel::sendAndAwait(const ModbusRequest& request) {
+    SMAMODBUS_TRACE_SPAN("network");
+    modbus.sendRequest(request);
+    return modbus.awaitResponse();
+}
+#else
+size_t SmaModbusLowLevel::transact(const uint8_t* request, size_t request_size, uint8_t* response) {
+    try {
+        ensureConnection();
+        SMAMODBUS_TRACE_SPAN("network");
+        modbus.send(request, request_size);
+        size_t response_size = receiveFrame(response);
+        if (SmaModbusFrame::getTransactionID(response) != SmaModbusFrame::getTransactionID(request)) {
+            throw ModbusException(MBErrorCode::InvalidMessageID, SmaModbusFrame::getUnitID(request), (MBFunctionCode)SmaModbusFrame::getFunctionCode(request));
+        }
+        return response_size;
+    }
+    catch (...) {
+        // the byte stream cannot be re-synchronized after a transport error; reconnect on the next request
+        closeConnection();
+        throw;
+    }
+}
+
+
+void SmaModbusLowLevel::closeConnection(void) {
+    modbus.close();
+    if (connected) {
+        connected = false;
+        statistics.recordDisconnect();
+    }
+}
+
+
+size_t SmaModbusLowLevel::receiveFrame(uint8_t* response) {
+    modbus.receive(response, SmaModbusFrame::MBAP_HEADER_SIZE);
+    size_t response_size = SmaModbusFrame::getFrameSize(response);
+    if (response_size == 0) {
+        throw ModbusException(MBErrorCode::ProtocolError, SmaModbusFrame::getUnitID(response));
+    }
+    modbus.receive(response + SmaModbusFrame::MBAP_HEADER_SIZE, response_size - SmaModbusFrame::MBAP_HEADER_SIZE);
+    return response_size;
+}
+#endif
+
+
 uint64_t SmaModbusLowLevel::readUint(uint16_t addr, size_t nbytes,  SmaModbusException& exception, bool allow_exception, bool print_exception) {
-    std::vector<uint16_t> words = readWords(unit_id, addr, nbytes / 2u, exception, allow_exception, false);
-    if (!exception.hasError() && (nbytes > sizeof(uint64_t) || words.size() * 2u != nbytes)) {
+    uint16_t words[sizeof(uint64_t) / 2u];
+    size_t num_words = 0;
+    if (nbytes > sizeof(uint64_t)) {
         exception = SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
     }
+    else {
+        num_words = readWords(unit_id, addr, words, nbytes / 2u, exception, allow_exception, false);
+        if (!exception.hasError() && num_words * 2u != nbytes) {
+            exception = SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
+        }
+    }
     if (exception.hasError()) {
         if (print_exception) {
             printf("readUint(%lu) => %s\n", (unsigned long)addr, exception.toString().c_str());
@@ -28,18 +121,25 @@ uint64_t SmaModbusLowLevel::readUint(uint16_t addr, size_t nbytes,  SmaModbusExc
         }
     }
     uint64_t result = 0;
-    for (const auto word : words) {
-        result = (result << 16) | word;
+    for (size_t i = 0; i < num_words; ++i) {
+        result = (result << 16) | words[i];
     }
     return result;
 }
 
 
 std::string SmaModbusLowLevel::readString(uint16_t addr, size_t nbytes, SmaModbusException& exception, bool allow_exception, bool print_exception) {
-    std::vector<uint16_t> words = readWords(unit_id, addr, nbytes / 2u, exception, allow_exception, false);
-    if (!exception.hasError() && words.size() * 2u != nbytes) {
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+    size_t num_words = 0;
+    if (nbytes > sizeof(words)) {
         exception = SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
     }
+    else {
+        num_words = readWords(unit_id, addr, words, nbytes / 2u, exception, allow_exception, false);
+        if (!exception.hasError() && num_words * 2u != nbytes) {
+            exception = SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
+        }
+    }
     if (exception.hasError()) {
         if (print_exception) {
             printf("readString(%lu, %lu) => %s\n", (unsigned long)addr, (unsigned long)nbytes, exception.toString().c_str());
@@ -49,51 +149,179 @@ std::string SmaModbusLowLevel::readString(uint16_t addr, size_t nbytes, SmaModbu
         }
     }
     std::string result;
-    for (const auto word : words) {
-        result.append(1, (unsigned char)(word >> 8));
-        result.append(1, (unsigned char)(word));
+    result.reserve(num_words * 2u);
+    for (size_t i = 0; i < num_words; ++i) {
+        result.append(1, (unsigned char)(words[i] >> 8));
+        result.append(1, (unsigned char)(words[i]));
     }
     return result;
 }
 
 
 std::vector<uint16_t> SmaModbusLowLevel::readWords(SmaModbusUnitID unit_id, uint16_t addr, size_t num_words, SmaModbusException& exception, bool allow_exception, bool print_exception) {
-    std::vector<uint16_t> result;
+    std::vector<uint16_t> result(num_words);
+    result.resize(readWords(unit_id, addr, result.data(), num_words, exception, allow_exception, print_exception));
+    return result;
+}
+
+
+size_t SmaModbusLowLevel::readWords(SmaModbusUnitID unit_id, uint16_t addr, uint16_t* words, size_t num_words, SmaModbusException& exception, bool allow_exception, bool print_exception) {
+    SMAMODBUS_TRACE_SPAN("readWords");
+    const Clock::time_point start_time = Clock::now();
     try {
+        SmaModbusArbiter::Grant grant(arbiter);
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
         ensureConnection();
         ModbusRequest request(unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters, addr, (uint16_t)num_words);
-        modbus.sendRequest(request);
-        ModbusResponse response = modbus.awaitResponse();
+        ModbusResponse response = sendAndAwait(request);
+        SMAMODBUS_TRACE_SPAN("decode");
         auto values = response.registerValues();
-        for (const auto &value : values) {
-            result.push_back(value.reg());
+        if (values.size() != num_words) {
+            throw SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
         }
-        if (result.size() != num_words) {
+        for (size_t i = 0; i < num_words; ++i) {
+            words[i] = values[i].reg();
+        }
+#else
+        uint8_t request[SmaModbusFrame::READ_REQUEST_SIZE];
+        uint8_t response[SmaModbusFrame::MAX_FRAME_SIZE];
+        size_t request_size = 0;
+        {
+            SMAMODBUS_TRACE_SPAN("encode");
+            request_size = SmaModbusFrame::encodeReadRequest(request, ++transaction_id, unit_id, addr, num_words);
+        }
+        if (request_size == 0) {
             throw SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
         }
+        size_t response_size = transact(request, request_size, response);
+        SMAMODBUS_TRACE_SPAN("decode");
+        SmaModbusErrorCode error = SmaModbusFrame::decodeReadResponse(response, response_size, words, num_words);
+        if (error != SmaModbusErrorCode::NoError) {
+            throw SmaModbusException(error, unit_id, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
+        }
+#endif
     }
     catch (ModbusException ex) {
         exception = SmaModbusException(ex);
+        statistics.recordRequest(elapsedMicroseconds(start_time), false, ex.getErrorCode() == MBErrorCode::Timeout, 0, 0);
         if (print_exception) {
             printf("readWords(%lu) => %s\n", (unsigned long)addr, ex.toString().c_str());
         }
         if (allow_exception) {
             throw ex;
         }
+        return 0;
     }
-    return result;
+    statistics.recordRequest(elapsedMicroseconds(start_time), true, false, num_words, 0);
+    return num_words;
 }
 
 
-bool SmaModbusLowLevel::writeUint(uint16_t addr, size_t nbytes, uint64_t value, SmaModbusException& exception, bool allow_exception, bool print_exception) {
-    std::vector<uint16_t> words;
-    for (size_t i = nbytes; i > 0; i -= 2) {
-        words.push_back((uint16_t)(value >> ((i - 2) * 8u)));
+size_t SmaModbusLowLevel::readBlocks(ReadRequest* requests, size_t num_requests, bool print_exception) {
+    size_t num_successful = 0;
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+    for (size_t i = 0; i < num_requests; ++i) {
+        ReadRequest& req = requests[i];
+        req.exception = SmaModbusException();
+        if (readWords(req.unitID, req.addr, req.words, req.size, req.exception, false, print_exception) == req.size) {
+            ++num_successful;
+        }
+    }
+#else
+    uint16_t outstanding_ids[MAX_PIPELINE_WINDOW];  // transaction ids of the requests sent so far without response
+    size_t   outstanding[MAX_PIPELINE_WINDOW];      // indices of these requests
+    size_t   num_outstanding = 0;
+    size_t   next = 0;
+
+    for (size_t i = 0; i < num_requests; ++i) {
+        requests[i].exception = SmaModbusException();
+    }
+    uint8_t frame[SmaModbusFrame::MAX_FRAME_SIZE];
+    while (next < num_requests) {
+        // hold the connection for one window of requests; like readWords(), the latency of each request of the window
+        // includes the wait for the connection
+        SMAMODBUS_TRACE_SPAN("readBlocks.window");
+        const Clock::time_point start_time = Clock::now();
+        SmaModbusArbiter::Grant grant(arbiter);
+        try {
+            ensureConnection();
+            SMAMODBUS_TRACE_SPAN("network");
+            while (next < num_requests && num_outstanding < pipeline_window) {
+                ReadRequest& req = requests[next];
+                size_t request_size = SmaModbusFrame::encodeReadRequest(frame, ++transaction_id, req.unitID, req.addr, req.size);
+                if (request_size == 0) {
+                    req.exception = SmaModbusException(InvalidNumberOfRegisters, req.unitID, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
+                    statistics.recordRequest(elapsedMicroseconds(start_time), false, false, 0, 0);
+                }
+                else {
+                    modbus.send(frame, request_size);
+                    outstanding_ids[num_outstanding] = transaction_id;
+                    outstanding[num_outstanding++] = next;
+                }
+                ++next;
+            }
+
+            // receive the responses of the window and match them to their requests
+            while (num_outstanding > 0) {
+                size_t response_size = receiveFrame(frame);
+                size_t slot = 0;
+                while (slot < num_outstanding && outstanding_ids[slot] != SmaModbusFrame::getTransactionID(frame)) {
+                    ++slot;
+                }
+                if (slot == num_outstanding) {
+                    throw ModbusException(MBErrorCode::InvalidMessageID, SmaModbusFrame::getUnitID(frame));
+                }
+                ReadRequest& req = requests[outstanding[slot]];
+                SmaModbusErrorCode error = SmaModbusFrame::decodeReadResponse(frame, response_size, req.words, req.size);
+                if (error != SmaModbusErrorCode::NoError) {
+                    req.exception = SmaModbusException(error, req.unitID, MBFunctionCode::ReadAnalogOutputHoldingRegisters);
+                }
+                statistics.recordRequest(elapsedMicroseconds(start_time), error == SmaModbusErrorCode::NoError, false, req.size, 0);
+                --num_outstanding;
+                outstanding_ids[slot] = outstanding_ids[num_outstanding];
+                outstanding[slot] = outstanding[num_outstanding];
+            }
+        }
+        catch (ModbusException ex) {
+            // the byte stream cannot be re-synchronized after a transport error; fail all requests without response,
+            // including the requests not sent yet
+            closeConnection();
+            const uint64_t latency_us = elapsedMicroseconds(start_time);
+            for (size_t i = 0; i < num_outstanding; ++i) {
+                requests[outstanding[i]].exception = SmaModbusException(ex);
+                statistics.recordRequest(latency_us, false, ex.getErrorCode() == MBErrorCode::Timeout, 0, 0);
+            }
+            for (size_t i = next; i < num_requests; ++i) {
+                requests[i].exception = SmaModbusException(ex);
+                statistics.recordRequest(latency_us, false, false, 0, 0);
+            }
+            break;
+        }
+    }
+    for (size_t i = 0; i < num_requests; ++i) {
+        const ReadRequest& req = requests[i];
+        if (!req.exception.hasError()) {
+            ++num_successful;
+        }
+        else if (print_exception) {
+            printf("readBlocks(%lu, %lu) => %s\n", (unsigned long)req.addr, (unsigned long)req.size, req.exception.toString().c_str());
+        }
     }
-    if (words.size() * 2u != nbytes) {
+#endif
+    return num_successful;
+}
+
+
+bool SmaModbusLowLevel::writeUint(uint16_t addr, size_t nbytes, uint64_t value, SmaModbusException& exception, bool allow_exception, bool print_exception) {
+    uint16_t words[sizeof(uint64_t) / 2u];
+    if (nbytes > sizeof(uint64_t) || (nbytes & 1u) != 0) {
         throw SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters);
     }
-    bool result = writeWords(unit_id, addr, words, exception, allow_exception, false);
+    size_t num_words = 0;
+    for (size_t i = nbytes; i > 0; i -= 2) {
+        words[num_words++] = (uint16_t)(value >> ((i - 2) * 8u));
+    }
+    bool result = writeWords(unit_id, addr, words, num_words, exception, allow_exception, false);
     if (exception.hasError()) {
         if (print_exception) {
             printf("writeUint(%lu, %lu, %lu) => %s\n", (unsigned long)addr, (unsigned long)nbytes, (unsigned long)value, exception.toString().c_str());
@@ -107,18 +335,18 @@ bool SmaModbusLowLevel::writeUint(uint16_t addr, size_t nbytes, uint64_t value,
 
 
 bool SmaModbusLowLevel::writeString(uint16_t addr, size_t nbytes, const std::string& value, SmaModbusException& exception, bool allow_exception, bool print_exception) {
-    std::string str(value);
-    if (str.size() < nbytes) {
-        str.append(nbytes - str.size(), 0);
-    }
-    std::vector<uint16_t> words;
-    for (size_t i = 0; i < str.size(); i += 2) {
-        words.push_back((uint16_t)(str[i] << 8) | (uint16_t)str[i + 1]);
-    }
-    if (words.size() * 2u != nbytes) {
+    uint16_t words[SmaModbusFrame::MAX_WRITE_WORDS];
+    if (value.size() > nbytes || nbytes > sizeof(words) || (nbytes & 1u) != 0) {
         throw SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters);
     }
-    bool result = writeWords(unit_id, addr, words, exception, allow_exception, false);
+    // the written string is extended to nbytes by '\0' characters
+    size_t num_words = nbytes / 2u;
+    for (size_t i = 0; i < num_words; ++i) {
+        uint8_t high = (2 * i     < value.size() ? (uint8_t)value[2 * i]     : 0);
+        uint8_t low  = (2 * i + 1 < value.size() ? (uint8_t)value[2 * i + 1] : 0);
+        words[i] = (uint16_t)((high << 8) | low);
+    }
+    bool result = writeWords(unit_id, addr, words, num_words, exception, allow_exception, false);
     if (exception.hasError()) {
         if (print_exception) {
             printf("writeString(%lu, %lu, %s) => %s\n", (unsigned long)addr, (unsigned long)nbytes, value.c_str(), exception.toString().c_str());
@@ -131,19 +359,41 @@ bool SmaModbusLowLevel::writeString(uint16_t addr, size_t nbytes, const std::str
 }
 
 
-bool SmaModbusLowLevel::writeWords(SmaModbusUnitID unit_id, uint16_t addr, const std::vector<uint16_t> &value, SmaModbusException& exception, bool allow_exception, bool print_exception) {
+bool SmaModbusLowLevel::writeWords(SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* words, size_t num_words, SmaModbusException& exception, bool allow_exception, bool print_exception) {
+    SMAMODBUS_TRACE_SPAN("writeWords");
+    const Clock::time_point start_time = Clock::now();
     try {
+        SmaModbusArbiter::Grant grant(arbiter);
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
         ensureConnection();
         std::vector<ModbusCell> modbus_cells;
-        for (const auto& word : value) {
-            modbus_cells.push_back(ModbusCell(word));
+        for (size_t i = 0; i < num_words; ++i) {
+            modbus_cells.push_back(ModbusCell(words[i]));
         }
         ModbusRequest request(unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters, addr, (uint16_t)modbus_cells.size(), modbus_cells);
-        modbus.sendRequest(request);
-        ModbusResponse response = modbus.awaitResponse();
+        ModbusResponse response = sendAndAwait(request);
+#else
+        uint8_t request[SmaModbusFrame::MAX_FRAME_SIZE];
+        uint8_t response[SmaModbusFrame::MAX_FRAME_SIZE];
+        size_t request_size = 0;
+        {
+            SMAMODBUS_TRACE_SPAN("encode");
+            request_size = SmaModbusFrame::encodeWriteRequest(request, ++transaction_id, unit_id, addr, words, num_words);
+        }
+        if (request_size == 0) {
+            throw SmaModbusException(InvalidNumberOfRegisters, unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters);
+        }
+        size_t response_size = transact(request, request_size, response);
+        SMAMODBUS_TRACE_SPAN("decode");
+        SmaModbusErrorCode error = SmaModbusFrame::decodeWriteResponse(response, response_size, addr, num_words);
+        if (error != SmaModbusErrorCode::NoError) {
+            throw SmaModbusException(error, unit_id, MBFunctionCode::WriteMultipleAnalogOutputHoldingRegisters);
+        }
+#endif
     }
     catch (ModbusException ex) {
         exception = SmaModbusException(ex);
+        statistics.recordRequest(elapsedMicroseconds(start_time), false, ex.getErrorCode() == MBErrorCode::Timeout, 0, 0);
         if (print_exception) {
             printf("writeWords(%lu, ...) => %s\n", (unsigned long)addr, ex.toString().c_str());
         }
@@ -152,5 +402,6 @@ bool SmaModbusLowLevel::writeWords(SmaModbusUnitID unit_id, uint16_t addr, const
         }
         return false;
     }
+    statistics.recordRequest(elapsedMicroseconds(start_time), true, false, 0, num_words);
     return true;
 }
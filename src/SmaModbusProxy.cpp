@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cstring>
+#include <SmaModbusProxy.hpp>
+
+using namespace MB;
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+
+SmaModbusProxy::SmaModbusProxy(SmaModbusLowLevel& upstream_connection, uint16_t port, const std::string& addr, size_t pipeline_window) :
+    upstream(upstream_connection),
+    listen_addr(addr),
+    listen_port(port),
+    cache_ttl(1000),
+    max_clients(32),
+    running(false)
+{
+    upstream.setPipelineWindow(pipeline_window);
+}
+
+
+bool SmaModbusProxy::open(void) {
+    try {
+        server.listen(listen_addr, listen_port);
+    }
+    catch (ModbusException ex) {
+        printf("SmaModbusProxy::open(%s, %lu) => %s\n", listen_addr.c_str(), (unsigned long)listen_port, ex.toString().c_str());
+        return false;
+    }
+    return true;
+}
+
+
+void SmaModbusProxy::close(void) {
+    server.close();
+    clients.clear();
+    pending.clear();
+}
+
+
+void SmaModbusProxy::run(void) {
+    running = true;
+    while (running && server.isOpen()) {
+        poll(100);
+    }
+}
+
+
+void SmaModbusProxy::poll(int timeout_ms) {
+    if (!server.isOpen()) {
+        return;
+    }
+    std::vector<SmaModbusSocket*> sockets;
+    sockets.reserve(clients.size() + 1);
+    sockets.push_back(&server);
+    for (auto& client : clients) {
+        sockets.push_back(&client->socket);
+    }
+    std::vector<size_t> readable(sockets.size());
+    size_t num_readable = SmaModbusSocket::waitReadable(sockets.data(), sockets.size(), timeout_ms, readable.data());
+
+    // receive requests of all clients first, so that their reads can be coalesced
+    for (size_t i = 0; i < num_readable; ++i) {
+        if (readable[i] == 0) {
+            acceptClient();
+        }
+        else {
+            receiveRequests(*clients[readable[i] - 1]);
+        }
+    }
+    processReads();
+
+    // remove clients that closed their connection or failed
+    clients.erase(std::remove_if(clients.begin(), clients.end(), [](const std::unique_ptr<Client>& client) { return !client->socket.isOpen(); }), clients.end());
+}
+
+
+void SmaModbusProxy::acceptClient(void) {
+    std::unique_ptr<Client> client(new Client());
+    if (server.accept(client->socket)) {
+        if (clients.size() >= max_clients) {
+            client->socket.close();
+            return;
+        }
+        // a stalled client must not block the proxy for long
+        client->socket.setTimeout(1000);
+        clients.push_back(std::move(client));
+    }
+}
+
+
+void SmaModbusProxy::receiveRequests(Client& client) {
+    try {
+        client.size += client.socket.receiveAvailable(client.buffer + client.size, sizeof(client.buffer) - client.size);
+    }
+    catch (ModbusException ex) {
+        return;     // the socket has been closed by the peer
+    }
+    size_t offset = 0;
+    while (client.socket.isOpen() && client.size - offset >= SmaModbusFrame::MBAP_HEADER_SIZE) {
+        size_t frame_size = SmaModbusFrame::getFrameSize(client.buffer + offset);
+        if (frame_size == 0) {
+            client.socket.close();  // the byte stream cannot be re-synchronized
+            return;
+        }
+        if (client.size - offset < frame_size) {
+            break;
+        }
+        handleRequest(client, client.buffer + offset, frame_size);
+        offset += frame_size;
+    }
+    // keep an incomplete frame for the next receive; the buffer holds at least one more maximum sized frame
+    memmove(client.buffer, client.buffer + offset, client.size - offset);
+    client.size -= offset;
+}
+
+
+void SmaModbusProxy::handleRequest(Client& client, const uint8_t* frame, size_t frame_size) {
+    const uint16_t transaction_id = SmaModbusFrame::getTransactionID(frame);
+    const uint8_t unit_id = SmaModbusFrame::getUnitID(frame);
+    const uint8_t function_code = SmaModbusFrame::getFunctionCode(frame);
+    uint16_t words[SmaModbusFrame::MAX_WRITE_WORDS];
+    uint16_t addr = 0;
+    uint16_t num_words = 0;
+    ++statistics.requests;
+
+    SmaModbusErrorCode error = SmaModbusFrame::decodeRequest(frame, frame_size, addr, num_words, words);
+    if (error != SmaModbusErrorCode::NoError) {
+        sendException(client, transaction_id, unit_id, function_code, error);
+        return;
+    }
+    if (function_code == MBFunctionCode::ReadAnalogOutputHoldingRegisters) {
+        pending.push_back(PendingRead(&client, transaction_id, unit_id, addr, num_words));
+        return;
+    }
+
+    // reads of the same client received before the write must see the old values; answer them first
+    if (std::any_of(pending.begin(), pending.end(), [&client](const PendingRead& read) { return read.client == &client; })) {
+        processReads();
+    }
+
+    // forward writes immediately and drop the cached words they overwrite
+    SmaModbusException exception;
+    ++statistics.upstreamWrites;
+    if (!upstream.writeWords((SmaModbusUnitID)unit_id, addr, words, num_words, exception, false, false)) {
+        sendException(client, transaction_id, unit_id, function_code, exception.getErrorCode());
+        return;
+    }
+    for (uint32_t a = addr; a < (uint32_t)addr + num_words; ++a) {
+        cache.erase(((uint32_t)unit_id << 16) | a);
+    }
+    uint8_t response[SmaModbusFrame::WRITE_RESPONSE_SIZE];
+    sendResponse(client, response, SmaModbusFrame::encodeWriteResponse(response, transaction_id, unit_id, addr, num_words));
+}
+
+
+void SmaModbusProxy::processReads(void) {
+    if (pending.empty()) {
+        return;
+    }
+    const Clock::time_point now = Clock::now();
+    uint8_t response[SmaModbusFrame::MAX_FRAME_SIZE];
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+
+    // drop expired cache entries, then answer all reads that are completely covered by the cache
+    for (auto it = cache.begin(); it != cache.end(); ) {
+        it = (now - it->second.time >= cache_ttl ? cache.erase(it) : std::next(it));
+    }
+    size_t num_misses = 0;
+    for (const PendingRead& read : pending) {
+        if (lookupCache(read, now, words)) {
+            ++statistics.cacheHits;
+            sendResponse(*read.client, response, SmaModbusFrame::encodeReadResponse(response, read.transactionID, read.unitID, words, read.size));
+        }
+        else {
+            pending[num_misses++] = read;
+        }
+    }
+    pending.erase(pending.begin() + num_misses, pending.end());
+
+    // coalesce identical, overlapping and adjacent ranges of the same unit id into blocks of up to 125 words
+    std::sort(pending.begin(), pending.end(), [](const PendingRead& a, const PendingRead& b) {
+        return (a.unitID != b.unitID ? a.unitID < b.unitID : a.addr != b.addr ? a.addr < b.addr : a.size < b.size);
+    });
+    blocks.clear();
+    for (size_t i = 0; i < pending.size(); ++i) {
+        PendingRead& read = pending[i];
+        if (!blocks.empty()) {
+            Block& block = blocks.back();
+            const uint32_t end = std::max((uint32_t)block.addr + block.size, (uint32_t)read.addr + read.size);
+            if (block.unitID == read.unitID && read.addr <= (uint32_t)block.addr + block.size && end - block.addr <= SmaModbusFrame::MAX_READ_WORDS) {
+                if (read.addr != pending[i - 1].addr || read.size != pending[i - 1].size) {
+                    ++block.numRanges;
+                }
+                block.size = (uint16_t)(end - block.addr);
+                read.block = blocks.size() - 1;
+                continue;
+            }
+        }
+        blocks.push_back(Block(read.unitID, read.addr, read.size));
+        read.block = blocks.size() - 1;
+    }
+    statistics.coalesced += pending.size() - blocks.size();
+    readBlocks(0);
+
+    // a coalesced block may span addresses the device does not accept; read its ranges separately then
+    const size_t num_blocks = blocks.size();
+    for (PendingRead& read : pending) {
+        const Block& block = blocks[read.block];
+        if (block.numRanges > 1 && block.exception.getErrorCode() == (SmaModbusErrorCode)MBErrorCode::IllegalDataAddress) {
+            if (blocks.size() == num_blocks || blocks.back().unitID != read.unitID || blocks.back().addr != read.addr || blocks.back().size != read.size) {
+                blocks.push_back(Block(read.unitID, read.addr, read.size));
+            }
+            read.block = blocks.size() - 1;
+        }
+    }
+    if (blocks.size() > num_blocks) {
+        readBlocks(num_blocks);
+    }
+
+    for (const PendingRead& read : pending) {
+        const Block& block = blocks[read.block];
+        if (block.exception.hasError()) {
+            sendException(*read.client, read.transactionID, read.unitID, MBFunctionCode::ReadAnalogOutputHoldingRegisters, block.exception.getErrorCode());
+        }
+        else {
+            const uint16_t* block_words = block.words + (read.addr - block.addr);
+            sendResponse(*read.client, response, SmaModbusFrame::encodeReadResponse(response, read.transactionID, read.unitID, block_words, read.size));
+        }
+    }
+    pending.clear();
+}
+
+
+void SmaModbusProxy::readBlocks(size_t first) {
+    requests.clear();
+    for (size_t i = first; i < blocks.size(); ++i) {
+        requests.push_back(SmaModbusLowLevel::ReadRequest((SmaModbusUnitID)blocks[i].unitID, blocks[i].addr, blocks[i].size, blocks[i].words));
+    }
+    statistics.upstreamReads += requests.size();
+    upstream.readBlocks(requests.data(), requests.size(), false);
+
+    const Clock::time_point now = Clock::now();
+    for (size_t i = first; i < blocks.size(); ++i) {
+        Block& block = blocks[i];
+        block.exception = requests[i - first].exception;
+        if (!block.exception.hasError() && cache_ttl.count() > 0) {
+            for (size_t j = 0; j < block.size; ++j) {
+                CacheEntry& entry = cache[((uint32_t)block.unitID << 16) | (uint32_t)(block.addr + j)];
+                entry.word = block.words[j];
+                entry.time = now;
+            }
+        }
+    }
+}
+
+
+bool SmaModbusProxy::lookupCache(const PendingRead& read, Clock::time_point now, uint16_t* words) const {
+    if (cache_ttl.count() == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < read.size; ++i) {
+        auto it = cache.find(((uint32_t)read.unitID << 16) | (uint32_t)(read.addr + i));
+        if (it == cache.end() || now - it->second.time >= cache_ttl) {
+            return false;
+        }
+        words[i] = it->second.word;
+    }
+    return true;
+}
+
+
+void SmaModbusProxy::sendResponse(Client& client, const uint8_t* frame, size_t frame_size) {
+    if (!client.socket.isOpen()) {
+        return;
+    }
+    try {
+        client.socket.send(frame, frame_size);
+    }
+    catch (ModbusException ex) {
+        client.socket.close();
+    }
+}
+
+
+void SmaModbusProxy::sendException(Client& client, uint16_t transaction_id, uint8_t unit_id, uint8_t function_code, SmaModbusErrorCode error) {
+    // standard modbus exception codes are forwarded, transport and library errors are reported as gateway errors
+    uint8_t exception_code = ((uint8_t)error >= MBErrorCode::IllegalFunction && (uint8_t)error <= SmaModbusFrame::GATEWAY_TARGET_FAILED ? (uint8_t)error : SmaModbusFrame::GATEWAY_TARGET_FAILED);
+    uint8_t response[SmaModbusFrame::EXCEPTION_RESPONSE_SIZE];
+    ++statistics.exceptions;
+    sendResponse(client, response, SmaModbusFrame::encodeExceptionResponse(response, transaction_id, unit_id, (uint8_t)(function_code & 0x7f), exception_code));
+}
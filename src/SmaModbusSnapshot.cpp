@@ -0,0 +1,285 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <SmaModbusSnapshot.hpp>
+
+using namespace libsmamodbus;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory sequence counters must be lock-free");
+
+
+SmaModbusSnapshot::SmaModbusSnapshot(void) :
+    region(NULL),
+    region_size(0),
+    owner(false),
+    entries(NULL)
+#ifdef _WIN32
+    , mapping(NULL)
+#endif
+{}
+
+
+bool SmaModbusSnapshot::create(const std::string& region_name, const SmaModbus::ReadPlan& plan) {
+    close();
+    name = region_name;
+
+    // layout: header, register table, two data buffers each holding a buffer header, register timestamps and words
+    const size_t num_registers = plan.registers.size();
+    const size_t num_words = plan.words.size();
+    const size_t table_size = (sizeof(Header) + num_registers * sizeof(Entry) + 7u) & ~(size_t)7u;
+    const size_t buffer_size = (sizeof(BufferHeader) + num_registers * sizeof(uint64_t) + num_words * sizeof(uint16_t) + 7u) & ~(size_t)7u;
+    if (!map(table_size + 2 * buffer_size, true)) {
+        return false;
+    }
+    owner = true;
+
+    // the region is zero initialized, i.e. both buffers have sequence 0 and all register timestamps are 0
+    Header* header = getHeader();
+    header->numRegisters = (uint32_t)num_registers;
+    header->numWords = (uint32_t)num_words;
+    header->size = region_size;
+    header->bufferOffset[0] = table_size;
+    header->bufferOffset[1] = table_size + buffer_size;
+    Entry* table = (Entry*)(header + 1);
+    for (size_t i = 0; i < num_registers; ++i) {
+        const SmaModbus::RegisterDefinition& reg = plan.registers[i];
+        Entry& entry = table[i];
+        entry.addr = reg.addr;
+        entry.size = reg.size;
+        entry.unitID = (uint8_t)plan.unitIDs[i];
+        entry.type = (uint8_t)reg.type;
+        entry.format = (uint8_t)reg.format;
+        entry.mode = (uint8_t)reg.mode;
+        entry.category = (uint8_t)reg.category;
+        entry.offset = (uint32_t)plan.offsets[i];
+    }
+    entries = table;
+    definitions = plan.registers;
+
+    // readers check the magic number last
+    header->version = VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+    return true;
+}
+
+
+bool SmaModbusSnapshot::open(const std::string& region_name) {
+    close();
+    name = region_name;
+    if (!map(0, false)) {
+        return false;
+    }
+    if (!validate()) {
+        printf("SmaModbusSnapshot::open(%s) => incompatible layout\n", name.c_str());
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+bool SmaModbusSnapshot::validate(void) {
+    if (region_size < sizeof(Header)) {
+        return false;
+    }
+    const Header* header = getHeader();
+    if (header->magic != MAGIC || header->version != VERSION || header->size > region_size) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const size_t size = header->size;   // the mapping may be rounded up to the page size
+    const size_t num_registers = header->numRegisters;
+    const size_t num_words = header->numWords;
+    const size_t buffer_size = sizeof(BufferHeader) + num_registers * sizeof(uint64_t) + num_words * sizeof(uint16_t);
+    if (size < sizeof(Header) || num_registers > (size - sizeof(Header)) / sizeof(Entry) ||
+        header->bufferOffset[0] < sizeof(Header) + num_registers * sizeof(Entry)) {
+        return false;
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if (header->bufferOffset[i] % 8 != 0 || header->bufferOffset[i] > size || size - header->bufferOffset[i] < buffer_size) {
+            return false;
+        }
+    }
+
+    // rebuild the register definitions, such that register views can be used for decoding
+    entries = (const Entry*)(header + 1);
+    definitions.clear();
+    definitions.reserve(num_registers);
+    for (size_t i = 0; i < num_registers; ++i) {
+        const Entry& entry = entries[i];
+        if ((size_t)entry.offset + entry.size > num_words) {
+            return false;
+        }
+        definitions.push_back(SmaModbus::RegisterDefinition(entry.addr, entry.size, (DataType)entry.type, (DataFormat)entry.format,
+            (SmaModbus::AccessMode)entry.mode, (SmaModbus::Category)entry.category, std::string()));
+    }
+    return true;
+}
+
+
+#ifdef _WIN32
+
+bool SmaModbusSnapshot::map(size_t size, bool create) {
+    HANDLE handle;
+    if (create) {
+        handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, name.c_str());
+    }
+    else {
+        handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    }
+    if (handle == NULL) {
+        printf("SmaModbusSnapshot::map(%s) => error %lu\n", name.c_str(), (unsigned long)GetLastError());
+        return false;
+    }
+    void* view = MapViewOfFile(handle, (create ? FILE_MAP_WRITE : FILE_MAP_READ), 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (view == NULL || VirtualQuery(view, &info, sizeof(info)) == 0) {
+        printf("SmaModbusSnapshot::map(%s) => error %lu\n", name.c_str(), (unsigned long)GetLastError());
+        if (view != NULL) {
+            UnmapViewOfFile(view);
+        }
+        CloseHandle(handle);
+        return false;
+    }
+    mapping = handle;
+    region = (uint8_t*)view;
+    region_size = (create ? size : (size_t)info.RegionSize);
+    return true;
+}
+
+
+void SmaModbusSnapshot::close(void) {
+    if (region != NULL) {
+        UnmapViewOfFile(region);
+        CloseHandle((HANDLE)mapping);
+    }
+    region = NULL;
+    region_size = 0;
+    mapping = NULL;
+    owner = false;
+    entries = NULL;
+    definitions.clear();
+}
+
+#else
+
+bool SmaModbusSnapshot::map(size_t size, bool create) {
+    int fd;
+    if (create) {
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0 && ftruncate(fd, (off_t)size) != 0) {
+            ::close(fd);
+            shm_unlink(name.c_str());
+            fd = -1;
+        }
+    }
+    else {
+        struct stat info;
+        fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd >= 0 && fstat(fd, &info) == 0) {
+            size = (size_t)info.st_size;
+        }
+    }
+    if (fd < 0 || size == 0) {
+        printf("SmaModbusSnapshot::map(%s) => %s\n", name.c_str(), (fd < 0 ? strerror(errno) : "empty region"));
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    void* view = mmap(NULL, size, (create ? PROT_READ | PROT_WRITE : PROT_READ), MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        printf("SmaModbusSnapshot::map(%s) => %s\n", name.c_str(), strerror(errno));
+        if (create) {
+            shm_unlink(name.c_str());
+        }
+        return false;
+    }
+    region = (uint8_t*)view;
+    region_size = size;
+    return true;
+}
+
+
+void SmaModbusSnapshot::close(void) {
+    if (region != NULL) {
+        munmap(region, region_size);
+        if (owner) {
+            shm_unlink(name.c_str());
+        }
+    }
+    region = NULL;
+    region_size = 0;
+    owner = false;
+    entries = NULL;
+    definitions.clear();
+}
+
+#endif
+
+
+void SmaModbusSnapshot::publish(const SmaModbus::ReadPlan& plan) {
+    if (region == NULL || !owner || plan.registers.size() != definitions.size()) {
+        return;
+    }
+    Header* header = getHeader();
+    const uint64_t generation = header->generation.load(std::memory_order_relaxed) + 1;
+    BufferHeader* buffer = getBuffer(generation & 1);
+    const BufferHeader* previous = getBuffer((generation - 1) & 1);
+    const uint64_t timestamp = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    // seqlock write section; readers still holding a view of this buffer detect the overwrite by the odd sequence
+    const uint64_t sequence = buffer->sequence.load(std::memory_order_relaxed);
+    buffer->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t* timestamps = (uint64_t*)getTimestamps(buffer);
+    uint16_t* words = (uint16_t*)getWords(buffer);
+    const uint64_t* previous_timestamps = getTimestamps(previous);
+    const uint16_t* previous_words = getWords(previous);
+    for (size_t i = 0; i < definitions.size(); ++i) {
+        const Entry& entry = entries[i];
+        if (plan.valid[i]) {
+            std::copy(plan.words.begin() + entry.offset, plan.words.begin() + entry.offset + entry.size, words + entry.offset);
+            timestamps[i] = timestamp;
+        }
+        else {
+            // keep the words and timestamp of the last successful read
+            std::copy(previous_words + entry.offset, previous_words + entry.offset + entry.size, words + entry.offset);
+            timestamps[i] = previous_timestamps[i];
+        }
+    }
+    buffer->timestamp = timestamp;
+
+    buffer->sequence.store(sequence + 2, std::memory_order_release);
+    header->generation.store(generation, std::memory_order_release);
+}
+
+
+SmaModbusSnapshot::View SmaModbusSnapshot::getView(void) const {
+    // the published buffer is only odd, if the publisher has already started the publication after the next one;
+    // the generation read again then refers to the other, completed buffer. If the generation has changed, the
+    // publisher may have completed the publication after the next one, i.e. the buffer holds a newer generation
+    for (;;) {
+        const uint64_t generation = getHeader()->generation.load(std::memory_order_acquire);
+        const BufferHeader* buffer = getBuffer(generation & 1);
+        const uint64_t sequence = buffer->sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) == 0 && getHeader()->generation.load(std::memory_order_acquire) == generation) {
+            return View(this, buffer, sequence, generation);
+        }
+    }
+}
@@ -0,0 +1,314 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <errno.h>
+#endif
+#include <cstdio>
+#include <vector>
+#include <MB/modbusException.hpp>
+#include <SmaModbusSocket.hpp>
+
+using namespace MB;
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+#ifdef _WIN32
+#define poll WSAPoll
+#define CLOSE_SOCKET(fd) closesocket(fd)
+#define SEND_FLAGS 0
+#define CONNECT_IN_PROGRESS() (WSAGetLastError() == WSAEWOULDBLOCK)
+typedef int socklen_t;
+typedef ULONG nfds_t;
+
+namespace {
+    // winsock must be initialized once before any socket call
+    struct WinsockInitializer {
+        WinsockInitializer(void)  { WSADATA data; WSAStartup(MAKEWORD(2, 2), &data); }
+        ~WinsockInitializer(void) { WSACleanup(); }
+    } winsock_initializer;
+}
+#else
+#define CLOSE_SOCKET(fd) ::close(fd)
+#define SEND_FLAGS MSG_NOSIGNAL
+#define CONNECT_IN_PROGRESS() (errno == EINPROGRESS)
+#endif
+
+
+namespace {
+    // switch the socket between blocking and non-blocking mode
+    bool setNonBlocking(SmaModbusSocket::SocketHandle fd, bool non_blocking) {
+#ifdef _WIN32
+        u_long mode = (non_blocking ? 1 : 0);
+        return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, (non_blocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK)) == 0;
+#endif
+    }
+
+    // connect the given socket, waiting at most timeout_ms milliseconds; the socket is left in blocking mode
+    bool connectWithTimeout(SmaModbusSocket::SocketHandle fd, const struct sockaddr* addr, socklen_t addrlen, int timeout_ms) {
+        if (timeout_ms < 0) {
+            return ::connect(fd, addr, addrlen) == 0;
+        }
+        if (!setNonBlocking(fd, true)) {
+            return false;
+        }
+        bool connected = (::connect(fd, addr, addrlen) == 0);
+        if (!connected && CONNECT_IN_PROGRESS()) {
+            struct pollfd pfd = {};
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            if (poll(&pfd, 1, timeout_ms) == 1) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                connected = (getsockopt(fd, SOL_SOCKET, SO_ERROR, (char*)&error, &length) == 0 && error == 0);
+            }
+        }
+        return setNonBlocking(fd, false) && connected;
+    }
+
+    bool setIntOption(SmaModbusSocket::SocketHandle fd, int level, int name, int value) {
+        return setsockopt(fd, level, name, (const char*)&value, sizeof(value)) == 0;
+    }
+}
+
+
+void SmaModbusSocket::setOptions(const Options& socket_options) {
+    options = socket_options;
+    if (handle != INVALID_HANDLE && !applyOptions(handle, options)) {
+        printf("setOptions() => cannot apply all socket options\n");
+    }
+}
+
+
+bool SmaModbusSocket::applyOptions(SocketHandle fd, const Options& socket_options, bool set_io_timeouts) {
+    bool result = true;
+    result &= setIntOption(fd, IPPROTO_TCP, TCP_NODELAY, (socket_options.noDelay ? 1 : 0));
+    result &= setIntOption(fd, SOL_SOCKET, SO_KEEPALIVE, (socket_options.keepAlive ? 1 : 0));
+    if (socket_options.keepAlive) {
+#if defined(TCP_KEEPIDLE)
+        if (socket_options.keepAliveIdle > 0) {
+            result &= setIntOption(fd, IPPROTO_TCP, TCP_KEEPIDLE, socket_options.keepAliveIdle);
+        }
+#elif defined(TCP_KEEPALIVE)
+        if (socket_options.keepAliveIdle > 0) {
+            result &= setIntOption(fd, IPPROTO_TCP, TCP_KEEPALIVE, socket_options.keepAliveIdle);
+        }
+#endif
+#if defined(TCP_KEEPINTVL)
+        if (socket_options.keepAliveInterval > 0) {
+            result &= setIntOption(fd, IPPROTO_TCP, TCP_KEEPINTVL, socket_options.keepAliveInterval);
+        }
+#endif
+#if defined(TCP_KEEPCNT)
+        if (socket_options.keepAliveCount > 0) {
+            result &= setIntOption(fd, IPPROTO_TCP, TCP_KEEPCNT, socket_options.keepAliveCount);
+        }
+#endif
+    }
+    if (socket_options.sendBufferSize > 0) {
+        result &= setIntOption(fd, SOL_SOCKET, SO_SNDBUF, socket_options.sendBufferSize);
+    }
+    if (socket_options.receiveBufferSize > 0) {
+        result &= setIntOption(fd, SOL_SOCKET, SO_RCVBUF, socket_options.receiveBufferSize);
+    }
+    if (set_io_timeouts && socket_options.timeout >= 0) {
+#ifdef _WIN32
+        DWORD timeout = (DWORD)socket_options.timeout;
+#else
+        struct timeval timeout;
+        timeout.tv_sec = socket_options.timeout / 1000;
+        timeout.tv_usec = (socket_options.timeout % 1000) * 1000;
+#endif
+        result &= (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) == 0);
+        result &= (setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout)) == 0);
+    }
+    return result;
+}
+
+
+void SmaModbusSocket::connect(const std::string& peer, uint16_t port) {
+    close();
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    struct addrinfo* addresses = NULL;
+    if (getaddrinfo(peer.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+    for (struct addrinfo* ai = addresses; ai != NULL && handle == INVALID_HANDLE; ai = ai->ai_next) {
+        SocketHandle fd = (SocketHandle)socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == INVALID_HANDLE) {
+            continue;
+        }
+        // buffer sizes must be set before connecting, as they determine the tcp window scaling; options are best effort
+        if (!applyOptions(fd, options)) {
+            printf("connect(%s, %u) => cannot apply all socket options\n", peer.c_str(), (unsigned)port);
+        }
+        if (connectWithTimeout(fd, ai->ai_addr, (socklen_t)ai->ai_addrlen, options.connectTimeout)) {
+            handle = fd;
+        }
+        else {
+            CLOSE_SOCKET(fd);
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (handle == INVALID_HANDLE) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+}
+
+
+void SmaModbusSocket::listen(const std::string& addr, uint16_t port, int backlog) {
+    close();
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+    struct addrinfo* addresses = NULL;
+    if (getaddrinfo(addr.empty() ? NULL : addr.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+    for (struct addrinfo* ai = addresses; ai != NULL && handle == INVALID_HANDLE; ai = ai->ai_next) {
+        SocketHandle fd = (SocketHandle)socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd == INVALID_HANDLE) {
+            continue;
+        }
+        // allow an immediate restart while connections of a previous server instance are in TIME_WAIT state
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+        if (bind(fd, ai->ai_addr, (socklen_t)ai->ai_addrlen) == 0 && ::listen(fd, backlog) == 0) {
+            handle = fd;
+        }
+        else {
+            CLOSE_SOCKET(fd);
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (handle == INVALID_HANDLE) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+}
+
+
+bool SmaModbusSocket::accept(SmaModbusSocket& client) {
+    if (handle == INVALID_HANDLE) {
+        return false;
+    }
+    SocketHandle fd = (SocketHandle)::accept(handle, NULL, NULL);
+    if (fd == INVALID_HANDLE) {
+        return false;
+    }
+    client.close();
+    client.handle = fd;
+    if (!applyOptions(fd, client.options)) {
+        printf("accept() => cannot apply all socket options\n");
+    }
+    return true;
+}
+
+
+void SmaModbusSocket::close(void) {
+    if (handle != INVALID_HANDLE) {
+        CLOSE_SOCKET(handle);
+        handle = INVALID_HANDLE;
+    }
+}
+
+
+void SmaModbusSocket::wait(bool for_write) {
+    struct pollfd pfd = {};
+    pfd.fd = handle;
+    pfd.events = (for_write ? POLLOUT : POLLIN);
+    int rc = poll(&pfd, 1, options.timeout);
+    if (rc == 0) {
+        throw ModbusException(MBErrorCode::Timeout);
+    }
+    if (rc < 0) {
+        close();
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+}
+
+
+void SmaModbusSocket::send(const uint8_t* buffer, size_t size) {
+    if (handle == INVALID_HANDLE) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+    while (size > 0) {
+        wait(true);
+        auto nbytes = ::send(handle, (const char*)buffer, (int)size, SEND_FLAGS);
+        if (nbytes <= 0) {
+            close();
+            throw ModbusException(MBErrorCode::ConnectionClosed);
+        }
+        buffer += nbytes;
+        size -= (size_t)nbytes;
+    }
+}
+
+
+void SmaModbusSocket::receive(uint8_t* buffer, size_t size) {
+    if (handle == INVALID_HANDLE) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+    while (size > 0) {
+        wait(false);
+        auto nbytes = ::recv(handle, (char*)buffer, (int)size, 0);
+        if (nbytes <= 0) {
+            close();
+            throw ModbusException(MBErrorCode::ConnectionClosed);
+        }
+        buffer += nbytes;
+        size -= (size_t)nbytes;
+    }
+}
+
+
+size_t SmaModbusSocket::receiveAvailable(uint8_t* buffer, size_t size) {
+    if (handle == INVALID_HANDLE) {
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+    auto nbytes = ::recv(handle, (char*)buffer, (int)size, 0);
+    if (nbytes <= 0) {
+        close();
+        throw ModbusException(MBErrorCode::ConnectionClosed);
+    }
+    return (size_t)nbytes;
+}
+
+
+size_t SmaModbusSocket::waitReadable(SmaModbusSocket* const* sockets, size_t num_sockets, int timeout_ms, size_t* readable) {
+    std::vector<struct pollfd> pfds(num_sockets);
+    for (size_t i = 0; i < num_sockets; ++i) {
+        pfds[i].fd = sockets[i]->handle;
+        pfds[i].events = POLLIN;
+    }
+    if (poll(pfds.data(), (nfds_t)num_sockets, timeout_ms) <= 0) {
+        return 0;
+    }
+    size_t num_readable = 0;
+    for (size_t i = 0; i < num_sockets; ++i) {
+        // hang-ups and errors are reported as readable; the subsequent receive detects them
+        if ((pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+            readable[num_readable++] = i;
+        }
+    }
+    return num_readable;
+}
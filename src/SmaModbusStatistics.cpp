@@ -0,0 +1,128 @@
+#include <cstdio>
+#include <SmaModbusStatistics.hpp>
+
+using namespace libsmamodbus;
+
+
+SmaModbusStatistics::Snapshot::Snapshot(void) :
+    requests(0),
+    errors(0),
+    timeouts(0),
+    connects(0),
+    disconnects(0),
+    wordsRead(0),
+    wordsWritten(0)
+{
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        histogram[i] = 0;
+    }
+}
+
+
+uint64_t SmaModbusStatistics::Snapshot::getPercentile(double percentile) const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        total += histogram[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    // find the first non-empty bucket reaching the rank of the percentile
+    double rank = percentile / 100.0 * (double)total;
+    uint64_t count = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        count += histogram[i];
+        if (count > 0 && (double)count >= rank) {
+            return (uint64_t)1 << (i + 1);
+        }
+    }
+    return (uint64_t)1 << NUM_BUCKETS;
+}
+
+
+SmaModbusStatistics::Snapshot& SmaModbusStatistics::Snapshot::operator+=(const Snapshot& other) {
+    requests += other.requests;
+    errors += other.errors;
+    timeouts += other.timeouts;
+    connects += other.connects;
+    disconnects += other.disconnects;
+    wordsRead += other.wordsRead;
+    wordsWritten += other.wordsWritten;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        histogram[i] += other.histogram[i];
+    }
+    return *this;
+}
+
+
+SmaModbusStatistics::Snapshot& SmaModbusStatistics::Snapshot::operator-=(const Snapshot& other) {
+    requests -= other.requests;
+    errors -= other.errors;
+    timeouts -= other.timeouts;
+    connects -= other.connects;
+    disconnects -= other.disconnects;
+    wordsRead -= other.wordsRead;
+    wordsWritten -= other.wordsWritten;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        histogram[i] -= other.histogram[i];
+    }
+    return *this;
+}
+
+
+std::string SmaModbusStatistics::Snapshot::toString(void) const {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "requests %llu  errors %llu  timeouts %llu  connects %llu  disconnects %llu  p50 %lluus  p90 %lluus  p99 %lluus",
+        (unsigned long long)requests, (unsigned long long)errors, (unsigned long long)timeouts, (unsigned long long)connects,
+        (unsigned long long)disconnects, (unsigned long long)getPercentile(50), (unsigned long long)getPercentile(90),
+        (unsigned long long)getPercentile(99));
+    return std::string(buffer);
+}
+
+
+void SmaModbusStatistics::recordRequest(uint64_t latency_us, bool success, bool timeout, size_t num_words_read, size_t num_words_written) {
+    size_t bucket = 0;
+    while (bucket + 1 < NUM_BUCKETS && (latency_us >> (bucket + 1)) != 0) {
+        ++bucket;
+    }
+    histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    requests.fetch_add(1, std::memory_order_relaxed);
+    if (success) {
+        words_read.fetch_add(num_words_read, std::memory_order_relaxed);
+        words_written.fetch_add(num_words_written, std::memory_order_relaxed);
+    }
+    else {
+        errors.fetch_add(1, std::memory_order_relaxed);
+        if (timeout) {
+            timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+SmaModbusStatistics::Snapshot SmaModbusStatistics::getSnapshot(void) const {
+    Snapshot snapshot;
+    snapshot.requests = requests.load(std::memory_order_relaxed);
+    snapshot.errors = errors.load(std::memory_order_relaxed);
+    snapshot.timeouts = timeouts.load(std::memory_order_relaxed);
+    snapshot.connects = connects.load(std::memory_order_relaxed);
+    snapshot.disconnects = disconnects.load(std::memory_order_relaxed);
+    snapshot.wordsRead = words_read.load(std::memory_order_relaxed);
+    snapshot.wordsWritten = words_written.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        snapshot.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+
+void SmaModbusStatistics::reset(void) {
+    requests.store(0, std::memory_order_relaxed);
+    errors.store(0, std::memory_order_relaxed);
+    timeouts.store(0, std::memory_order_relaxed);
+    words_read.store(0, std::memory_order_relaxed);
+    words_written.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        histogram[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <SmaModbusTrace.hpp>
+
+using namespace libsmamodbus;
+
+
+std::atomic<bool> SmaModbusTrace::enabled(true);
+
+namespace {
+
+    // span slot of a ring buffer; the fields are atomics, as the exporting thread may read a slot while it is overwritten
+    struct Slot {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> begin;
+        std::atomic<uint64_t> end;
+    };
+
+    // ring buffer of a single thread; written by its thread only, read by the exporting thread
+    struct ThreadBuffer {
+        uint32_t threadID;
+        std::atomic<uint64_t> head;     // number of spans recorded so far
+        Slot spans[SmaModbusTrace::BUFFER_SIZE];
+        ThreadBuffer(uint32_t id) : threadID(id), head(0) {}
+    };
+
+    // registry of all thread buffers; the buffer of a finished thread is kept, so that its spans can still be exported,
+    // until it is handed to a new thread
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::vector<ThreadBuffer*> unused;  // buffers of finished threads
+        uint32_t numThreads = 0;
+    };
+
+    Registry& getRegistry(void) {
+        static Registry registry;
+        return registry;
+    }
+
+    // thread local owner returning the buffer to the registry when its thread finishes
+    struct ThreadBufferOwner {
+        ThreadBuffer* buffer = NULL;
+        ~ThreadBufferOwner(void) {
+            if (buffer != NULL) {
+                Registry& registry = getRegistry();
+                std::lock_guard<std::mutex> lock(registry.mutex);
+                registry.unused.push_back(buffer);
+            }
+        }
+    };
+
+    ThreadBuffer& getThreadBuffer(void) {
+        thread_local ThreadBufferOwner owner;
+        if (owner.buffer == NULL) {
+            Registry& registry = getRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            const uint32_t thread_id = ++registry.numThreads;
+            if (!registry.unused.empty()) {
+                owner.buffer = registry.unused.back();
+                registry.unused.pop_back();
+                owner.buffer->threadID = thread_id;
+                owner.buffer->head.store(0, std::memory_order_relaxed);
+            }
+            else {
+                registry.buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer(thread_id)));
+                owner.buffer = registry.buffers.back().get();
+            }
+        }
+        return *owner.buffer;
+    }
+}
+
+
+uint64_t SmaModbusTrace::now(void) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void SmaModbusTrace::record(const char* name, uint64_t begin, uint64_t end) {
+    if (!isEnabled()) {
+        return;
+    }
+    ThreadBuffer& buffer = getThreadBuffer();
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    // order the previous head update before the slot writes; an exporter reading any of them then sees the head, which
+    // tells it that the slot is being overwritten
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot& slot = buffer.spans[head % BUFFER_SIZE];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+
+bool SmaModbusTrace::writeChromeTrace(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        return false;
+    }
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    std::vector<Span> spans;
+    bool first = true;
+
+    fprintf(file, "{\"traceEvents\":[");
+    for (const auto& buffer : registry.buffers) {
+        // copy the spans, then drop those that may have been overwritten by the recording thread while copying
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t count = (head < BUFFER_SIZE ? head : BUFFER_SIZE);
+        spans.resize((size_t)count);
+        for (uint64_t i = 0; i < count; ++i) {
+            const Slot& slot = buffer->spans[(head - count + i) % BUFFER_SIZE];
+            Span& span = spans[(size_t)i];
+            span.name = slot.name.load(std::memory_order_relaxed);
+            span.begin = slot.begin.load(std::memory_order_relaxed);
+            span.end = slot.end.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t head_after = buffer->head.load(std::memory_order_relaxed);
+        uint64_t first_valid = (head_after + 1 > BUFFER_SIZE ? head_after + 1 - BUFFER_SIZE : 0);   // includes a span being written
+        uint64_t skip = (first_valid > head - count ? first_valid - (head - count) : 0);
+        for (uint64_t i = skip; i < count; ++i) {
+            const Span& span = spans[(size_t)i];
+            fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}", (first ? "" : ","),
+                span.name, (unsigned long)buffer->threadID, (double)span.begin / 1000.0, (double)(span.end - span.begin) / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return (fclose(file) == 0);
+}
+
+
+void SmaModbusTrace::clear(void) {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+        buffer->head.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+size_t SmaModbusTrace::getNumBuffers(void) {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.buffers.size();
+}
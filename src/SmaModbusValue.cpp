@@ -1,3 +1,4 @@
+#include <cstring>
 #include <SmaModbus.hpp>
 #include <SmaModbusValue.hpp>
 
@@ -6,9 +7,89 @@ using namespace libsmamodbus;
 const double SmaModbusValue::Double_NaN = nan("1");         //!< NaN value for double data types
 
 
+size_t SmaModbusValue::toChars(char* buffer, size_t size) const {
+    if (type == DataType::STR32) {
+        if (str.size() > size) {
+            return 0;
+        }
+        memcpy(buffer, str.data(), str.size());
+        return str.size();
+    }
+    return toChars(buffer, size, u64, type, format);
+}
+
+
+size_t SmaModbusValue::toChars(char* buffer, size_t size, uint64_t value, const DataType type, const DataFormat format) {
+    if (!isValid(value, type)) {
+        if (size < 3) {
+            return 0;
+        }
+        memcpy(buffer, "NaN", 3);
+        return 3;
+    }
+
+    // determine sign and magnitude
+    bool negative = false;
+    if (type == DataType::S32 && (int32_t)value < 0) {
+        negative = true;
+        value = (uint64_t)(-(int64_t)(int32_t)value);
+    }
+    else if (type == DataType::S64 && (int64_t)value < 0) {
+        negative = true;
+        value = (uint64_t)0 - value;
+    }
+
+    // number of decimals; formats without scaling are printed like "%lf" with 6 decimals
+    size_t decimals = 6;
+    switch (format) {
+    case DataFormat::FIX0:  decimals = 0; break;
+    case DataFormat::FIX1:  decimals = 1; break;
+    case DataFormat::FIX2:  decimals = 2; break;
+    case DataFormat::FIX3:  decimals = 3; break;
+    case DataFormat::FIX4:  decimals = 4; break;
+    default:                break;
+    }
+    const size_t scale = (decimals <= 4 ? decimals : 0);   // FIXn values are integers scaled by 10^n
+
+    // convert to decimal digits in reverse order, including at least one integer digit
+    char digits[MAX_FORMAT_SIZE];
+    size_t ndigits = 0;
+    do {
+        digits[ndigits++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0 || ndigits <= scale);
+
+    size_t length = (negative ? 1 : 0) + ndigits + (decimals > 0 ? 1 : 0) + (decimals - scale);
+    if (length > size) {
+        return 0;
+    }
+    char* out = buffer;
+    if (negative) {
+        *out++ = '-';
+    }
+    while (ndigits > scale) {
+        *out++ = digits[--ndigits];
+    }
+    if (decimals > 0) {
+        *out++ = '.';
+    }
+    while (ndigits > 0) {
+        *out++ = digits[--ndigits];
+    }
+    for (size_t i = scale; i < decimals; ++i) {
+        *out++ = '0';
+    }
+    return (size_t)(out - buffer);
+}
+
+
 namespace libsmamodbus {
 
     std::string toString(const DataType& type) {
+        return toName(type);
+    }
+
+    const char* toName(const DataType& type) {
         switch (type) {
         case DataType::INVALID: return "INVALID";
         case DataType::U32:     return "U32";
@@ -22,6 +103,10 @@ namespace libsmamodbus {
     }
 
     std::string toString(const DataFormat& format) {
+        return toName(format);
+    }
+
+    const char* toName(const DataFormat& format) {
         switch (format) {
         case DataFormat::FIX0:      return "FIX0";
         case DataFormat::FIX1:      return "FIX1";
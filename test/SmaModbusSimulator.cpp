@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <SmaModbusSimulator.hpp>
+
+using namespace MB;
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+
+SmaModbusSimulator::SmaModbusSimulator(uint16_t listen_port, uint32_t seed) :
+    port(listen_port),
+    aligned(false),
+    random(seed),
+    running(false),
+    drop_clients(false)
+{}
+
+
+bool SmaModbusSimulator::start(void) {
+    try {
+        server.listen("127.0.0.1", port);
+    }
+    catch (ModbusException ex) {
+        printf("SmaModbusSimulator::start(%lu) => %s\n", (unsigned long)port, ex.toString().c_str());
+        return false;
+    }
+    running = true;
+    thread = std::thread(&SmaModbusSimulator::run, this);
+    return true;
+}
+
+
+void SmaModbusSimulator::stop(void) {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+    server.close();
+    clients.clear();
+}
+
+
+void SmaModbusSimulator::addRange(uint8_t unit_id, uint32_t first, uint32_t end) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ranges.push_back(Range(unit_id, first, end));
+}
+
+
+void SmaModbusSimulator::setAligned(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    aligned = enable;
+}
+
+
+void SmaModbusSimulator::setFaults(const Faults& fault_settings) {
+    std::lock_guard<std::mutex> lock(mutex);
+    faults = fault_settings;
+}
+
+
+void SmaModbusSimulator::setSocketOptions(const SmaModbusSocket::Options& options) {
+    std::lock_guard<std::mutex> lock(mutex);
+    socket_options = options;
+}
+
+
+SmaModbusSimulator::Statistics SmaModbusSimulator::getStatistics(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+
+size_t SmaModbusSimulator::getNumClients(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return clients.size();
+}
+
+
+uint16_t SmaModbusSimulator::getWord(uint8_t unit_id, uint16_t addr) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = written.find(((uint32_t)unit_id << 16) | addr);
+    return (it != written.end() ? it->second : getDefaultWord(unit_id, addr));
+}
+
+
+void SmaModbusSimulator::setWord(uint8_t unit_id, uint16_t addr, uint16_t word) {
+    std::lock_guard<std::mutex> lock(mutex);
+    written[((uint32_t)unit_id << 16) | addr] = word;
+}
+
+
+void SmaModbusSimulator::run(void) {
+    std::vector<SmaModbusSocket*> sockets;
+    std::vector<size_t> readable;
+    while (running) {
+        if (drop_clients.exchange(false)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            clients.clear();
+        }
+        sockets.clear();
+        sockets.push_back(&server);
+        for (auto& client : clients) {
+            sockets.push_back(&client->socket);
+        }
+        readable.resize(sockets.size());
+        size_t num_readable = SmaModbusSocket::waitReadable(sockets.data(), sockets.size(), 20, readable.data());
+        for (size_t i = 0; i < num_readable; ++i) {
+            if (readable[i] == 0) {
+                std::unique_ptr<Client> client(new Client());
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    client->socket.setOptions(socket_options);
+                }
+                if (server.accept(client->socket)) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++statistics.connections;
+                    clients.push_back(std::move(client));
+                }
+            }
+            else {
+                receiveRequests(*clients[readable[i] - 1]);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        clients.erase(std::remove_if(clients.begin(), clients.end(), [](const std::unique_ptr<Client>& client) { return !client->socket.isOpen(); }), clients.end());
+    }
+}
+
+
+void SmaModbusSimulator::receiveRequests(Client& client) {
+    try {
+        client.size += client.socket.receiveAvailable(client.buffer + client.size, sizeof(client.buffer) - client.size);
+    }
+    catch (ModbusException ex) {
+        return;     // the socket has been closed by the peer
+    }
+    size_t offset = 0;
+    while (client.socket.isOpen() && client.size - offset >= SmaModbusFrame::MBAP_HEADER_SIZE) {
+        size_t frame_size = SmaModbusFrame::getFrameSize(client.buffer + offset);
+        if (frame_size == 0) {
+            client.socket.close();
+            return;
+        }
+        if (client.size - offset < frame_size) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        handleRequest(client, client.buffer + offset, frame_size);
+        offset += frame_size;
+    }
+    memmove(client.buffer, client.buffer + offset, client.size - offset);
+    client.size -= offset;
+}
+
+
+void SmaModbusSimulator::handleRequest(Client& client, const uint8_t* frame, size_t frame_size) {
+    const uint16_t transaction_id = SmaModbusFrame::getTransactionID(frame);
+    const uint8_t unit_id = SmaModbusFrame::getUnitID(frame);
+    const uint8_t function_code = SmaModbusFrame::getFunctionCode(frame);
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+    uint16_t addr = 0;
+    uint16_t num_words = 0;
+    uint8_t response[SmaModbusFrame::MAX_FRAME_SIZE];
+    size_t response_size = 0;
+    ++statistics.requests;
+
+    // inject faults first, so that they hit valid and invalid requests alike
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const double dice = uniform(random);
+    if (dice < faults.dropRate) {
+        ++statistics.drops;
+        client.socket.close();
+        return;
+    }
+    if (dice < faults.dropRate + faults.silenceRate) {
+        ++statistics.silences;
+        return;
+    }
+    if (faults.delay > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(faults.delay));
+    }
+    if (dice < faults.dropRate + faults.silenceRate + faults.exceptionRate) {
+        ++statistics.exceptions;
+        sendResponse(client, response, SmaModbusFrame::encodeExceptionResponse(response, transaction_id, unit_id, function_code, MBErrorCode::SlaveDeviceFailure));
+        return;
+    }
+
+    SmaModbusErrorCode error = SmaModbusFrame::decodeRequest(frame, frame_size, addr, num_words, words);
+    if (error == SmaModbusErrorCode::NoError && !isReadable(unit_id, addr, num_words)) {
+        error = (SmaModbusErrorCode)MBErrorCode::IllegalDataAddress;
+    }
+    if (error == SmaModbusErrorCode::NoError && function_code == MBFunctionCode::ReadAnalogOutputHoldingRegisters &&
+        aligned && (((addr & 1) == 0 && !isRangeStart(unit_id, addr)) || (num_words & 1) != 0)) {
+        error = (SmaModbusErrorCode)MBErrorCode::IllegalDataAddress;
+    }
+    if (error != SmaModbusErrorCode::NoError) {
+        ++statistics.rejected;
+        response_size = SmaModbusFrame::encodeExceptionResponse(response, transaction_id, unit_id, function_code, (uint8_t)error);
+    }
+    else if (function_code == MBFunctionCode::ReadAnalogOutputHoldingRegisters) {
+        for (size_t i = 0; i < num_words; ++i) {
+            auto it = written.find(((uint32_t)unit_id << 16) | (uint16_t)(addr + i));
+            words[i] = (it != written.end() ? it->second : getDefaultWord(unit_id, (uint16_t)(addr + i)));
+        }
+        ++statistics.reads;
+        response_size = SmaModbusFrame::encodeReadResponse(response, transaction_id, unit_id, words, num_words);
+    }
+    else {
+        for (size_t i = 0; i < num_words; ++i) {
+            written[((uint32_t)unit_id << 16) | (uint16_t)(addr + i)] = words[i];
+        }
+        ++statistics.writes;
+        response_size = SmaModbusFrame::encodeWriteResponse(response, transaction_id, unit_id, addr, num_words);
+    }
+    sendResponse(client, response, response_size);
+}
+
+
+bool SmaModbusSimulator::isReadable(uint8_t unit_id, uint32_t addr, uint32_t num_words) const {
+    if (ranges.empty()) {
+        return true;
+    }
+    for (const Range& range : ranges) {
+        if (range.unitID == unit_id && addr >= range.first && addr + num_words <= range.end) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool SmaModbusSimulator::isRangeStart(uint8_t unit_id, uint32_t addr) const {
+    for (const Range& range : ranges) {
+        if (range.unitID == unit_id && addr == range.first) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void SmaModbusSimulator::sendResponse(Client& client, const uint8_t* frame, size_t frame_size) {
+    if (!client.socket.isOpen()) {
+        return;
+    }
+    try {
+        client.socket.send(frame, frame_size);
+    }
+    catch (ModbusException ex) {
+        client.socket.close();
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef __SMAMODBUSSIMULATOR_HPP__
+#define __SMAMODBUSSIMULATOR_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <SmaModbusSocket.hpp>
+#include <SmaModbusFrame.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Class simulating an sma device as a modbus tcp server on the loopback interface, for tests, benchmarks and soak runs.
+     *  It answers read holding registers (0x03) and write multiple registers (0x10) requests from a background thread:
+     *  - reads outside the readable address ranges are rejected with an IllegalDataAddress exception
+     *  - with register alignment, reads starting at an even address or spanning an odd number of words are rejected with an
+     *    IllegalDataAddress exception, like sma devices reject reads of partial registers
+     *  - words never written read as getDefaultWord()
+     *  Faults are injected by a seeded random generator, such that a run can be reproduced.
+     */
+    class SmaModbusSimulator {
+    public:
+
+        /**
+         *  Class holding the fault injection settings; each rate is the probability applied to a single request.
+         */
+        class Faults {
+        public:
+            double dropRate;            //!< Close the connection instead of answering
+            double silenceRate;         //!< Do not answer, such that the client runs into its timeout
+            double exceptionRate;       //!< Answer with a SlaveDeviceFailure exception
+            uint32_t delay;             //!< Delay in milliseconds before each response
+            Faults(void) : dropRate(0.0), silenceRate(0.0), exceptionRate(0.0), delay(0) {}
+        };
+
+        /**
+         *  Class holding simulator statistics.
+         */
+        class Statistics {
+        public:
+            uint64_t connections;       //!< Number of accepted connections
+            uint64_t requests;          //!< Number of requests received
+            uint64_t reads;             //!< Number of successful reads
+            uint64_t writes;            //!< Number of successful writes
+            uint64_t rejected;          //!< Number of requests rejected by an address or function code exception
+            uint64_t drops;             //!< Number of injected connection drops
+            uint64_t silences;          //!< Number of injected missing responses
+            uint64_t exceptions;        //!< Number of injected SlaveDeviceFailure exceptions
+            Statistics(void) : connections(0), requests(0), reads(0), writes(0), rejected(0), drops(0), silences(0), exceptions(0) {}
+        };
+
+    protected:
+        //!< readable address range of a unit id
+        class Range {
+        public:
+            uint8_t unitID;
+            uint32_t first;
+            uint32_t end;
+            Range(uint8_t unit_id, uint32_t first_addr, uint32_t end_addr) : unitID(unit_id), first(first_addr), end(end_addr) {}
+        };
+
+        //!< connected client with its receive buffer
+        class Client {
+        public:
+            SmaModbusSocket socket;
+            uint8_t buffer[2 * SmaModbusFrame::MAX_FRAME_SIZE];
+            size_t size;
+            Client(void) : size(0) {}
+        };
+
+        uint16_t port;
+        SmaModbusSocket server;
+        std::vector<std::unique_ptr<Client>> clients;
+        std::vector<Range> ranges;
+        std::map<uint32_t, uint16_t> written;   //!< written words, keyed by unit id << 16 | address
+        bool aligned;
+        Faults faults;
+        SmaModbusSocket::Options socket_options;
+        std::mt19937 random;
+        Statistics statistics;
+        mutable std::mutex mutex;
+        std::thread thread;
+        std::atomic<bool> running;
+        std::atomic<bool> drop_clients;
+
+    public:
+        /**
+         *  Constructor; the simulator does not listen before start() is called.
+         *  @param port local tcp port to listen on
+         *  @param seed seed of the fault injection
+         */
+        SmaModbusSimulator(uint16_t port, uint32_t seed = 1);
+
+        /** Destructor; stop the simulator. */
+        ~SmaModbusSimulator(void) { stop(); }
+
+        SmaModbusSimulator(const SmaModbusSimulator&) = delete;
+        SmaModbusSimulator& operator=(const SmaModbusSimulator&) = delete;
+
+        /**
+         *  Start listening on 127.0.0.1 and serving requests in a background thread.
+         *  @return true if successful
+         */
+        bool start(void);
+
+        /** Stop serving requests and close all connections. */
+        void stop(void);
+
+        /** Get the tcp port. */
+        uint16_t getPort(void) const { return port; }
+
+        /**
+         *  Add a readable address range; without any range all addresses of all unit ids are readable.
+         *  @param unit_id modbus unit id
+         *  @param first first readable address
+         *  @param end end of the range, exclusive
+         */
+        void addRange(uint8_t unit_id, uint32_t first, uint32_t end);
+
+        /**
+         *  Enable or disable the sma register alignment of reads: reads start at an odd address or at the first address of
+         *  a range, i.e. of a register off the register grid, and span an even number of words.
+         */
+        void setAligned(bool enable);
+
+        /** Set the fault injection settings. */
+        void setFaults(const Faults& fault_settings);
+
+        /** Set the socket options applied to connections accepted afterwards, e.g. to compare TCP_NODELAY settings. */
+        void setSocketOptions(const SmaModbusSocket::Options& options);
+
+        /** Close all client connections with the next poll cycle, e.g. to simulate a device reboot. */
+        void dropConnections(void) { drop_clients = true; }
+
+        /** Get a copy of the statistics. */
+        Statistics getStatistics(void) const;
+
+        /** Get the number of connected clients. */
+        size_t getNumClients(void) const;
+
+        /** Get the current word at the given address. */
+        uint16_t getWord(uint8_t unit_id, uint16_t addr) const;
+
+        /** Set the word at the given address, as if it was written by a client. */
+        void setWord(uint8_t unit_id, uint16_t addr, uint16_t word);
+
+        /** Get the word read from an address that has never been written. */
+        static uint16_t getDefaultWord(uint8_t unit_id, uint16_t addr) { return (uint16_t)(addr * 7u + unit_id); }
+
+    protected:
+        //!< serve requests until stop() is called
+        void run(void);
+
+        //!< receive the available bytes of the given client and handle all complete request frames
+        void receiveRequests(Client& client);
+
+        //!< handle a single request frame; the mutex must be held
+        void handleRequest(Client& client, const uint8_t* frame, size_t frame_size);
+
+        //!< check if the given range is readable; the mutex must be held
+        bool isReadable(uint8_t unit_id, uint32_t addr, uint32_t num_words) const;
+
+        //!< check if a range starts at the given address; the mutex must be held
+        bool isRangeStart(uint8_t unit_id, uint32_t addr) const;
+
+        //!< send a response frame, closing the connection on errors
+        static void sendResponse(Client& client, const uint8_t* frame, size_t frame_size);
+    };
+
+}   // namespace libsmamodbus
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef __SMAMODBUSTEST_HPP__
+#define __SMAMODBUSTEST_HPP__
+
+#include <cstdio>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Minimal test bookkeeping; each test executable calls CHECK() for its assertions and returns SmaModbusTest::result().
+     */
+    class SmaModbusTest {
+    public:
+        /** Count a failed check and print its location. */
+        static bool check(bool condition, const char* expression, const char* file, int line) {
+            if (!condition) {
+                printf("%s:%d: check failed: %s\n", file, line, expression);
+                ++failures();
+            }
+            return condition;
+        }
+
+        /** Get the exit code of the test executable, i.e. 0 if all checks passed. */
+        static int result(void) {
+            printf("%s\n", (failures() == 0 ? "passed" : "FAILED"));
+            return (failures() == 0 ? 0 : 1);
+        }
+
+    protected:
+        static int& failures(void) { static int count = 0; return count; }
+    };
+
+}   // namespace libsmamodbus
+
+#define CHECK(condition) libsmamodbus::SmaModbusTest::check((condition), #condition, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef __SMAMODBUSVALUEORACLE_HPP__
+#define __SMAMODBUSVALUEORACLE_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <SmaModbus.hpp>
+#include <SmaModbusValue.hpp>
+
+
+namespace libsmamodbus {
+
+    /**
+     *  Reference implementation of the SmaModbusValue conversions, used by test_value and fuzz_value to check the optimized code paths.
+     *  It is written for clarity rather than speed: numbers are kept as sign and magnitude, decimal strings are built from
+     *  integers and converted to double by strtod(), which rounds correctly, and doubles are rounded by floor() on their magnitude.
+     */
+    class SmaModbusValueOracle {
+    public:
+        /** Input decoded from a byte string: data type, data format, 4 register words and a double. */
+        class Input {
+        public:
+            DataType type;
+            DataFormat format;
+            uint8_t bytes[8];       //!< big endian register bytes
+            uint16_t words[4];      //!< register words built from bytes
+            double value;           //!< double for the double constructor, any bit pattern
+        };
+
+        /** Decode an input from an arbitrary byte string; missing bytes are taken as 0. */
+        static Input decodeInput(const uint8_t* data, size_t size) {
+            uint8_t buffer[18] = {};
+            memcpy(buffer, data, (size < sizeof(buffer) ? size : sizeof(buffer)));
+            Input input;
+            input.type = (DataType)(buffer[0] % 7);
+            input.format = (DataFormat)(buffer[1] % 11 + 1);
+            memcpy(input.bytes, buffer + 2, 8);
+            for (size_t i = 0; i < 4; ++i) {
+                input.words[i] = (uint16_t)(input.bytes[2 * i] * 256u + input.bytes[2 * i + 1]);
+            }
+            memcpy(&input.value, buffer + 10, sizeof(double));
+            return input;
+        }
+
+        /** Get the number of register words of a data type. */
+        static size_t getNumWords(DataType type) {
+            return (type == DataType::U64 || type == DataType::S64 ? 4 : 2);
+        }
+
+        /** Check if a data type is numeric. */
+        static bool isNumeric(DataType type) {
+            return type == DataType::U32 || type == DataType::S32 || type == DataType::U64 || type == DataType::S64 || type == DataType::ENUM;
+        }
+
+        /** Join big endian register bytes to a bit pattern. */
+        static uint64_t join(const uint8_t* bytes, size_t num_words) {
+            uint64_t result = 0;
+            for (size_t i = 0; i < 2 * num_words; ++i) {
+                result = result * 256u + bytes[i];
+            }
+            return result;
+        }
+
+        /** Get the NaN bit pattern of a data type; 0 for non-numeric types. */
+        static uint64_t getNaN(DataType type) {
+            switch (type) {
+            case DataType::U32:  return 0xffffffffu;
+            case DataType::S32:  return 0x80000000u;
+            case DataType::U64:  return 0xffffffffffffffffu;
+            case DataType::S64:  return 0x8000000000000000u;
+            case DataType::ENUM: return 0x00fffffdu;
+            default:             return 0;
+            }
+        }
+
+        /** Get the number of decimals of a FIXn format, -1 for other formats. */
+        static int getDecimals(DataFormat format) {
+            switch (format) {
+            case DataFormat::FIX0: return 0;
+            case DataFormat::FIX1: return 1;
+            case DataFormat::FIX2: return 2;
+            case DataFormat::FIX3: return 3;
+            case DataFormat::FIX4: return 4;
+            default:               return -1;
+            }
+        }
+
+        /** Split a valid bit pattern into sign and magnitude. */
+        static void toSignMagnitude(uint64_t value, DataType type, bool& negative, uint64_t& magnitude) {
+            negative = false;
+            magnitude = value;
+            if (type == DataType::S32 && value >= 0x80000000u) {
+                negative = true;
+                magnitude = 0x100000000u - value;
+            }
+            if (type == DataType::S64 && value >= 0x8000000000000000u) {
+                negative = true;
+                magnitude = ~value + 1u;
+            }
+        }
+
+        /** Get the exact decimal representation, as expected from SmaModbusValue::toChars(). */
+        static std::string toDecimal(uint64_t value, DataType type, DataFormat format) {
+            if (!isNumeric(type) || value == getNaN(type)) {
+                return "NaN";
+            }
+            bool negative;
+            uint64_t magnitude;
+            toSignMagnitude(value, type, negative, magnitude);
+            char digits[32];
+            snprintf(digits, sizeof(digits), "%llu", (unsigned long long)magnitude);
+            std::string result = digits;
+            const int decimals = getDecimals(format);
+            if (decimals < 0) {
+                result += ".000000";
+            }
+            else if (decimals > 0) {
+                result.insert(0, (size_t)decimals + 1 > result.size() ? (size_t)decimals + 1 - result.size() : 0, '0');
+                result.insert(result.size() - (size_t)decimals, 1, '.');
+            }
+            return (negative ? "-" : "") + result;
+        }
+
+        /** Get the correctly rounded double of a bit pattern, as expected from SmaModbusValue::toDouble(). */
+        static double toDouble(uint64_t value, DataType type, DataFormat format) {
+            if (!isNumeric(type) || value == getNaN(type)) {
+                return NAN;
+            }
+            return strtod(toDecimal(value, type, format).c_str(), NULL);
+        }
+
+        /** Get the bit pattern of a double, as expected from the SmaModbusValue double constructor. */
+        static uint64_t fromDouble(double value, DataType type, DataFormat format) {
+            if (!isNumeric(type)) {
+                return 0;
+            }
+            static const double scale[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0 };
+            const int decimals = getDecimals(format);
+            const double scaled = (decimals > 0 && !std::isnan(value) ? value * scale[decimals] : value);
+            if (std::isnan(scaled) || std::isinf(scaled)) {
+                return getNaN(type);
+            }
+            // round half away from zero; the difference of a double and its floor is exact
+            const double absolute = std::fabs(scaled);
+            const double rounded = std::floor(absolute) + (absolute - std::floor(absolute) >= 0.5 ? 1.0 : 0.0);
+            if (rounded >= 18446744073709551616.0) {
+                return getNaN(type);
+            }
+            const uint64_t magnitude = (uint64_t)rounded;
+            const bool negative = (scaled < 0 && magnitude != 0);
+            switch (type) {
+            case DataType::U32:
+            case DataType::ENUM:
+                return (negative || magnitude > 0xffffffffu ? getNaN(type) : magnitude);
+            case DataType::S32:
+                if (magnitude > (negative ? 0x80000000u : 0x7fffffffu)) {
+                    return getNaN(type);
+                }
+                return (negative ? 0x100000000u - magnitude : magnitude);
+            case DataType::U64:
+                return (negative ? getNaN(type) : magnitude);
+            case DataType::S64:
+                if (magnitude > (negative ? 0x8000000000000000u : 0x7fffffffffffffffu)) {
+                    return getNaN(type);
+                }
+                return (negative ? ~magnitude + 1u : magnitude);
+            default:
+                return 0;
+            }
+        }
+
+        /**
+         *  Compare all conversions of SmaModbusValue for the given input against the reference implementation.
+         *  @param input the input
+         *  @param failure receives a description of the first mismatch
+         *  @return true if all conversions match
+         */
+        static bool check(const Input& input, std::string& failure) {
+            const DataType type = input.type;
+            const DataFormat format = input.format;
+            char context[128];
+            snprintf(context, sizeof(context), "%s %s %02x%02x%02x%02x%02x%02x%02x%02x %.17g: ", toName(type), toName(format),
+                input.bytes[0], input.bytes[1], input.bytes[2], input.bytes[3], input.bytes[4], input.bytes[5], input.bytes[6], input.bytes[7], input.value);
+
+            // the double constructor, for any double
+            const uint64_t encoded = SmaModbusValue(input.value, type, format).u64;
+            if (encoded != fromDouble(input.value, type, format)) {
+                return fail(failure, context, "double constructor");
+            }
+
+            if (type == DataType::STR32) {
+                const std::string str = SmaModbusValue::joinString(input.words, 4);
+                if (str.size() != 8 || memcmp(str.data(), input.bytes, 8) != 0) {
+                    return fail(failure, context, "joinString");
+                }
+                return true;
+            }
+
+            // word joining, as done by register views and readUint()
+            const size_t num_words = getNumWords(type);
+            const uint64_t value = join(input.bytes + 8 - 2 * num_words, num_words);
+            const SmaModbus::RegisterDefinition definition(1, (uint16_t)num_words, type, format, SmaModbus::AccessMode::RO, SmaModbus::Category::Normal, "Test");
+            const SmaModbus::RawRegisterView view(definition, input.words + 4 - num_words);
+            const uint64_t joined = SmaModbusValue::joinWords(input.words + 4 - num_words, num_words);
+            if (joined != value || (isNumeric(type) && view.u64() != value)) {
+                return fail(failure, context, "joinWords");
+            }
+            if (SmaModbusValue::isValid(value, type) != (isNumeric(type) && value != getNaN(type))) {
+                return fail(failure, context, "isValid");
+            }
+
+            // decoding to double; the library rounds twice for magnitudes beyond 2^53, i.e. within 1 ulp
+            const double decoded = SmaModbusValue::toDouble(value, type, format);
+            const double expected = toDouble(value, type, format);
+            if (std::isnan(decoded) != std::isnan(expected) || (!std::isnan(expected) && decoded != expected &&
+                std::fabs(decoded - expected) > std::fabs(expected) * 2.3e-16)) {
+                return fail(failure, context, "toDouble");
+            }
+
+            // formatting straight from the bit pattern
+            char buffer[SmaModbusValue::MAX_FORMAT_SIZE];
+            const size_t length = SmaModbusValue::toChars(buffer, sizeof(buffer), value, type, format);
+            if (std::string(buffer, length) != toDecimal(value, type, format)) {
+                return fail(failure, context, "toChars");
+            }
+
+            // a round trip through double is exact, as long as the value and its scaled intermediate fit the mantissa
+            if (isNumeric(type) && value != getNaN(type)) {
+                bool negative;
+                uint64_t magnitude;
+                toSignMagnitude(value, type, negative, magnitude);
+                if (magnitude <= ((uint64_t)1 << 48) && SmaModbusValue(decoded, type, format).u64 != value) {
+                    return fail(failure, context, "round trip");
+                }
+            }
+            return true;
+        }
+
+    protected:
+        static bool fail(std::string& failure, const char* context, const char* what) {
+            failure = std::string(context) + what;
+            return false;
+        }
+    };
+
+}   // namespace libsmamodbus
+
+#endif
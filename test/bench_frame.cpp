@@ -0,0 +1,104 @@
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <chrono>
+#include <atomic>
+#include <time.h>
+#include <SmaModbusLowLevel.hpp>
+#include <SmaModbusFrame.hpp>
+#include <SmaModbusSimulator.hpp>
+
+using namespace libsmamodbus;
+
+// per-request cost of reading a single 2 word register through SmaModbusLowLevel, i.e. the cost of the modbus tcp
+// framing rather than the payload; build once with and once without SMAMODBUS_USE_LIBMODBUS_TRANSPORT to compare the
+// built-in framing against libmodbus ModbusRequest/ModbusResponse
+
+static const uint16_t PORT = 15611;
+
+// heap allocations of the current thread; the simulator thread is not counted
+static thread_local bool count_allocations = false;
+static std::atomic<uint64_t> num_allocations(0);
+
+void* operator new(size_t size) {
+    if (count_allocations) {
+        ++num_allocations;
+    }
+    void* ptr = malloc(size != 0 ? size : 1);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+
+static double getThreadCpuSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+
+int main(int argc, char** argv) {
+    const size_t num_requests = (argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 100000);
+#ifdef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+    const char* backend = "libmodbus";
+#else
+    const char* backend = "built-in framing";
+#endif
+
+    // framing only: encode a read request and decode its response, without any i/o
+    {
+        uint8_t request[SmaModbusFrame::READ_REQUEST_SIZE];
+        uint8_t response[SmaModbusFrame::MAX_FRAME_SIZE];
+        const uint16_t values[2] = { 0x1234, 0x5678 };
+        const size_t response_size = SmaModbusFrame::encodeReadResponse(response, 1, 3, values, 2);
+        const size_t num_frames = num_requests * 100;
+        uint16_t words[2];
+        uint64_t checksum = 0;
+        count_allocations = true;
+        const uint64_t allocations = num_allocations;
+        const double cpu_start = getThreadCpuSeconds();
+        for (size_t i = 0; i < num_frames; ++i) {
+            checksum += SmaModbusFrame::encodeReadRequest(request, (uint16_t)i, 3, (uint16_t)(30001 + (i & 0xfe)), 2);
+            if (SmaModbusFrame::decodeReadResponse(response, response_size, words, 2) == SmaModbusErrorCode::NoError) {
+                checksum += words[0] + request[9];
+            }
+        }
+        const double cpu_seconds = getThreadCpuSeconds() - cpu_start;
+        count_allocations = false;
+        printf("framing:  %8.1f ns cpu per request, %.2f allocations per request (checksum %llu)\n", cpu_seconds * 1e9 / (double)num_frames,
+            (double)(num_allocations - allocations) / (double)num_frames, (unsigned long long)checksum);
+    }
+
+    // full requests through SmaModbusLowLevel against a simulated device on the loopback interface; the cpu time is the
+    // time of the client thread, including the time spent in the kernel for its socket calls
+    SmaModbusSimulator simulator(PORT);
+    if (!simulator.start()) {
+        return 1;
+    }
+    SmaModbusLowLevel device("127.0.0.1", PORT, SmaModbusUnitID::DEVICE_0);
+    uint16_t words[2];
+    SmaModbusException exception;
+    size_t num_errors = 0;
+    for (size_t i = 0; i < 1000; ++i) {     // warm up, including the connect
+        num_errors += (device.readWords(SmaModbusUnitID::DEVICE_0, 30001, words, 2, exception, false, false) != 2 ? 1 : 0);
+    }
+    count_allocations = true;
+    const uint64_t allocations = num_allocations;
+    const double cpu_start = getThreadCpuSeconds();
+    const auto start_time = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_requests; ++i) {
+        num_errors += (device.readWords(SmaModbusUnitID::DEVICE_0, (uint16_t)(30001 + (i & 0xfe)), words, 2, exception, false, false) != 2 ? 1 : 0);
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    const double cpu_seconds = getThreadCpuSeconds() - cpu_start;
+    count_allocations = false;
+    printf("requests: %8.1f ns cpu per request, %.2f allocations per request, %.1f us round trip, %s, %lu requests, %lu errors\n",
+        cpu_seconds * 1e9 / (double)num_requests, (double)(num_allocations - allocations) / (double)num_requests,
+        seconds * 1e6 / (double)num_requests, backend, (unsigned long)num_requests, (unsigned long)num_errors);
+    return (num_errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <SmaModbusLowLevel.hpp>
+#include <SmaModbusSimulator.hpp>
+
+using namespace libsmamodbus;
+
+// round trip latency against a simulated device on the loopback interface, with the tuned socket options of
+// SmaModbusSocket::Options and with the platform defaults, i.e. Nagle's algorithm and no keepalive, on both ends
+
+static const uint16_t PORT = 15612;
+static const SmaModbusUnitID UNIT_ID = SmaModbusUnitID::DEVICE_0;
+
+typedef std::chrono::steady_clock Clock;
+
+
+static void printLatencies(const char* mode, const char* name, std::vector<double>& latencies, size_t num_errors) {
+    std::sort(latencies.begin(), latencies.end());
+    double sum = 0.0;
+    for (double latency : latencies) {
+        sum += latency;
+    }
+    const size_t n = latencies.size();
+    printf("%-9s %-24s mean %8.1f us  p50 %8.1f us  p99 %8.1f us  max %8.1f us  %lu errors\n", mode, name, sum / (double)n,
+        latencies[n / 2], latencies[n * 99 / 100], latencies[n - 1], (unsigned long)num_errors);
+}
+
+
+static void run(const char* mode, const SmaModbusSocket::Options& options, size_t num_requests) {
+    SmaModbusSimulator simulator(PORT);
+    simulator.setSocketOptions(options);
+    if (!simulator.start()) {
+        exit(1);
+    }
+    SmaModbusLowLevel device("127.0.0.1", PORT, UNIT_ID);
+    device.setSocketOptions(options);
+    std::vector<double> latencies;
+    latencies.reserve(num_requests);
+    uint16_t words[4 * 8];
+    SmaModbusException exception;
+    size_t num_errors = 0;
+    device.readWords(UNIT_ID, 30001, words, 2, exception, false, false);   // connect
+
+    // single reads, one request outstanding
+    for (size_t i = 0; i < num_requests; ++i) {
+        const Clock::time_point start = Clock::now();
+        num_errors += (device.readWords(UNIT_ID, (uint16_t)(30001 + (i & 0xfe)), words, 2, exception, false, false) != 2 ? 1 : 0);
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    printLatencies(mode, "read", latencies, num_errors);
+
+    // single writes; the request frame is larger than a read request
+    latencies.clear();
+    num_errors = 0;
+    for (size_t i = 0; i < num_requests; ++i) {
+        const Clock::time_point start = Clock::now();
+        num_errors += (device.writeUint(40149, 4, i, exception, false, false) ? 0 : 1);
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    printLatencies(mode, "write", latencies, num_errors);
+
+    // pipelined reads of 8 blocks with 4 requests outstanding, i.e. back-to-back small frames in both directions; with
+    // Nagle's algorithm each round waits for delayed acks, so fewer rounds are run
+    device.setPipelineWindow(4);
+    latencies.clear();
+    num_errors = 0;
+    for (size_t i = 0; i < num_requests / 100 + 1; ++i) {
+        std::vector<SmaModbusLowLevel::ReadRequest> requests;
+        for (size_t j = 0; j < 8; ++j) {
+            requests.push_back(SmaModbusLowLevel::ReadRequest(UNIT_ID, (uint16_t)(30001 + 4 * j), 4, words + 4 * j));
+        }
+        const Clock::time_point start = Clock::now();
+        num_errors += requests.size() - device.readBlocks(requests.data(), requests.size(), false);
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    printLatencies(mode, "pipelined 8 blocks", latencies, num_errors);
+    simulator.stop();
+}
+
+
+int main(int argc, char** argv) {
+    const size_t num_requests = (argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 20000);
+
+    SmaModbusSocket::Options defaults;
+    defaults.noDelay = false;
+    defaults.keepAlive = false;
+    run("defaults", defaults, num_requests);
+    run("tuned", SmaModbusSocket::Options(), num_requests);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <random>
+
+// driver for fuzz targets built without libFuzzer, i.e. by compilers other than clang; it accepts the libFuzzer options
+// used by ctest: each file argument is run as a single input, -runs=N runs N random inputs, -seed=S seeds them
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+
+int main(int argc, char** argv) {
+    unsigned long long runs = 0;
+    unsigned long seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "-runs=", 6) == 0) {
+            runs = strtoull(argv[i] + 6, NULL, 10);
+        }
+        else if (strncmp(argv[i], "-seed=", 6) == 0) {
+            seed = strtoul(argv[i] + 6, NULL, 10);
+        }
+        else if (argv[i][0] != '-') {
+            FILE* file = fopen(argv[i], "rb");
+            if (file == NULL) {
+                printf("cannot open %s\n", argv[i]);
+                return 1;
+            }
+            std::vector<uint8_t> data;
+            uint8_t buffer[4096];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                data.insert(data.end(), buffer, buffer + n);
+            }
+            fclose(file);
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+    }
+    std::mt19937 random((uint32_t)seed);
+    std::vector<uint8_t> data;
+    for (unsigned long long r = 0; r < runs; ++r) {
+        data.resize(random() % 64);
+        for (uint8_t& byte : data) {
+            byte = (uint8_t)random();
+        }
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    printf("done, %llu random inputs\n", runs);
+    return 0;
+}
@@ -0,0 +1,17 @@
+#include <cstdio>
+#include <cstdlib>
+#include <SmaModbusValueOracle.hpp>
+
+using namespace libsmamodbus;
+
+
+// libFuzzer entry point: compare all SmaModbusValue conversions of the input against the reference implementation
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string failure;
+    if (!SmaModbusValueOracle::check(SmaModbusValueOracle::decodeInput(data, size), failure)) {
+        printf("mismatch: %s\n", failure.c_str());
+        fflush(stdout);
+        abort();
+    }
+    return 0;
+}
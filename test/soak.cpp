@@ -0,0 +1,307 @@
+#ifdef __linux__
+#include <dirent.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <SmaModbusApi.hpp>
+#include <SmaModbusProxy.hpp>
+#include <SmaModbusStatistics.hpp>
+#include <SmaModbusSimulator.hpp>
+
+using namespace libsmamodbus;
+
+// soak run of the full stack against simulated inverters on the loopback interface: device map discovery by register
+// sweeps, periodic block polling and control writes through SmaModbusApi, with injected connection drops, missing
+// responses, exception responses and device reboots. The first inverter is accessed through a SmaModbusProxy.
+// Memory, file descriptors, latency percentiles and error rates are sampled per window; the run fails if the last
+// window drifted from the first one.
+//
+//   soak [seconds] [inverters] [window seconds]
+//
+// Fault injection is seeded, such that a run can be reproduced.
+
+static const uint16_t FIRST_PORT = 15700;
+static const uint16_t PROXY_PORT = 15699;
+static const SmaModbusUnitID UNIT_ID = SmaModbusUnitID::DEVICE_0;
+static const std::chrono::milliseconds CYCLE_TIME(100);
+static const size_t CONTROL_CYCLES = 10;    // a control write every 10 poll cycles
+static const size_t REBOOT_CYCLES = 50;     // an inverter drops all connections every 50 poll cycles
+
+// address ranges swept for device map discovery; they cover the register catalog
+static const uint32_t DISCOVERY_RANGES[][2] = { { 30001, 31301 }, { 40101, 40301 }, { 40701, 40901 }, { 44001, 44101 }, { 44401, 44501 } };
+
+typedef std::chrono::steady_clock Clock;
+
+
+// simulated inverter with its client connection
+class Inverter {
+public:
+    std::unique_ptr<SmaModbusSimulator> simulator;
+    std::unique_ptr<SmaModbusLowLevel> upstream;    // connection of the proxy, if the inverter is behind the proxy
+    std::unique_ptr<SmaModbusProxy> proxy;
+    std::thread proxy_thread;
+    std::unique_ptr<SmaModbusApi> device;
+    SmaModbus::ReadPlan plan;
+};
+
+
+// sample of the process state and of the request counters of a window
+class Window {
+public:
+    double seconds;
+    size_t rss;
+    size_t fds;
+    SmaModbusStatistics::Snapshot requests;
+    uint64_t openConnections;
+    size_t mismatches;
+};
+
+
+static size_t getResidentBytes(void) {
+#ifdef __linux__
+    FILE* file = fopen("/proc/self/statm", "r");
+    unsigned long size = 0, resident = 0;
+    if (file != NULL) {
+        if (fscanf(file, "%lu %lu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(file);
+    }
+    return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+
+static size_t getNumFileDescriptors(void) {
+#ifdef __linux__
+    size_t count = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir != NULL) {
+        while (readdir(dir) != NULL) {
+            ++count;
+        }
+        closedir(dir);
+    }
+    return (count >= 3 ? count - 3 : 0);    // ".", ".." and the directory itself
+#else
+    return 0;
+#endif
+}
+
+
+static SmaModbusStatistics::Snapshot getStatistics(const std::vector<std::unique_ptr<Inverter>>& inverters) {
+    SmaModbusStatistics::Snapshot total;
+    for (const auto& inverter : inverters) {
+        total += inverter->device->getStatistics().getSnapshot();
+    }
+    return total;
+}
+
+
+// discover the catalog registers of an inverter by register sweeps, resuming interrupted sweeps
+static bool discover(Inverter& inverter) {
+    std::vector<SmaModbus::RegisterDefinition> registers;
+    for (const auto& range : DISCOVERY_RANGES) {
+        SmaModbus::SweepCursor cursor(UNIT_ID, (uint16_t)range[0], range[1]);
+        for (size_t attempt = 0; attempt < 100 && !cursor.isDone(); ++attempt) {
+            inverter.device->sweepKnownRegisters(cursor, [&](SmaModbusUnitID unit_id, const SmaModbus::RawRegisterView& view) {
+                registers.push_back(view.getRegister());
+                return true;
+            });
+        }
+        if (!cursor.isDone()) {
+            return false;
+        }
+    }
+    inverter.plan = inverter.device->createReadPlan(registers);
+    return registers.size() == SmaModbus::getRegisterCatalog().size();
+}
+
+
+static void shutdown(std::vector<std::unique_ptr<Inverter>>& inverters) {
+    for (auto& inverter : inverters) {
+        if (inverter->proxy) {
+            inverter->proxy->stop();
+            if (inverter->proxy_thread.joinable()) {
+                inverter->proxy_thread.join();
+            }
+            inverter->proxy->close();
+        }
+        inverter->simulator->stop();
+    }
+}
+
+
+static void printWindow(size_t index, const Window& window) {
+    printf("window %3lu %7.1fs rss %6.2f MiB fds %4lu open %3lu requests %7lu errors %5lu timeouts %4lu reconnects %4lu p50 %6lu us p99 %7lu us\n",
+        (unsigned long)index, window.seconds, (double)window.rss / 1048576.0, (unsigned long)window.fds, (unsigned long)window.openConnections,
+        (unsigned long)window.requests.requests, (unsigned long)window.requests.errors, (unsigned long)window.requests.timeouts,
+        (unsigned long)window.requests.connects, (unsigned long)window.requests.getPercentile(50), (unsigned long)window.requests.getPercentile(99));
+    fflush(stdout);
+}
+
+
+// compare the last window against the first one; the first window after discovery is the baseline
+static bool checkDrift(const std::vector<Window>& windows, size_t num_inverters) {
+    const Window& first = windows.front();
+    const Window& last = windows.back();
+    bool result = true;
+    auto check = [&result](bool drifted, const char* what, double first_value, double last_value, double limit) {
+        printf("  %-24s first %12.4f  last %12.4f  limit %12.4f  %s\n", what, first_value, last_value, limit, (drifted ? "DRIFT" : "ok"));
+        result &= !drifted;
+    };
+    printf("drift report, window 1 against window %lu:\n", (unsigned long)windows.size());
+    const double rss_limit = std::max(4.0, (double)first.rss / 1048576.0 * 1.1);
+    check((double)last.rss / 1048576.0 > rss_limit, "rss MiB", (double)first.rss / 1048576.0, (double)last.rss / 1048576.0, rss_limit);
+    // connections being re-established after injected faults may hold a descriptor more or less
+    const double fd_limit = (double)(first.fds + 2 * num_inverters);
+    check((double)last.fds > fd_limit, "file descriptors", (double)first.fds, (double)last.fds, fd_limit);
+    check((double)last.openConnections > (double)num_inverters, "open connections", (double)first.openConnections, (double)last.openConnections, (double)num_inverters);
+    const double p99_limit = 2.0 * (double)first.requests.getPercentile(99) + 1000.0;
+    check((double)last.requests.getPercentile(99) > p99_limit, "p99 latency us", (double)first.requests.getPercentile(99), (double)last.requests.getPercentile(99), p99_limit);
+    const double p50_limit = 2.0 * (double)first.requests.getPercentile(50) + 1000.0;
+    check((double)last.requests.getPercentile(50) > p50_limit, "p50 latency us", (double)first.requests.getPercentile(50), (double)last.requests.getPercentile(50), p50_limit);
+    const double error_limit = 2.0 * first.requests.getErrorRate() + 0.01;
+    check(last.requests.getErrorRate() > error_limit, "error rate", first.requests.getErrorRate(), last.requests.getErrorRate(), error_limit);
+    const double rate_limit = 0.5 * (double)first.requests.requests / first.seconds;
+    check((double)last.requests.requests / last.seconds < rate_limit, "requests per second", (double)first.requests.requests / first.seconds,
+        (double)last.requests.requests / last.seconds, rate_limit);
+    size_t mismatches = 0;
+    for (const Window& window : windows) {
+        mismatches += window.mismatches;
+    }
+    check(mismatches > 0, "setpoint mismatches", (double)first.mismatches, (double)mismatches, 0.0);
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    const double duration = (argc > 1 ? atof(argv[1]) : 3600.0);
+    const size_t num_inverters = (argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : 16);
+    const double window_seconds = (argc > 3 ? atof(argv[3]) : 60.0);
+    if (duration < 2 * window_seconds || num_inverters < 1 || num_inverters > 64) {
+        printf("usage: soak [seconds] [inverters] [window seconds]; the run must span at least two windows\n");
+        return 2;
+    }
+
+    SmaModbusSocket::Options options;
+    options.timeout = 250;      // short timeouts, such that injected missing responses are detected quickly
+    SmaModbusSocket::Options proxy_options;
+    proxy_options.timeout = 1000;
+
+    SmaModbusSimulator::Faults faults;
+    faults.dropRate = 0.0005;
+    faults.silenceRate = 0.0005;
+    faults.exceptionRate = 0.001;
+
+    std::vector<std::unique_ptr<Inverter>> inverters;
+    for (size_t i = 0; i < num_inverters; ++i) {
+        std::unique_ptr<Inverter> inverter(new Inverter());
+        const uint16_t port = (uint16_t)(FIRST_PORT + i);
+        inverter->simulator.reset(new SmaModbusSimulator(port, (uint32_t)(i + 1)));
+        for (const SmaModbus::RegisterDefinition& reg : SmaModbus::getRegisterCatalog()) {
+            inverter->simulator->addRange(UNIT_ID, reg.addr, (uint32_t)reg.addr + reg.size);
+        }
+        inverter->simulator->setAligned(true);
+        if (!inverter->simulator->start()) {
+            shutdown(inverters);
+            return 2;
+        }
+        if (i == 0) {
+            inverter->upstream.reset(new SmaModbusLowLevel("127.0.0.1", port, UNIT_ID));
+            inverter->upstream->setSocketOptions(options);
+            inverter->proxy.reset(new SmaModbusProxy(*inverter->upstream, PROXY_PORT));
+            if (!inverter->proxy->open()) {
+                return 2;
+            }
+            inverter->proxy_thread = std::thread(&SmaModbusProxy::run, inverter->proxy.get());
+        }
+        inverter->device.reset(new SmaModbusApi("127.0.0.1", (i == 0 ? PROXY_PORT : port), UNIT_ID));
+        inverter->device->setSocketOptions(i == 0 ? proxy_options : options);
+        inverters.push_back(std::move(inverter));
+    }
+
+    // discovery runs without faults; it is a one-time step and not part of the drift comparison
+    for (size_t i = 0; i < num_inverters; ++i) {
+        if (!discover(*inverters[i])) {
+            printf("discovery of inverter %lu failed\n", (unsigned long)i);
+            shutdown(inverters);
+            return 1;
+        }
+    }
+    printf("discovered %lu registers on each of %lu inverters; running %.0f seconds in windows of %.0f seconds\n",
+        (unsigned long)inverters[0]->plan.registers.size(), (unsigned long)num_inverters, duration, window_seconds);
+    for (auto& inverter : inverters) {
+        inverter->simulator->setFaults(faults);
+    }
+
+    std::vector<Window> windows;
+    const Clock::time_point start_time = Clock::now();
+    Clock::time_point window_start = start_time;
+    Clock::time_point next_cycle = start_time;
+    SmaModbusStatistics::Snapshot window_baseline = getStatistics(inverters);
+    size_t window_mismatches = 0;
+    for (size_t cycle = 0; Clock::now() - start_time < std::chrono::duration<double>(duration); ++cycle) {
+        for (size_t i = 0; i < num_inverters; ++i) {
+            Inverter& inverter = *inverters[i];
+
+            // control writes alternate between external power control and self consumption; a successful power setpoint
+            // write must have reached the inverter. The setpoint register is write-only, so it is checked at the simulator
+            if ((cycle + i) % CONTROL_CYCLES == 0) {
+                if (((cycle + i) / CONTROL_CYCLES) % 2 == 0) {
+                    typedef SmaModbusRegisters::Register40149 R;
+                    const double watts = (double)((cycle * 37 + i * 101) % 5000) - 2500.0;
+                    if (inverter.device->setExternalPowerControlMode(watts)) {
+                        const uint16_t words[2] = { inverter.simulator->getWord(UNIT_ID, R::addr), inverter.simulator->getWord(UNIT_ID, R::addr + 1) };
+                        window_mismatches += (SmaModbusValue::joinWords(words, 2) != R::toBits(R::fromDouble(watts)) ? 1 : 0);
+                    }
+                }
+                else {
+                    inverter.device->setSelfConsumptionMode();
+                }
+            }
+            inverter.device->pollRegisters(inverter.plan);
+        }
+        if (cycle % REBOOT_CYCLES == REBOOT_CYCLES - 1) {
+            inverters[(cycle / REBOOT_CYCLES) % num_inverters]->simulator->dropConnections();
+        }
+
+        const Clock::time_point now = Clock::now();
+        if (now - window_start >= std::chrono::duration<double>(window_seconds)) {
+            Window window;
+            window.seconds = std::chrono::duration<double>(now - window_start).count();
+            window.rss = getResidentBytes();
+            window.fds = getNumFileDescriptors();
+            SmaModbusStatistics::Snapshot total = getStatistics(inverters);
+            window.openConnections = total.getOpenConnections();
+            window.requests = total;
+            window.requests -= window_baseline;
+            window.mismatches = window_mismatches;
+            printWindow(windows.size() + 1, window);
+            windows.push_back(window);
+            window_baseline = total;
+            window_mismatches = 0;
+            window_start = now;
+        }
+        next_cycle += CYCLE_TIME;
+        std::this_thread::sleep_until(next_cycle);
+    }
+
+    shutdown(inverters);
+    if (windows.size() < 2) {
+        printf("the run must span at least two windows\n");
+        return 2;
+    }
+    const bool result = checkDrift(windows, num_inverters);
+    printf("%s\n", (result ? "passed" : "FAILED"));
+    return (result ? 0 : 1);
+}
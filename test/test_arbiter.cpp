@@ -0,0 +1,75 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <SmaModbus.hpp>
+#include <SmaModbusSimulator.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint16_t PORT = 15601;
+static const uint32_t DELAY = 40;           // device response time in milliseconds
+static const size_t NUM_POLLERS = 6;
+static const size_t NUM_BLOCKS = 10;        // blocks per read plan, i.e. requests per poll
+
+
+// an interactive read on a connection shared with several long bulk polls is served before the queued poll requests
+int main(int argc, char** argv) {
+    SmaModbusSimulator simulator(PORT);
+    SmaModbusSimulator::Faults faults;
+    faults.delay = DELAY;
+    simulator.setFaults(faults);
+    if (!CHECK(simulator.start())) {
+        return SmaModbusTest::result();
+    }
+    SmaModbus device("127.0.0.1", PORT);
+
+    // registers far enough apart to be read as separate blocks
+    std::vector<SmaModbus::RegisterDefinition> registers;
+    for (size_t i = 0; i < NUM_BLOCKS; ++i) {
+        registers.push_back(SmaModbus::RegisterDefinition((uint16_t)(31001 + 200 * i), 2, DataType::U32, DataFormat::FIX0,
+            SmaModbus::AccessMode::RO, SmaModbus::Category::Normal, "Test.Bulk"));
+    }
+
+    std::atomic<size_t> num_running(NUM_POLLERS);
+    std::vector<std::thread> pollers;
+    std::vector<size_t> num_valid(NUM_POLLERS, 0);
+    for (size_t i = 0; i < NUM_POLLERS; ++i) {
+        pollers.push_back(std::thread([&, i] {
+            SmaModbus::ReadPlan plan = device.createReadPlan(registers, 2);
+            num_valid[i] = device.pollRegisters(plan);
+            --num_running;
+        }));
+    }
+
+    // wait until all pollers queue requests, then read a single register interactively
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * DELAY));
+    const Clock::time_point start = Clock::now();
+    SmaModbusValue value = device.readRegister(SmaModbus::Register30233());
+    const double latency = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    const size_t still_running = num_running;
+    for (auto& poller : pollers) {
+        poller.join();
+    }
+    printf("interactive read latency %.1f ms, %lu of %lu polls still running\n", latency, (unsigned long)still_running, (unsigned long)NUM_POLLERS);
+
+    CHECK(value.isValid());
+    CHECK(value.u64 == (((uint64_t)SmaModbusSimulator::getDefaultWord(SmaModbusUnitID::DEVICE_0, 30233) << 16) |
+                         SmaModbusSimulator::getDefaultWord(SmaModbusUnitID::DEVICE_0, 30234)));
+    for (size_t i = 0; i < NUM_POLLERS; ++i) {
+        CHECK(num_valid[i] == NUM_BLOCKS);
+    }
+    // behind the queued requests of all pollers the read would take NUM_POLLERS + 1 response times; it must only wait for
+    // the request currently in progress
+    CHECK(still_running == NUM_POLLERS);
+    CHECK(latency < 3.5 * DELAY);
+
+    // the polls are accounted to the Bulk class
+    SmaModbusArbiter& arbiter = device.getArbiter();
+    CHECK(arbiter.getStatistics(SmaModbusArbiter::Priority::Bulk).grants == NUM_POLLERS * NUM_BLOCKS);
+    CHECK(arbiter.getStatistics(SmaModbusArbiter::Priority::Normal).grants == 1);
+    return SmaModbusTest::result();
+}
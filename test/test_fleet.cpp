@@ -0,0 +1,98 @@
+#include <cmath>
+#include <vector>
+#include <SmaModbusFleet.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const size_t NUM_DEVICES = 11;   // not a multiple of LANES, i.e. each register row ends with padding
+
+
+static bool checkReduction(const SmaModbusFleetSnapshot& fleet, size_t reg, double sum, double min, double max, size_t count) {
+    const SmaModbusFleetSnapshot::Reduction reduction = fleet.reduce(reg);
+    const bool nan = (count == 0);
+    return fleet.sum(reg) == sum && reduction.sum == sum &&
+           (nan ? std::isnan(fleet.min(reg)) && std::isnan(reduction.min) : fleet.min(reg) == min && reduction.min == min) &&
+           (nan ? std::isnan(fleet.max(reg)) && std::isnan(reduction.max) : fleet.max(reg) == max && reduction.max == max) &&
+           fleet.count(reg) == count && reduction.count == count;
+}
+
+
+int main(int argc, char** argv) {
+    const std::vector<SmaModbus::RegisterDefinition> registers = {
+        SmaModbus::Register30843(), SmaModbus::Register30845(), SmaModbus::Register30865(), SmaModbus::Register30867()
+    };
+    SmaModbusFleetSnapshot fleet(registers, NUM_DEVICES);
+    CHECK(fleet.getNumRegisters() == 4 && fleet.getNumDevices() == NUM_DEVICES);
+    CHECK(fleet.findRegister(30865) == 2 && fleet.findRegister(30001) == SmaModbusFleetSnapshot::npos);
+
+    // nothing has been set yet: all values are NaN
+    for (size_t reg = 0; reg < fleet.getNumRegisters(); ++reg) {
+        CHECK(checkReduction(fleet, reg, 0.0, 0.0, 0.0, 0));
+        CHECK(std::isnan(fleet.get(reg, 0)) && std::isnan(fleet.get(reg, NUM_DEVICES - 1)));
+    }
+
+    // reductions ignore NaN values and the padding of each row, including values in the last lanes of a row
+    {
+        fleet.beginCycle();
+        for (size_t device = 0; device < NUM_DEVICES; ++device) {
+            fleet.set(0, device, (device % 3 == 1 ? SmaModbusValue::Double_NaN : -(double)device - 0.5));
+            fleet.set(1, device, SmaModbusValue((uint64_t)(device * 10), DataType::U32, DataFormat::FIX0));
+        }
+        fleet.set(1, 4, SmaModbusValue((uint64_t)SmaModbusValue::U32_NaN, DataType::U32, DataFormat::FIX0));
+
+        // register 0: -0.5, -2.5, -3.5, -5.5, -6.5, -8.5, -9.5; all negative, such that max is not the padding
+        CHECK(checkReduction(fleet, 0, -36.5, -9.5, -0.5, 7));
+        // register 1: 0, 10, ..., 100 without 40
+        CHECK(checkReduction(fleet, 1, 510.0, 0.0, 100.0, 10));
+        CHECK(fleet.getValues(1)[NUM_DEVICES - 1] == 100.0 && std::isnan(fleet.get(1, 4)));
+
+        // a single valid value in the last device of the fleet
+        fleet.set(2, NUM_DEVICES - 1, 7.0);
+        CHECK(checkReduction(fleet, 2, 7.0, 7.0, 7.0, 1));
+        CHECK(checkReduction(fleet, 3, 0.0, 0.0, 0.0, 0));
+    }
+
+    // setDevice() sets one value per register, stops at the shorter of both lists, and maps SMA NaN values to NaN
+    {
+        std::vector<SmaModbusValue> values = {
+            SmaModbusValue((uint64_t)(uint32_t)-1500, DataType::S32, DataFormat::FIX3),
+            SmaModbusValue((uint64_t)80, DataType::U32, DataFormat::FIX0),
+            SmaModbusValue((uint64_t)(uint32_t)SmaModbusValue::S32_NaN, DataType::S32, DataFormat::FIX0)
+        };
+        fleet.setDevice(1, values);
+        CHECK(fleet.get(0, 1) == -1.5 && fleet.get(1, 1) == 80.0 && std::isnan(fleet.get(2, 1)) && std::isnan(fleet.get(3, 1)));
+        values.resize(5, SmaModbusValue((uint64_t)1, DataType::S32, DataFormat::FIX0));
+        fleet.setDevice(2, values);
+        CHECK(fleet.get(3, 2) == 1.0);
+        CHECK(checkReduction(fleet, 0, -37.0, -9.5, -0.5, 8));
+    }
+
+    // per-cycle changes: NaN where either cycle has no valid value, and sumDiff() ignores those devices
+    {
+        std::vector<double> previous(fleet.getValues(1), fleet.getValues(1) + NUM_DEVICES);
+        fleet.beginCycle();
+        CHECK(checkReduction(fleet, 1, 0.0, 0.0, 0.0, 0));
+        for (size_t device = 0; device < NUM_DEVICES; ++device) {
+            CHECK(fleet.getPreviousValues(1)[device] == previous[device] || (std::isnan(previous[device]) && std::isnan(fleet.getPreviousValues(1)[device])));
+            if (device != 7) {
+                fleet.set(1, device, device * 10.0 + device);
+            }
+        }
+        double diffs[NUM_DEVICES];
+        fleet.diff(1, diffs);
+        double expected_sum = 0.0;
+        for (size_t device = 0; device < NUM_DEVICES; ++device) {
+            if (device == 4 || device == 7) {
+                CHECK(std::isnan(diffs[device]));
+            }
+            else {
+                CHECK(diffs[device] == fleet.get(1, device) - previous[device]);
+                expected_sum += diffs[device];
+            }
+        }
+        CHECK(fleet.sumDiff(1) == expected_sum);
+        CHECK(fleet.sumDiff(3) == 0.0);     // only the previous cycle has a value
+    }
+    return SmaModbusTest::result();
+}
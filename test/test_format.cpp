@@ -0,0 +1,116 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <SmaModbus.hpp>
+#include <SmaModbusFormat.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const uint16_t STRING_WORDS[16] = { 0x5342, 0x5333, 0x2e37, 0x2d31, 0x3022, 0x5c00 };   // "SBS3.7-10\"\\" and '\0' padding
+
+
+static void addRegister(SmaModbus::ReadPlan& plan, const SmaModbus::RegisterDefinition& reg, const uint16_t* words, bool valid) {
+    plan.registers.push_back(reg);
+    plan.unitIDs.push_back(SmaModbusUnitID::DEVICE_0);
+    plan.offsets.push_back(plan.words.size());
+    plan.words.insert(plan.words.end(), words, words + reg.size);
+    plan.valid.push_back(valid);
+}
+
+
+static SmaModbus::ReadPlan createPlan(void) {
+    static const uint16_t current[2] = { 0xffff, (uint16_t)-1234 };
+    static const uint16_t charge[2] = { 0x0000, 80 };
+    static const uint16_t nan[2] = { 0xffff, 0xffff };
+    SmaModbus::ReadPlan plan;
+    addRegister(plan, SmaModbus::Register30843(), current, true);
+    addRegister(plan, SmaModbus::Register30845(), charge, true);
+    addRegister(plan, SmaModbus::Register30847(), nan, true);     // read, but the SMA NaN value
+    addRegister(plan, SmaModbus::Register30857(), current, false);    // not read
+    addRegister(plan, SmaModbus::RegisterDefinition(40631, 16, DataType::STR32, DataFormat::UTF8, SmaModbus::AccessMode::RW,
+        SmaModbus::Category::Normal, "Nameplate.Location \"a=b\""), STRING_WORDS, true);
+    return plan;
+}
+
+
+static const char* JSON = "{\"Bat.Amp\":-1.234,\"Bat.ChaStt\":80,\"Bat.Diag.ActlCapacNom\":null,\"Bat.Diag.CapacThrpCnt\":null,"
+                          "\"Nameplate.Location \\\"a=b\\\"\":\"SBS3.7-10\\\"\\\\\"}";
+static const char* LINE = "sma\\ fleet\\,a=b,device=sbs37 Bat.Amp=-1.234,Bat.ChaStt=80,Nameplate.Location\\ \"a\\=b\"=\"SBS3.7-10\\\"\\\\\" 1700000000\n";
+
+
+int main(int argc, char** argv) {
+    const SmaModbus::ReadPlan plan = createPlan();
+
+    // json: escaped keys and strings, null for invalid values, trimmed strings
+    {
+        char buffer[512];
+        SmaModbusFormatter formatter(buffer, sizeof(buffer));
+        formatter.appendJson(plan);
+        CHECK(!formatter.hasOverflow() && std::string(formatter.data(), formatter.size()) == JSON);
+
+        formatter.clear();
+        const char control[] = { 'a', '\n', '\t', '\r', 0x01, 0x1f, '"', '\\', 'z' };
+        formatter.appendJsonString(control, sizeof(control));
+        CHECK(std::string(formatter.data(), formatter.size()) == "\"a\\n\\t\\r\\u0001\\u001f\\\"\\\\z\"");
+    }
+
+    // line protocol: escaped measurement and keys, quoted strings, invalid values omitted
+    {
+        char buffer[512];
+        SmaModbusFormatter formatter(buffer, sizeof(buffer));
+        formatter.appendLineProtocol("sma fleet,a=b", "device=sbs37", plan, 1700000000);
+        CHECK(!formatter.hasOverflow() && std::string(formatter.data(), formatter.size()) == LINE);
+
+        formatter.clear();
+        formatter.appendLineProtocol("sma", NULL, plan);
+        const std::string line(formatter.data(), formatter.size());
+        CHECK(line.compare(0, 14, "sma Bat.Amp=-1") == 0 && line[line.size() - 2] == '"' && line[line.size() - 1] == '\n');
+
+        // a line without any valid value is not appended, and is not an overflow
+        SmaModbus::ReadPlan invalid = plan;
+        invalid.valid.assign(invalid.valid.size(), false);
+        formatter.clear();
+        formatter.append("x");
+        formatter.appendLineProtocol("sma", NULL, invalid);
+        CHECK(formatter.size() == 1 && !formatter.hasOverflow());
+    }
+
+    // objects, strings and lines that do not fit are rolled back as a whole, for each possible remaining space
+    {
+        const size_t json_length = strlen(JSON);
+        const size_t line_length = strlen(LINE);
+        size_t num_rollbacks = 0;
+        for (size_t capacity = 1; capacity <= json_length + line_length; ++capacity) {
+            char buffer[512];
+            SmaModbusFormatter formatter(buffer, capacity);
+            formatter.append('x');
+            formatter.appendJson(plan);
+            const bool json_fits = (capacity >= json_length + 1);
+            CHECK(formatter.size() == (json_fits ? json_length + 1 : 1) && formatter.hasOverflow() == !json_fits);
+
+            formatter.clear();
+            formatter.append('x');
+            formatter.appendLineProtocol("sma fleet,a=b", "device=sbs37", plan, 1700000000);
+            const bool line_fits = (capacity >= line_length + 1);
+            CHECK(formatter.size() == (line_fits ? line_length + 1 : 1) && formatter.hasOverflow() == !line_fits);
+
+            formatter.clear();
+            formatter.append('x');
+            formatter.appendJsonString("a\"b", 3);
+            CHECK(formatter.size() == (capacity >= 7 ? 7 : 1) && formatter.hasOverflow() == (capacity < 7));
+            num_rollbacks += (json_fits ? 0 : 1) + (line_fits ? 0 : 1);
+        }
+        CHECK(num_rollbacks == json_length + line_length);
+
+        // the overflow flag is sticky until clear(), while later appends that fit still succeed
+        char buffer[8];
+        SmaModbusFormatter formatter(buffer, sizeof(buffer));
+        formatter.appendJson(plan);
+        formatter.append("ok", 2);
+        CHECK(formatter.hasOverflow() && std::string(formatter.data(), formatter.size()) == "ok");
+        formatter.clear();
+        CHECK(!formatter.hasOverflow() && formatter.size() == 0);
+    }
+    return SmaModbusTest::result();
+}
@@ -0,0 +1,175 @@
+#include <cstring>
+#include <thread>
+#include <SmaModbus.hpp>
+#include <SmaModbusFrame.hpp>
+#include <SmaModbusSocket.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+static const uint16_t PORT = 15608;
+static const uint8_t UNIT_ID = 3;
+static const uint16_t WORDS[SmaModbusFrame::MAX_READ_WORDS] = { 0x1234, 0xabcd, 0x0000, 0xffff };
+
+#define CHECK_ERROR(call, error) CHECK((call) == (SmaModbusErrorCode)(error))
+
+
+// decode a response frame after setting the given byte
+static SmaModbusErrorCode decodeCorrupted(const uint8_t* frame, size_t frame_size, size_t offset, uint8_t value, size_t num_words) {
+    uint8_t copy[SmaModbusFrame::MAX_FRAME_SIZE];
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+    memcpy(copy, frame, frame_size);
+    copy[offset] = value;
+    return SmaModbusFrame::decodeReadResponse(copy, frame_size, words, num_words);
+}
+
+
+#ifndef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+
+// answer one read request per connection; the first connection receives a response with a wrong transaction id
+static void serve(SmaModbusSocket& server) {
+    for (uint16_t offset : { 1, 0 }) {
+        SmaModbusSocket client;
+        SmaModbusSocket* sockets[1] = { &server };
+        size_t readable[1];
+        if (SmaModbusSocket::waitReadable(sockets, 1, 5000, readable) == 0 || !server.accept(client)) {
+            return;
+        }
+        try {
+            uint8_t request[SmaModbusFrame::READ_REQUEST_SIZE];
+            uint8_t response[SmaModbusFrame::MAX_FRAME_SIZE];
+            client.receive(request, sizeof(request));
+            size_t response_size = SmaModbusFrame::encodeReadResponse(response, (uint16_t)(SmaModbusFrame::getTransactionID(request) + offset),
+                SmaModbusFrame::getUnitID(request), WORDS, SmaModbusFrame::getWord(request + 10));
+            client.send(response, response_size);
+        }
+        catch (...) {
+            return;
+        }
+    }
+}
+
+#endif
+
+
+int main(int argc, char** argv) {
+    uint8_t frame[SmaModbusFrame::MAX_FRAME_SIZE];
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+    uint16_t addr = 0;
+    uint16_t num_words = 0;
+
+    // requests: encoded frames decode to the same address and words; sizes of 0 or above the function code limit are rejected
+    {
+        CHECK(SmaModbusFrame::encodeReadRequest(frame, 0x0102, UNIT_ID, 30843, 0) == 0);
+        CHECK(SmaModbusFrame::encodeReadRequest(frame, 0x0102, UNIT_ID, 30843, SmaModbusFrame::MAX_READ_WORDS + 1) == 0);
+        CHECK(SmaModbusFrame::encodeWriteRequest(frame, 0x0102, UNIT_ID, 40149, WORDS, 0) == 0);
+        CHECK(SmaModbusFrame::encodeWriteRequest(frame, 0x0102, UNIT_ID, 40149, WORDS, SmaModbusFrame::MAX_WRITE_WORDS + 1) == 0);
+
+        size_t size = SmaModbusFrame::encodeReadRequest(frame, 0x0102, UNIT_ID, 30843, SmaModbusFrame::MAX_READ_WORDS);
+        CHECK(size == SmaModbusFrame::READ_REQUEST_SIZE && SmaModbusFrame::getFrameSize(frame) == size);
+        CHECK(SmaModbusFrame::getTransactionID(frame) == 0x0102 && SmaModbusFrame::getUnitID(frame) == UNIT_ID && SmaModbusFrame::getFunctionCode(frame) == 0x03);
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), SmaModbusErrorCode::NoError);
+        CHECK(addr == 30843 && num_words == SmaModbusFrame::MAX_READ_WORDS);
+        SmaModbusFrame::setWord(frame + 10, 0);
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), MBErrorCode::IllegalDataValue);
+        SmaModbusFrame::setWord(frame + 10, SmaModbusFrame::MAX_READ_WORDS + 1);
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), MBErrorCode::IllegalDataValue);
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size - 1, addr, num_words, words), MBErrorCode::IllegalDataValue);
+        frame[7] = 0x04;
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), MBErrorCode::IllegalFunction);
+
+        size = SmaModbusFrame::encodeWriteRequest(frame, 0x0203, UNIT_ID, 40149, WORDS, 4);
+        CHECK(size == SmaModbusFrame::MBAP_HEADER_SIZE + 6 + 8 && SmaModbusFrame::getFrameSize(frame) == size);
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), SmaModbusErrorCode::NoError);
+        CHECK(addr == 40149 && num_words == 4 && memcmp(words, WORDS, 8) == 0);
+        frame[12] = 6;      // byte count does not match the number of words
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), MBErrorCode::IllegalDataValue);
+        size = SmaModbusFrame::encodeWriteRequest(frame, 0x0203, UNIT_ID, 40149, WORDS, SmaModbusFrame::MAX_WRITE_WORDS);
+        CHECK(size == SmaModbusFrame::MBAP_HEADER_SIZE + 6 + 2 * SmaModbusFrame::MAX_WRITE_WORDS);
+        CHECK_ERROR(SmaModbusFrame::decodeRequest(frame, size, addr, num_words, words), SmaModbusErrorCode::NoError);
+    }
+
+    // read responses: wrong frame sizes and byte counts
+    {
+        CHECK(SmaModbusFrame::encodeReadResponse(frame, 7, UNIT_ID, WORDS, 0) == 0);
+        CHECK(SmaModbusFrame::encodeReadResponse(frame, 7, UNIT_ID, WORDS, SmaModbusFrame::MAX_READ_WORDS + 1) == 0);
+        CHECK(SmaModbusFrame::encodeReadResponse(frame, 7, UNIT_ID, WORDS, SmaModbusFrame::MAX_READ_WORDS) == SmaModbusFrame::MAX_FRAME_SIZE - 1);
+
+        const size_t size = SmaModbusFrame::encodeReadResponse(frame, 7, UNIT_ID, WORDS, 4);
+        CHECK(size == SmaModbusFrame::MBAP_HEADER_SIZE + 2 + 8);
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size, words, 4), SmaModbusErrorCode::NoError);
+        CHECK(memcmp(words, WORDS, 8) == 0);
+
+        // the frame size must match the length field of the MBAP header
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size - 1, words, 4), MBErrorCode::ProtocolError);
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size + 1, words, 4), MBErrorCode::ProtocolError);
+        CHECK_ERROR(decodeCorrupted(frame, size, 5, (uint8_t)(frame[5] + 2), 4), MBErrorCode::ProtocolError);
+        CHECK_ERROR(decodeCorrupted(frame, size, 3, 1, 4), MBErrorCode::ProtocolError);       // protocol id
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, SmaModbusFrame::MBAP_HEADER_SIZE + 1, words, 4), MBErrorCode::ProtocolError);
+
+        // the byte count must match the expected number of words and the frame size
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size, words, 3), SmaModbusErrorCode::InvalidNumberOfRegisters);
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size, words, 5), SmaModbusErrorCode::InvalidNumberOfRegisters);
+        CHECK_ERROR(decodeCorrupted(frame, size, 8, 6, 3), SmaModbusErrorCode::InvalidNumberOfRegisters);
+        CHECK_ERROR(decodeCorrupted(frame, size, 8, 7, 4), SmaModbusErrorCode::InvalidNumberOfRegisters);
+
+        // a response of another function code
+        CHECK_ERROR(decodeCorrupted(frame, size, 7, 0x04, 4), MBErrorCode::ProtocolError);
+        CHECK_ERROR(decodeCorrupted(frame, size, 7, 0x90, 4), MBErrorCode::ProtocolError);
+    }
+
+    // exception responses are errors, carrying the exception code; malformed exception responses are protocol errors
+    {
+        size_t size = SmaModbusFrame::encodeExceptionResponse(frame, 7, UNIT_ID, 0x03, MBErrorCode::IllegalDataAddress);
+        CHECK(size == SmaModbusFrame::EXCEPTION_RESPONSE_SIZE && SmaModbusFrame::getFunctionCode(frame) == 0x83);
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size, words, 2), MBErrorCode::IllegalDataAddress);
+        CHECK_ERROR(decodeCorrupted(frame, size, 8, SmaModbusFrame::GATEWAY_TARGET_FAILED, 2), SmaModbusFrame::GATEWAY_TARGET_FAILED);
+        CHECK_ERROR(decodeCorrupted(frame, size, 8, 0, 2), MBErrorCode::ProtocolError);
+        CHECK_ERROR(SmaModbusFrame::decodeWriteResponse(frame, size, 40149, 2), MBErrorCode::ProtocolError);
+
+        // an exception response with trailing data
+        SmaModbusFrame::setWord(frame + 4, 4);
+        frame[size] = 0;
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size + 1, words, 2), MBErrorCode::ProtocolError);
+
+        size = SmaModbusFrame::encodeExceptionResponse(frame, 7, UNIT_ID, 0x10, MBErrorCode::SlaveDeviceFailure);
+        CHECK_ERROR(SmaModbusFrame::decodeWriteResponse(frame, size, 40149, 2), MBErrorCode::SlaveDeviceFailure);
+    }
+
+    // write responses must echo the address and number of words of the request
+    {
+        const size_t size = SmaModbusFrame::encodeWriteResponse(frame, 7, UNIT_ID, 40149, 2);
+        CHECK(size == SmaModbusFrame::WRITE_RESPONSE_SIZE);
+        CHECK_ERROR(SmaModbusFrame::decodeWriteResponse(frame, size, 40149, 2), SmaModbusErrorCode::NoError);
+        CHECK_ERROR(SmaModbusFrame::decodeWriteResponse(frame, size, 40151, 2), MBErrorCode::ProtocolError);
+        CHECK_ERROR(SmaModbusFrame::decodeWriteResponse(frame, size, 40149, 4), SmaModbusErrorCode::InvalidNumberOfRegisters);
+        CHECK_ERROR(SmaModbusFrame::decodeWriteResponse(frame, size - 1, 40149, 2), MBErrorCode::ProtocolError);
+        CHECK_ERROR(SmaModbusFrame::decodeReadResponse(frame, size, words, 2), MBErrorCode::ProtocolError);
+    }
+
+#ifndef SMAMODBUS_USE_LIBMODBUS_TRANSPORT
+    // a response with another transaction id fails the request and closes the connection; the next request reconnects
+    {
+        SmaModbusSocket server;
+        try {
+            server.listen("127.0.0.1", PORT);
+        }
+        catch (...) {
+            CHECK(false);
+            return SmaModbusTest::result();
+        }
+        std::thread thread(serve, std::ref(server));
+        SmaModbus device("127.0.0.1", PORT, (SmaModbusUnitID)UNIT_ID);
+        SmaModbusException exception;
+        CHECK(device.readWords((SmaModbusUnitID)UNIT_ID, 30001, words, 2, exception, false, true) == 0);
+        CHECK(exception.getErrorCode() == (SmaModbusErrorCode)MBErrorCode::InvalidMessageID);
+
+        exception = SmaModbusException();
+        CHECK(device.readWords((SmaModbusUnitID)UNIT_ID, 30001, words, 2, exception, false, true) == 2);
+        CHECK(!exception.hasError() && words[0] == WORDS[0] && words[1] == WORDS[1]);
+        thread.join();
+    }
+#endif
+    return SmaModbusTest::result();
+}
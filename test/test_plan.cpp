@@ -0,0 +1,164 @@
+#include <cstdio>
+#include <vector>
+#include <SmaModbus.hpp>
+#include <SmaModbusSimulator.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const uint16_t PORT = 15605;
+static const SmaModbusUnitID UNIT_ID = SmaModbusUnitID::DEVICE_0;
+static const SmaModbusUnitID OTHER_UNIT_ID = (SmaModbusUnitID)4;
+
+// registers on both sides of a hole from 30061 to 30081 of the simulated register map
+static const uint16_t ADDRESSES[] = { 30001, 30003, 30051, 30059, 30081, 30099 };
+
+
+static std::vector<SmaModbus::RegisterDefinition> createRegisters(void) {
+    std::vector<SmaModbus::RegisterDefinition> registers;
+    for (uint16_t addr : ADDRESSES) {
+        registers.push_back(SmaModbus::RegisterDefinition(addr, 2, DataType::U32, DataFormat::RAW,
+            SmaModbus::AccessMode::RO, SmaModbus::Category::Normal, "Test.Plan"));
+    }
+    return registers;
+}
+
+
+// check that each register of the plan holds the words of the simulated device for its unit id
+static bool checkValues(const SmaModbus::ReadPlan& plan, const std::vector<SmaModbusValue>& values) {
+    bool result = (values.size() == plan.registers.size());
+    for (size_t i = 0; result && i < plan.registers.size(); ++i) {
+        const SmaModbus::RegisterDefinition& reg = plan.registers[i];
+        const uint64_t expected = ((uint64_t)SmaModbusSimulator::getDefaultWord(plan.unitIDs[i], reg.addr) << 16) |
+            SmaModbusSimulator::getDefaultWord(plan.unitIDs[i], (uint16_t)(reg.addr + 1));
+        result = (plan.valid[i] && values[i].isValid() && values[i].u64 == expected);
+    }
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    // learned limits: covered spans are readable, covering spans are unreadable, and newer information replaces older
+    {
+        SmaModbusDeviceLimits limits;
+        limits.markReadable(3, 100, 10);
+        CHECK(limits.isReadable(3, 100, 10) && limits.isReadable(3, 102, 4));
+        CHECK(!limits.isReadable(3, 96, 10) && !limits.isReadable(4, 102, 4));
+        limits.markReadable(3, 104, 4);
+        CHECK(limits.getReadableSpans().size() == 1);
+
+        limits.markUnreadable(3, 200, 4);
+        CHECK(limits.isUnreadable(3, 200, 4) && limits.isUnreadable(3, 198, 10));
+        CHECK(!limits.isUnreadable(3, 201, 2) && !limits.isUnreadable(4, 198, 10));
+        CHECK(!limits.isReadable(3, 200, 4));
+
+        // a successful read of a covering span drops the rejected span, a rejected read drops the readable spans covering it
+        limits.markReadable(3, 190, 20);
+        CHECK(!limits.isUnreadable(3, 198, 10) && limits.isReadable(3, 200, 4));
+        limits.markUnreadable(3, 102, 4);
+        CHECK(!limits.isReadable(3, 100, 10) && limits.isUnreadable(3, 100, 10));
+
+        // the limits survive a save and load
+        const std::string path = "test_plan.limits";
+        CHECK(limits.save(path));
+        SmaModbusDeviceLimits loaded;
+        CHECK(loaded.load(path));
+        CHECK(loaded.getReadableSpans().size() == limits.getReadableSpans().size());
+        CHECK(loaded.getUnreadableSpans().size() == limits.getUnreadableSpans().size());
+        CHECK(loaded.isReadable(3, 200, 4) && loaded.isUnreadable(3, 100, 10));
+        remove(path.c_str());
+    }
+
+    SmaModbusSimulator simulator(PORT);
+    simulator.addRange(UNIT_ID, 30001, 30061);
+    simulator.addRange(UNIT_ID, 30081, 30101);
+    simulator.addRange(OTHER_UNIT_ID, 30001, 30005);
+    if (!CHECK(simulator.start())) {
+        return SmaModbusTest::result();
+    }
+    const std::vector<SmaModbus::RegisterDefinition> registers = createRegisters();
+    SmaModbus device("127.0.0.1", PORT, UNIT_ID);
+
+    // a block spanning the hole is rejected with IllegalDataAddress and bisected by register count until all blocks are read
+    {
+        SmaModbus::ReadPlan plan = device.createReadPlan(registers);
+        CHECK(plan.blocks.size() == 1 && plan.blocks[0].addr == 30001 && plan.blocks[0].size == 100);
+        const SmaModbusSimulator::Statistics before = simulator.getStatistics();
+        CHECK(checkValues(plan, device.readRegisters(plan)));
+        const SmaModbusSimulator::Statistics after = simulator.getStatistics();
+        printf("first poll: %lu requests, %lu rejected, %lu blocks\n", (unsigned long)(after.requests - before.requests),
+            (unsigned long)(after.rejected - before.rejected), (unsigned long)plan.blocks.size());
+        CHECK(after.requests - before.requests == 5 && after.rejected - before.rejected == 2);
+
+        // 30001..30051 | 30059 | 30081..30099; the refined blocks are kept for subsequent polls
+        CHECK(plan.blocks.size() == 3);
+        CHECK(plan.blocks[0].addr == 30001 && plan.blocks[0].size == 52 && plan.blocks[0].first == 0 && plan.blocks[0].count == 3);
+        CHECK(plan.blocks[1].addr == 30059 && plan.blocks[1].size == 2 && plan.blocks[1].count == 1);
+        CHECK(plan.blocks[2].addr == 30081 && plan.blocks[2].size == 20 && plan.blocks[2].count == 2);
+        CHECK(device.getDeviceLimits().isUnreadable(UNIT_ID, 30001, 100) && device.getDeviceLimits().isUnreadable(UNIT_ID, 30059, 42));
+        CHECK(device.getDeviceLimits().isReadable(UNIT_ID, 30001, 52) && device.getDeviceLimits().isReadable(UNIT_ID, 30081, 20));
+
+        const uint64_t requests = simulator.getStatistics().requests;
+        CHECK(checkValues(plan, device.readRegisters(plan)));
+        CHECK(simulator.getStatistics().requests - requests == 3);
+        CHECK(simulator.getStatistics().rejected == after.rejected);
+    }
+
+    // later plans use the learned spans: readable spans regardless of the maximum gap, and no block covers a rejected span
+    {
+        SmaModbus::ReadPlan plan = device.createReadPlan(registers, 0);
+        CHECK(plan.blocks.size() == 3);
+        CHECK(plan.blocks[0].addr == 30001 && plan.blocks[0].size == 52);
+        CHECK(plan.blocks[2].addr == 30081 && plan.blocks[2].size == 20);
+        const SmaModbusSimulator::Statistics before = simulator.getStatistics();
+        CHECK(checkValues(plan, device.readRegisters(plan)));
+        CHECK(simulator.getStatistics().requests - before.requests == 3);
+        CHECK(simulator.getStatistics().rejected == before.rejected);
+
+        // without learned spans, the same maximum gap gives a block per group of adjacent registers
+        SmaModbus fresh("127.0.0.1", PORT, UNIT_ID);
+        CHECK(fresh.createReadPlan(registers, 0).blocks.size() == 5);
+
+        for (const SmaModbus::ReadBlock& block : device.createReadPlan(registers).blocks) {
+            CHECK(!device.getDeviceLimits().isUnreadable(block.unitID, block.addr, block.size));
+        }
+    }
+
+    // a plan over two unit ids: blocks never span both, even where their addresses are adjacent, and each value is read
+    // from the unit id of its register; a register rejected by one unit id does not affect the other
+    {
+        std::vector<SmaModbus::RegisterDefinition> mixed;
+        std::vector<SmaModbusUnitID> unit_ids;
+        for (size_t i = 0; i < 3; ++i) {
+            mixed.push_back(registers[i]);
+            unit_ids.push_back(OTHER_UNIT_ID);
+            mixed.push_back(registers[i]);
+            unit_ids.push_back(UNIT_ID);
+        }
+        SmaModbus fresh("127.0.0.1", PORT, UNIT_ID);
+        SmaModbus::ReadPlan plan = fresh.createReadPlan(mixed, unit_ids);
+        CHECK(plan.blocks.size() == 2);
+        CHECK(plan.blocks[0].unitID == UNIT_ID && plan.blocks[1].unitID == OTHER_UNIT_ID);
+        const std::vector<SmaModbusValue> values = fresh.readRegisters(plan);
+        for (const SmaModbus::ReadBlock& block : plan.blocks) {
+            for (size_t i = block.first; i < block.first + block.count; ++i) {
+                CHECK(plan.unitIDs[plan.order[i]] == block.unitID);
+            }
+        }
+
+        // 30051 is not mapped for the other unit id; its block is bisected and only that register is invalid
+        for (size_t i = 0; i < plan.registers.size(); ++i) {
+            const uint64_t expected = ((uint64_t)SmaModbusSimulator::getDefaultWord(unit_ids[i], mixed[i].addr) << 16) |
+                SmaModbusSimulator::getDefaultWord(unit_ids[i], (uint16_t)(mixed[i].addr + 1));
+            if (unit_ids[i] == OTHER_UNIT_ID && mixed[i].addr == 30051) {
+                CHECK(!plan.valid[i] && !values[i].isValid());
+            }
+            else {
+                CHECK(plan.valid[i] && values[i].u64 == expected);
+            }
+        }
+        CHECK(plan.blocks.size() == 4);
+        CHECK(fresh.getDeviceLimits().isUnreadable(OTHER_UNIT_ID, 30001, 52) && !fresh.getDeviceLimits().isUnreadable(UNIT_ID, 30001, 52));
+    }
+    return SmaModbusTest::result();
+}
@@ -0,0 +1,268 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <SmaModbusProxy.hpp>
+#include <SmaModbusSimulator.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+static const uint16_t DEVICE_PORT = 15603;
+static const uint16_t PROXY_PORT = 15604;
+static const uint8_t UNIT_A = 3;
+static const uint8_t UNIT_B = 4;
+static const size_t NUM_CLIENTS = 3;
+
+// the proxy is polled by the test thread: clients send their requests first, such that a single poll cycle receives all of
+// them, and receive their responses afterwards; the simulated device runs in its own thread
+
+
+class Response {
+public:
+    uint8_t frame[SmaModbusFrame::MAX_FRAME_SIZE];
+    size_t size;
+    Response(void) : size(0) {}
+    uint16_t getTransactionID(void) const { return SmaModbusFrame::getTransactionID(frame); }
+    uint8_t getFunctionCode(void) const { return SmaModbusFrame::getFunctionCode(frame); }
+    uint8_t getExceptionCode(void) const { return (size == SmaModbusFrame::EXCEPTION_RESPONSE_SIZE ? frame[8] : 0); }
+};
+
+
+static void sendRead(SmaModbusSocket& client, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, size_t num_words) {
+    uint8_t frame[SmaModbusFrame::READ_REQUEST_SIZE];
+    client.send(frame, SmaModbusFrame::encodeReadRequest(frame, transaction_id, unit_id, addr, num_words));
+}
+
+
+static void sendWrite(SmaModbusSocket& client, uint16_t transaction_id, uint8_t unit_id, uint16_t addr, const uint16_t* words, size_t num_words) {
+    uint8_t frame[SmaModbusFrame::MAX_FRAME_SIZE];
+    client.send(frame, SmaModbusFrame::encodeWriteRequest(frame, transaction_id, unit_id, addr, words, num_words));
+}
+
+
+static Response receiveResponse(SmaModbusSocket& client) {
+    Response response;
+    try {
+        client.receive(response.frame, SmaModbusFrame::MBAP_HEADER_SIZE);
+        response.size = SmaModbusFrame::getFrameSize(response.frame);
+        if (response.size > SmaModbusFrame::MBAP_HEADER_SIZE && response.size <= sizeof(response.frame)) {
+            client.receive(response.frame + SmaModbusFrame::MBAP_HEADER_SIZE, response.size - SmaModbusFrame::MBAP_HEADER_SIZE);
+        }
+    }
+    catch (MB::ModbusException ex) {
+        response.size = 0;
+    }
+    return response;
+}
+
+
+// check a read response against the words of the simulated device
+static bool checkRead(const Response& response, uint16_t transaction_id, const SmaModbusSimulator& simulator, uint8_t unit_id, uint16_t addr, size_t num_words) {
+    uint16_t words[SmaModbusFrame::MAX_READ_WORDS];
+    if (response.size == 0 || response.getTransactionID() != transaction_id ||
+        SmaModbusFrame::decodeReadResponse(response.frame, response.size, words, num_words) != SmaModbusErrorCode::NoError) {
+        return false;
+    }
+    for (size_t i = 0; i < num_words; ++i) {
+        if (words[i] != simulator.getWord(unit_id, (uint16_t)(addr + i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// run poll cycles until the proxy has received the given total number of requests
+static void serve(SmaModbusProxy& proxy, uint64_t num_requests) {
+    for (size_t i = 0; i < 100 && proxy.getStatistics().requests < num_requests; ++i) {
+        proxy.poll(100);
+    }
+}
+
+
+int main(int argc, char** argv) {
+    SmaModbusSimulator simulator(DEVICE_PORT);
+    simulator.addRange(UNIT_A, 30001, 30301);
+    simulator.addRange(UNIT_A, 30401, 30411);
+    simulator.addRange(UNIT_B, 30001, 30301);
+    if (!CHECK(simulator.start())) {
+        return SmaModbusTest::result();
+    }
+    SmaModbusLowLevel upstream("127.0.0.1", DEVICE_PORT);
+    SmaModbusSocket::Options options;
+    options.timeout = 500;
+    upstream.setSocketOptions(options);
+    SmaModbusProxy proxy(upstream, PROXY_PORT);
+    CHECK(upstream.getPipelineWindow() == SmaModbusProxy::DEFAULT_PIPELINE_WINDOW);
+    if (!CHECK(proxy.open())) {
+        return SmaModbusTest::result();
+    }
+    SmaModbusSocket clients[NUM_CLIENTS];
+    for (SmaModbusSocket& client : clients) {
+        client.setOptions(options);
+        client.connect("127.0.0.1", PROXY_PORT);
+    }
+    for (size_t i = 0; i < 100 && proxy.getNumClients() < NUM_CLIENTS; ++i) {
+        proxy.poll(100);
+    }
+    CHECK(proxy.getNumClients() == NUM_CLIENTS);
+    uint64_t num_requests = 0;
+
+    // identical reads are deduplicated, overlapping and adjacent reads of a unit id are coalesced into blocks of up to 125 words
+    {
+        proxy.setCacheTTL(0);
+        const uint64_t device_reads = simulator.getStatistics().reads;
+        const SmaModbusProxy::Statistics before = proxy.getStatistics();
+        sendRead(clients[0], 1, UNIT_A, 30001, 10);
+        sendRead(clients[1], 2, UNIT_A, 30001, 10);     // duplicate
+        sendRead(clients[2], 3, UNIT_A, 30011, 20);     // adjacent
+        sendRead(clients[0], 4, UNIT_A, 30021, 80);     // overlapping, ends at 30101
+        sendRead(clients[1], 5, UNIT_A, 30101, 25);     // adjacent, the block is 125 words now
+        sendRead(clients[2], 6, UNIT_A, 30126, 10);     // adjacent, but beyond 125 words
+        sendRead(clients[1], 7, UNIT_B, 30001, 10);     // same range of another unit id
+        serve(proxy, num_requests += 7);
+        CHECK(checkRead(receiveResponse(clients[0]), 1, simulator, UNIT_A, 30001, 10));
+        CHECK(checkRead(receiveResponse(clients[0]), 4, simulator, UNIT_A, 30021, 80));
+        CHECK(checkRead(receiveResponse(clients[1]), 2, simulator, UNIT_A, 30001, 10));
+        CHECK(checkRead(receiveResponse(clients[1]), 5, simulator, UNIT_A, 30101, 25));
+        CHECK(checkRead(receiveResponse(clients[1]), 7, simulator, UNIT_B, 30001, 10));
+        CHECK(checkRead(receiveResponse(clients[2]), 3, simulator, UNIT_A, 30011, 20));
+        CHECK(checkRead(receiveResponse(clients[2]), 6, simulator, UNIT_A, 30126, 10));
+        printf("coalescing: %lu upstream reads for 7 requests\n", (unsigned long)(proxy.getStatistics().upstreamReads - before.upstreamReads));
+        CHECK(proxy.getStatistics().upstreamReads - before.upstreamReads == 3);
+        CHECK(proxy.getStatistics().coalesced - before.coalesced == 4);
+        CHECK(simulator.getStatistics().reads - device_reads == 3);
+    }
+
+    // reads covered by fresh cached words are answered without upstream reads, until the words expire
+    {
+        proxy.setCacheTTL(300);
+        const uint64_t device_reads = simulator.getStatistics().reads;
+        const uint64_t cache_hits = proxy.getStatistics().cacheHits;
+        sendRead(clients[0], 10, UNIT_A, 30201, 4);
+        serve(proxy, num_requests += 1);
+        CHECK(checkRead(receiveResponse(clients[0]), 10, simulator, UNIT_A, 30201, 4));
+
+        // a change on the device is not visible before the cached words expire
+        const uint16_t cached = simulator.getWord(UNIT_A, 30202);
+        simulator.setWord(UNIT_A, 30202, (uint16_t)(cached + 1));
+        sendRead(clients[1], 11, UNIT_A, 30202, 2);
+        serve(proxy, num_requests += 1);
+        Response response = receiveResponse(clients[1]);
+        uint16_t words[2];
+        CHECK(SmaModbusFrame::decodeReadResponse(response.frame, response.size, words, 2) == SmaModbusErrorCode::NoError && words[0] == cached);
+        CHECK(proxy.getStatistics().cacheHits - cache_hits == 1);
+        CHECK(simulator.getStatistics().reads - device_reads == 1);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        sendRead(clients[1], 12, UNIT_A, 30202, 2);
+        serve(proxy, num_requests += 1);
+        CHECK(checkRead(receiveResponse(clients[1]), 12, simulator, UNIT_A, 30202, 2));
+        CHECK(proxy.getStatistics().cacheHits - cache_hits == 1);
+        CHECK(simulator.getStatistics().reads - device_reads == 2);
+    }
+
+    // a write through the proxy drops the cached words it overwrites
+    {
+        proxy.setCacheTTL(10000);
+        sendRead(clients[0], 20, UNIT_A, 30211, 6);
+        serve(proxy, num_requests += 1);
+        CHECK(checkRead(receiveResponse(clients[0]), 20, simulator, UNIT_A, 30211, 6));
+
+        const uint16_t values[2] = { 0x1234, 0x5678 };
+        sendWrite(clients[1], 21, UNIT_A, 30213, values, 2);
+        serve(proxy, num_requests += 1);
+        Response response = receiveResponse(clients[1]);
+        CHECK(response.getTransactionID() == 21 && SmaModbusFrame::decodeWriteResponse(response.frame, response.size, 30213, 2) == SmaModbusErrorCode::NoError);
+        CHECK(simulator.getWord(UNIT_A, 30213) == 0x1234 && simulator.getWord(UNIT_A, 30214) == 0x5678);
+
+        // words outside the written range are still cached
+        const uint64_t cache_hits = proxy.getStatistics().cacheHits;
+        sendRead(clients[2], 22, UNIT_A, 30211, 2);
+        serve(proxy, num_requests += 1);
+        CHECK(checkRead(receiveResponse(clients[2]), 22, simulator, UNIT_A, 30211, 2));
+        CHECK(proxy.getStatistics().cacheHits == cache_hits + 1);
+
+        sendRead(clients[2], 23, UNIT_A, 30211, 6);
+        serve(proxy, num_requests += 1);
+        CHECK(checkRead(receiveResponse(clients[2]), 23, simulator, UNIT_A, 30211, 6));
+        CHECK(proxy.getStatistics().cacheHits == cache_hits + 1);
+    }
+
+    // a write is kept behind the reads its client sent before, in the same poll cycle; they see the old words
+    {
+        proxy.setCacheTTL(0);
+        const uint16_t old_words[2] = { simulator.getWord(UNIT_A, 30231), simulator.getWord(UNIT_A, 30232) };
+        const uint16_t values[2] = { (uint16_t)(old_words[0] ^ 0xffff), (uint16_t)(old_words[1] ^ 0xffff) };
+        sendRead(clients[0], 30, UNIT_A, 30231, 2);
+        sendWrite(clients[0], 31, UNIT_A, 30231, values, 2);
+        sendRead(clients[0], 32, UNIT_A, 30231, 2);
+        serve(proxy, num_requests += 3);
+        uint16_t words[2];
+        Response response = receiveResponse(clients[0]);
+        CHECK(response.getTransactionID() == 30 && SmaModbusFrame::decodeReadResponse(response.frame, response.size, words, 2) == SmaModbusErrorCode::NoError);
+        CHECK(words[0] == old_words[0] && words[1] == old_words[1]);
+        response = receiveResponse(clients[0]);
+        CHECK(response.getTransactionID() == 31 && SmaModbusFrame::decodeWriteResponse(response.frame, response.size, 30231, 2) == SmaModbusErrorCode::NoError);
+        response = receiveResponse(clients[0]);
+        CHECK(response.getTransactionID() == 32 && SmaModbusFrame::decodeReadResponse(response.frame, response.size, words, 2) == SmaModbusErrorCode::NoError);
+        CHECK(words[0] == values[0] && words[1] == values[1]);
+    }
+
+    // a coalesced block rejected with IllegalDataAddress is read per range; only the unreadable range is rejected
+    {
+        proxy.setCacheTTL(0);
+        const SmaModbusProxy::Statistics before = proxy.getStatistics();
+        sendRead(clients[0], 40, UNIT_A, 30291, 10);    // readable, up to the end of the range
+        sendRead(clients[1], 41, UNIT_A, 30301, 4);     // adjacent, but not readable
+        sendRead(clients[2], 42, UNIT_A, 30401, 4);     // not coalesced, readable
+        serve(proxy, num_requests += 3);
+        CHECK(checkRead(receiveResponse(clients[0]), 40, simulator, UNIT_A, 30291, 10));
+        Response response = receiveResponse(clients[1]);
+        CHECK(response.getTransactionID() == 41 && response.getFunctionCode() == 0x83 && response.getExceptionCode() == MBErrorCode::IllegalDataAddress);
+        CHECK(checkRead(receiveResponse(clients[2]), 42, simulator, UNIT_A, 30401, 4));
+        CHECK(proxy.getStatistics().upstreamReads - before.upstreamReads == 4);
+        CHECK(proxy.getStatistics().exceptions - before.exceptions == 1);
+    }
+
+    // errors are mapped to exception responses: request errors and modbus exceptions of the device are forwarded,
+    // transport errors are reported as gateway target failures
+    {
+        proxy.setCacheTTL(0);
+        uint8_t frame[SmaModbusFrame::READ_REQUEST_SIZE];
+        SmaModbusFrame::encodeReadRequest(frame, 50, UNIT_A, 30001, 2);
+        frame[7] = 0x04;                                // read input registers is not supported
+        clients[0].send(frame, sizeof(frame));
+        SmaModbusFrame::encodeReadRequest(frame, 51, UNIT_A, 30001, 2);
+        SmaModbusFrame::setWord(frame + 10, 0);         // read of 0 words
+        clients[1].send(frame, sizeof(frame));
+        serve(proxy, num_requests += 2);
+        Response response = receiveResponse(clients[0]);
+        CHECK(response.getTransactionID() == 50 && response.getFunctionCode() == 0x84 && response.getExceptionCode() == MBErrorCode::IllegalFunction);
+        response = receiveResponse(clients[1]);
+        CHECK(response.getTransactionID() == 51 && response.getFunctionCode() == 0x83 && response.getExceptionCode() == MBErrorCode::IllegalDataValue);
+
+        SmaModbusSimulator::Faults faults;
+        faults.exceptionRate = 1.0;
+        simulator.setFaults(faults);
+        sendRead(clients[0], 52, UNIT_A, 30001, 2);
+        const uint16_t value = 1;
+        sendWrite(clients[1], 53, UNIT_A, 30001, &value, 1);
+        serve(proxy, num_requests += 2);
+        response = receiveResponse(clients[0]);
+        CHECK(response.getTransactionID() == 52 && response.getFunctionCode() == 0x83 && response.getExceptionCode() == MBErrorCode::SlaveDeviceFailure);
+        response = receiveResponse(clients[1]);
+        CHECK(response.getTransactionID() == 53 && response.getFunctionCode() == 0x90 && response.getExceptionCode() == MBErrorCode::SlaveDeviceFailure);
+        simulator.setFaults(SmaModbusSimulator::Faults());
+
+        simulator.stop();
+        sendRead(clients[2], 54, UNIT_A, 30001, 2);
+        serve(proxy, num_requests += 1);
+        response = receiveResponse(clients[2]);
+        CHECK(response.getTransactionID() == 54 && response.getFunctionCode() == 0x83 && response.getExceptionCode() == SmaModbusFrame::GATEWAY_TARGET_FAILED);
+    }
+
+    proxy.close();
+    return SmaModbusTest::result();
+}
@@ -0,0 +1,179 @@
+#include <cmath>
+#include <cstdio>
+#include <SmaModbus.hpp>
+#include <SmaModbusRegister.hpp>
+#include <SmaModbusSimulator.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const uint16_t PORT = 15607;
+static const SmaModbusUnitID UNIT_ID = SmaModbusUnitID::DEVICE_0;
+
+enum class BmsMode : uint32_t { Automatic = 2424, Idle = 2953 };
+
+typedef SmaModbusRegister<30513, DataType::U64, DataFormat::FIX0> TotalYield;
+typedef SmaModbusRegister<30775, DataType::S64, DataFormat::FIX1> SignedTotal;
+typedef SmaModbusRegister<40236, DataType::ENUM, DataFormat::RAW, SmaModbus::AccessMode::RW, SmaModbus::Category::DeviceControlObject, BmsMode> TypedBmsMode;
+typedef SmaModbusRegister<45001, DataType::S32, DataFormat::FIX3> Unmapped;
+
+
+// check that a typed register matches the register definition of the same name
+template <typename Register>
+static bool checkRegister(const char* name, const SmaModbus::RegisterDefinition& reg) {
+    const bool result = (Register::addr == reg.addr && Register::size == reg.size && Register::type == reg.type &&
+                         Register::format == reg.format && Register::mode == reg.mode && Register::category == reg.category &&
+                         SmaModbus::findRegister(reg.addr) != NULL && SmaModbus::findRegister(reg.addr)->identifier == reg.identifier);
+    if (!result) {
+        printf("%s: typed register does not match %s at address %u\n", name, reg.identifier.c_str(), (unsigned)reg.addr);
+    }
+    return result;
+}
+
+#define CHECK_REGISTER(name) (++num_checked, CHECK(checkRegister<SmaModbusRegisters::name>(#name, SmaModbus::name())))
+
+
+int main(int argc, char** argv) {
+    // every typed register matches its register definition, and every catalog register has a typed counterpart
+    {
+        size_t num_checked = 0;
+        CHECK_REGISTER(Register30001);
+        CHECK_REGISTER(Register30003);
+        CHECK_REGISTER(Register30005);
+        CHECK_REGISTER(Register30051);
+        CHECK_REGISTER(Register30053);
+        CHECK_REGISTER(Register30059);
+        CHECK_REGISTER(Register30193);
+        CHECK_REGISTER(Register30233);
+        CHECK_REGISTER(Register30843);
+        CHECK_REGISTER(Register30845);
+        CHECK_REGISTER(Register30847);
+        CHECK_REGISTER(Register30857);
+        CHECK_REGISTER(Register30955);
+        CHECK_REGISTER(Register30865);
+        CHECK_REGISTER(Register30867);
+        CHECK_REGISTER(Register31259);
+        CHECK_REGISTER(Register31261);
+        CHECK_REGISTER(Register31263);
+        CHECK_REGISTER(Register31265);
+        CHECK_REGISTER(Register31267);
+        CHECK_REGISTER(Register31269);
+        CHECK_REGISTER(Register40149);
+        CHECK_REGISTER(Register40151);
+        CHECK_REGISTER(Register40153);
+        CHECK_REGISTER(Register40236);
+        CHECK_REGISTER(Register40793);
+        CHECK_REGISTER(Register40795);
+        CHECK_REGISTER(Register40797);
+        CHECK_REGISTER(Register40799);
+        CHECK_REGISTER(Register40801);
+        CHECK_REGISTER(Register44039);
+        CHECK_REGISTER(Register44041);
+        CHECK(num_checked == SmaModbus::getRegisterCatalog().size());
+    }
+
+    // encode and decode: word order, sign extension, fixed-point scaling and SMA NaN values
+    {
+        typedef SmaModbusRegisters::Register44039 Fix2;
+        typedef SmaModbusRegisters::Register30843 Fix3;
+        uint16_t words[4] = { 0 };
+        Fix2::native_type fix2;
+        Fix2::encode(Fix2::fromDouble(-12.34), words);
+        CHECK(Fix2::fromDouble(-12.34).raw == -1234);
+        CHECK(words[0] == 0xffff && words[1] == (uint16_t)-1234);
+        CHECK(Fix2::decode(words, fix2) && fix2.raw == -1234 && fabs(Fix2::toDouble(fix2) + 12.34) < 1e-9);
+        CHECK(Fix2::fromDouble(0.005).raw == 1 && Fix2::fromDouble(-0.005).raw == -1);
+
+        Fix3::native_type fix3(123456);
+        Fix3::encode(fix3, words);
+        CHECK(words[0] == 0x0001 && words[1] == 0xe240);
+        CHECK(Fix3::decode(words, fix3) && fix3.raw == 123456 && fabs(fix3.toDouble() - 123.456) < 1e-9);
+
+        // the SMA NaN value decodes as invalid and converts to a floating point NaN, and vice versa
+        words[0] = 0x8000;
+        words[1] = 0x0000;
+        CHECK(!Fix3::decode(words, fix3) && fix3 == Fix3::nan() && !Fix3::isValid(fix3) && std::isnan(Fix3::toDouble(fix3)));
+        CHECK(Fix3::fromDouble(SmaModbusValue::Double_NaN) == Fix3::nan());
+
+        SmaModbusRegisters::Register30845::native_type u32 = 0;
+        words[0] = 0xffff;
+        words[1] = 0xffff;
+        CHECK(!SmaModbusRegisters::Register30845::decode(words, u32) && u32 == 0xffffffffu);
+        words[1] = 0xfffe;
+        CHECK(SmaModbusRegisters::Register30845::decode(words, u32) && u32 == 0xfffffffeu);
+
+        SmaModbusRegisters::Register30955::native_type enumeration = 0;
+        words[0] = 0x00ff;
+        words[1] = 0xfffd;
+        CHECK(!SmaModbusRegisters::Register30955::decode(words, enumeration) && enumeration == SmaModbusValue::Enum_NaN);
+
+        // 64-bit registers span four words
+        TotalYield::native_type u64 = 0;
+        TotalYield::encode(0x0102030405060708ull, words);
+        CHECK(TotalYield::size == 4 && words[0] == 0x0102 && words[3] == 0x0708);
+        CHECK(TotalYield::decode(words, u64) && u64 == 0x0102030405060708ull);
+        SignedTotal::native_type s64;
+        SignedTotal::encode(SignedTotal::fromDouble(-0.5), words);
+        CHECK(words[0] == 0xffff && words[3] == 0xfffb);
+        CHECK(SignedTotal::decode(words, s64) && s64.raw == -5 && SignedTotal::toDouble(s64) == -0.5);
+        CHECK(!SignedTotal::isValid(SignedTotal::nan()) && !TotalYield::isValid(TotalYield::nan()));
+
+        // ENUM registers may use an enum type
+        TypedBmsMode::native_type mode;
+        TypedBmsMode::encode(BmsMode::Idle, words);
+        CHECK(words[0] == 0 && words[1] == 2953);
+        CHECK(TypedBmsMode::decode(words, mode) && mode == BmsMode::Idle);
+        CHECK(!TypedBmsMode::isValid(TypedBmsMode::nan()));
+    }
+
+    SmaModbusSimulator simulator(PORT);
+    simulator.addRange(UNIT_ID, 30001, 31300);
+    simulator.addRange(UNIT_ID, 40001, 44500);
+    if (!CHECK(simulator.start())) {
+        return SmaModbusTest::result();
+    }
+    SmaModbus device("127.0.0.1", PORT, UNIT_ID);
+
+    // typed reads and writes against a device
+    {
+        SmaModbusRegisters::Register30843::native_type current;
+        simulator.setWord(UNIT_ID, 30843, 0xffff);
+        simulator.setWord(UNIT_ID, 30844, (uint16_t)-2500);
+        CHECK(device.read<SmaModbusRegisters::Register30843>(current));
+        CHECK(current.raw == -2500 && current.toDouble() == -2.5);
+
+        SmaModbusRegisters::Register30233::native_type wmax = 0;
+        CHECK(device.read<SmaModbusRegisters::Register30233>(wmax));
+        CHECK(wmax == ((uint32_t)SmaModbusSimulator::getDefaultWord(UNIT_ID, 30233) << 16 | SmaModbusSimulator::getDefaultWord(UNIT_ID, 30234)));
+
+        CHECK(device.write<SmaModbusRegisters::Register44039>(SmaModbusRegisters::Register44039::fromDouble(87.65)));
+        CHECK(simulator.getWord(UNIT_ID, 44039) == 0 && simulator.getWord(UNIT_ID, 44040) == 8765);
+        CHECK(device.write<SmaModbusRegisters::Register40149>(-3000));
+        CHECK(simulator.getWord(UNIT_ID, 40149) == 0xffff && simulator.getWord(UNIT_ID, 40150) == (uint16_t)-3000);
+
+        BmsMode mode = BmsMode::Automatic;
+        CHECK(device.write<TypedBmsMode>(BmsMode::Idle));
+        CHECK(device.read<TypedBmsMode>(mode) && mode == BmsMode::Idle);
+    }
+
+    // the SMA NaN value, rejected reads and unreachable devices give the NaN value and false
+    {
+        SmaModbusRegisters::Register30843::native_type current(1);
+        simulator.setWord(UNIT_ID, 30843, 0x8000);
+        simulator.setWord(UNIT_ID, 30844, 0x0000);
+        CHECK(!device.read<SmaModbusRegisters::Register30843>(current));
+        CHECK(current == SmaModbusRegisters::Register30843::nan() && std::isnan(SmaModbusRegisters::Register30843::toDouble(current)));
+
+        Unmapped::native_type unmapped(1);
+        CHECK(!device.read<Unmapped>(unmapped));
+        CHECK(unmapped == Unmapped::nan() && std::isnan(Unmapped::toDouble(unmapped)));
+        CHECK(simulator.getStatistics().rejected > 0);
+
+        simulator.stop();
+        SmaModbusRegisters::Register30233::native_type wmax = 1;
+        CHECK(!device.read<SmaModbusRegisters::Register30233>(wmax));
+        CHECK(wmax == SmaModbusRegisters::Register30233::nan() && !SmaModbusRegisters::Register30233::isValid(wmax));
+        CHECK(!device.write<SmaModbusRegisters::Register44039>(SmaModbusRegisters::Register44039::fromDouble(1.0)));
+    }
+    return SmaModbusTest::result();
+}
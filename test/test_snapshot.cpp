@@ -0,0 +1,198 @@
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <SmaModbusSnapshot.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const size_t NUM_REGISTERS = 12;
+static const size_t NUM_READERS = 3;
+static const uint64_t NUM_PUBLICATIONS = 200000;
+
+
+// word j of publication g; register 1 is only read by even publications and keeps its words otherwise
+static uint16_t getWord(uint64_t generation, size_t j) {
+    return (uint16_t)(generation * 31u + j);
+}
+
+
+static SmaModbus::ReadPlan createPlan(void) {
+    SmaModbus::ReadPlan plan;
+    for (size_t i = 0; i < NUM_REGISTERS; ++i) {
+        const SmaModbus::RegisterDefinition& reg = SmaModbus::getRegisterCatalog()[i];
+        plan.registers.push_back(reg);
+        plan.unitIDs.push_back(SmaModbusUnitID::DEVICE_0);
+        plan.offsets.push_back(plan.words.size());
+        plan.words.resize(plan.words.size() + reg.size);
+        plan.valid.push_back(false);
+    }
+    return plan;
+}
+
+
+static void poll(SmaModbus::ReadPlan& plan, uint64_t generation) {
+    for (size_t i = 0; i < NUM_REGISTERS; ++i) {
+        plan.valid[i] = (i != 1 || (generation & 1) == 0);
+        for (size_t j = plan.offsets[i]; j < plan.offsets[i] + plan.registers[i].size; ++j) {
+            plan.words[j] = getWord(generation, j);
+        }
+    }
+}
+
+
+// check a view against the publication it claims to be; returns false for torn or stale words
+static bool checkView(const SmaModbus::ReadPlan& plan, const SmaModbusSnapshot::View& view, const uint16_t* words) {
+    const uint64_t generation = view.getGeneration();
+    for (size_t i = 0; i < NUM_REGISTERS; ++i) {
+        const uint64_t expected = (i == 1 ? generation & ~(uint64_t)1 : generation);
+        for (size_t j = plan.offsets[i]; j < plan.offsets[i] + plan.registers[i].size; ++j) {
+            if (expected != 0 && words[j] != getWord(expected, j)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+#ifndef _WIN32
+
+// corrupt a copy of the region header or register table, and check that open() rejects it
+template<typename Corrupt> static void checkCorruption(const char* name, const std::string& region_name, Corrupt corrupt) {
+    const int fd = shm_open(region_name.c_str(), O_RDWR, 0);
+    struct stat info;
+    if (!CHECK(fd >= 0 && fstat(fd, &info) == 0)) {
+        return;
+    }
+    uint8_t* region = (uint8_t*)mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (CHECK(region != MAP_FAILED)) {
+        std::vector<uint8_t> saved(region, region + info.st_size);
+        corrupt((SmaModbusSnapshot::Header*)region, (SmaModbusSnapshot::Entry*)((SmaModbusSnapshot::Header*)region + 1));
+        SmaModbusSnapshot reader;
+        const bool rejected = !reader.open(region_name);
+        printf("%s: %s\n", name, (rejected ? "rejected" : "accepted"));
+        CHECK(rejected);
+        memcpy(region, saved.data(), saved.size());
+        CHECK(reader.open(region_name));
+        munmap(region, (size_t)info.st_size);
+    }
+    ::close(fd);
+}
+
+#endif
+
+
+int main(int argc, char** argv) {
+    const std::string region_name = "/smamodbus_test_snapshot";
+    SmaModbus::ReadPlan plan = createPlan();
+    SmaModbusSnapshot publisher;
+    if (!CHECK(publisher.create(region_name, plan))) {
+        return SmaModbusTest::result();
+    }
+
+    // nothing has been published yet
+    {
+        SmaModbusSnapshot reader;
+        CHECK(reader.open(region_name));
+        CHECK(reader.getNumRegisters() == NUM_REGISTERS);
+        CHECK(reader.getRegister(3).addr == plan.registers[3].addr && reader.getRegister(3).type == plan.registers[3].type);
+        const SmaModbusSnapshot::View view = reader.getView();
+        CHECK(view.getGeneration() == 0 && view.getWords(0) == NULL && view.isConsistent());
+    }
+
+    // readers racing a publisher never see a consistent view with torn words, and generations never go backwards
+    {
+        std::atomic<bool> done(false);
+        std::atomic<uint64_t> num_consistent(0), num_inconsistent(0), num_torn(0), num_reversed(0);
+        std::vector<std::thread> readers;
+        for (size_t r = 0; r < NUM_READERS; ++r) {
+            readers.emplace_back([&] {
+                SmaModbusSnapshot reader;
+                if (!reader.open(region_name)) {
+                    ++num_torn;
+                    return;
+                }
+                std::vector<uint16_t> words(plan.words.size());
+                uint64_t last_generation = 0;
+                while (!done.load()) {
+                    const SmaModbusSnapshot::View view = reader.getView();
+                    if (view.getGeneration() == 0) {
+                        continue;
+                    }
+                    for (size_t i = 0; i < NUM_REGISTERS; ++i) {
+                        const uint16_t* source = view.getWords(i);
+                        std::copy(source, source + plan.registers[i].size, words.begin() + plan.offsets[i]);
+                    }
+                    if (!view.isConsistent()) {
+                        ++num_inconsistent;
+                        continue;
+                    }
+                    ++num_consistent;
+                    num_torn += (checkView(plan, view, words.data()) ? 0 : 1);
+                    num_reversed += (view.getGeneration() < last_generation ? 1 : 0);
+                    last_generation = view.getGeneration();
+                }
+            });
+        }
+        for (uint64_t generation = 1; generation <= NUM_PUBLICATIONS; ++generation) {
+            poll(plan, generation);
+            publisher.publish(plan);
+        }
+        done = true;
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        printf("%lu consistent views, %lu inconsistent views, %lu torn views\n", (unsigned long)num_consistent.load(),
+            (unsigned long)num_inconsistent.load(), (unsigned long)num_torn.load());
+        CHECK(num_consistent > 0);
+        CHECK(num_torn == 0);
+        CHECK(num_reversed == 0);
+
+        // registers not read by the last poll keep the words and timestamp of their last successful read
+        SmaModbusSnapshot reader;
+        CHECK(reader.open(region_name));
+        const SmaModbusSnapshot::View view = reader.getView();
+        CHECK(view.getGeneration() == NUM_PUBLICATIONS);
+        CHECK(view.getTimestamp(0) == view.getTimestamp() && view.getTimestamp(1) <= view.getTimestamp());
+        CHECK(view.getView(0).u64() == SmaModbusValue::joinWords(&plan.words[plan.offsets[0]], plan.registers[0].size));
+    }
+
+#ifndef _WIN32
+    // open() rejects regions with a corrupt header or register table, or truncated regions
+    checkCorruption("bad magic", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->magic ^= 1; });
+    checkCorruption("bad version", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->version += 1; });
+    checkCorruption("size beyond region", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->size += 4096 * 16; });
+    checkCorruption("bad register count", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->numRegisters = 0x10000000; });
+    checkCorruption("bad word count", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->numWords += 1024; });
+    checkCorruption("buffer overlapping table", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->bufferOffset[0] = 8; });
+    checkCorruption("misaligned buffer", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->bufferOffset[1] += 2; });
+    checkCorruption("buffer beyond region", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { header->bufferOffset[1] = header->size; });
+    checkCorruption("bad register offset", region_name, [](SmaModbusSnapshot::Header* header, SmaModbusSnapshot::Entry* entries) { entries[NUM_REGISTERS - 1].offset = header->numWords - 1; });
+
+    // truncate the region below its recorded size, then to zero; the publisher does not publish afterwards
+    const int fd = shm_open(region_name.c_str(), O_RDWR, 0);
+    if (CHECK(fd >= 0)) {
+        SmaModbusSnapshot reader;
+        CHECK(ftruncate(fd, (off_t)sizeof(SmaModbusSnapshot::Header)) == 0);
+        CHECK(!reader.open(region_name));
+        CHECK(ftruncate(fd, 16) == 0);
+        CHECK(!reader.open(region_name));
+        CHECK(ftruncate(fd, 0) == 0);
+        CHECK(!reader.open(region_name));
+        ::close(fd);
+    }
+#endif
+
+    publisher.close();
+    SmaModbusSnapshot reader;
+    CHECK(!reader.open(region_name));
+    return SmaModbusTest::result();
+}
@@ -0,0 +1,165 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+#include <chrono>
+#include <MB/modbusException.hpp>
+#include <SmaModbusSocket.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace MB;
+using namespace MB::utils;
+using namespace libsmamodbus;
+
+static const uint16_t PORT = 15609;
+static const uint16_t CLOSED_PORT = 15610;          // no listener, until the backlog is tested
+static const char* NON_ROUTABLE = "10.255.255.1";   // connects neither succeed nor get refused
+static const int CONNECT_TIMEOUT = 300;
+
+typedef std::chrono::steady_clock Clock;
+
+
+static int getIntOption(const SmaModbusSocket& socket, int level, int name) {
+    int value = -1;
+    socklen_t length = sizeof(value);
+    return (getsockopt(socket.getHandle(), level, name, (char*)&value, &length) == 0 ? value : -1);
+}
+
+
+// check the socket options of a connected socket against the given options
+static bool checkOptions(const SmaModbusSocket& socket, const SmaModbusSocket::Options& options) {
+    bool result = socket.isOpen();
+    result &= ((getIntOption(socket, IPPROTO_TCP, TCP_NODELAY) != 0) == options.noDelay);
+    result &= ((getIntOption(socket, SOL_SOCKET, SO_KEEPALIVE) != 0) == options.keepAlive);
+    if (options.keepAlive) {
+#if defined(TCP_KEEPIDLE)
+        result &= (getIntOption(socket, IPPROTO_TCP, TCP_KEEPIDLE) == options.keepAliveIdle);
+#endif
+#if defined(TCP_KEEPINTVL)
+        result &= (getIntOption(socket, IPPROTO_TCP, TCP_KEEPINTVL) == options.keepAliveInterval);
+#endif
+#if defined(TCP_KEEPCNT)
+        result &= (getIntOption(socket, IPPROTO_TCP, TCP_KEEPCNT) == options.keepAliveCount);
+#endif
+    }
+    if (options.receiveBufferSize > 0) {
+        result &= (getIntOption(socket, SOL_SOCKET, SO_RCVBUF) >= options.receiveBufferSize);
+    }
+    return result;
+}
+
+
+// connect to the given peer, return the time needed in milliseconds and whether the connect failed
+static long timeConnect(const char* peer, uint16_t port, int connect_timeout, bool& failed) {
+    SmaModbusSocket::Options options;
+    options.connectTimeout = connect_timeout;
+    SmaModbusSocket socket;
+    socket.setOptions(options);
+    const Clock::time_point start = Clock::now();
+    failed = false;
+    try {
+        socket.connect(peer, port);
+    }
+    catch (const ModbusException& ex) {
+        failed = (ex.getErrorCode() == MBErrorCode::ConnectionClosed);
+    }
+    return (long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+
+int main(int argc, char** argv) {
+    SmaModbusSocket server;
+    try {
+        server.listen("127.0.0.1", PORT);
+    }
+    catch (...) {
+        CHECK(false);
+        return SmaModbusTest::result();
+    }
+
+    // the options are applied to connected and to accepted sockets, and can be changed on an open connection
+    {
+        SmaModbusSocket::Options options;
+        options.keepAliveIdle = 45;
+        options.keepAliveInterval = 5;
+        options.keepAliveCount = 4;
+        options.receiveBufferSize = 65536;
+        SmaModbusSocket client;
+        client.setOptions(options);
+        client.connect("127.0.0.1", PORT);
+        SmaModbusSocket accepted;
+        CHECK(server.accept(accepted));
+        CHECK(checkOptions(client, options));
+        CHECK(checkOptions(accepted, SmaModbusSocket::Options()));
+
+        SmaModbusSocket::Options disabled;
+        disabled.noDelay = false;
+        disabled.keepAlive = false;
+        client.setOptions(disabled);
+        CHECK(checkOptions(client, disabled));
+        CHECK(getIntOption(client, IPPROTO_TCP, TCP_NODELAY) == 0 && getIntOption(client, SOL_SOCKET, SO_KEEPALIVE) == 0);
+
+        // the receive timeout of sockets read without polling
+        options.timeout = 1500;
+        CHECK(SmaModbusSocket::applyOptions(accepted.getHandle(), options, true));
+#ifndef _WIN32
+        struct timeval timeout = {};
+        socklen_t length = sizeof(timeout);
+        CHECK(getsockopt(accepted.getHandle(), SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, &length) == 0);
+        CHECK(timeout.tv_sec == 1 && timeout.tv_usec == 500000);
+#endif
+
+        // a receive without data times out after the socket timeout
+        accepted.setTimeout(200);
+        uint8_t byte = 0;
+        const Clock::time_point start = Clock::now();
+        bool timed_out = false;
+        try {
+            accepted.receive(&byte, 1);
+        }
+        catch (const ModbusException& ex) {
+            timed_out = (ex.getErrorCode() == MBErrorCode::Timeout);
+        }
+        const long elapsed = (long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+        printf("receive timeout after %ld ms\n", elapsed);
+        CHECK(timed_out && elapsed >= 150 && elapsed < 1000);
+
+        // options cannot be applied to a closed socket
+        const SmaModbusSocket::SocketHandle handle = client.getHandle();
+        client.close();
+        CHECK(!SmaModbusSocket::applyOptions(handle, options));
+    }
+
+    // connects to a closed port fail at once; connects to a non-routable address fail within the connect timeout
+    {
+        bool failed = false;
+        long elapsed = timeConnect("127.0.0.1", CLOSED_PORT, CONNECT_TIMEOUT, failed);
+        printf("connect to closed port failed after %ld ms\n", elapsed);
+        CHECK(failed && elapsed < CONNECT_TIMEOUT);
+
+        elapsed = timeConnect(NON_ROUTABLE, PORT, CONNECT_TIMEOUT, failed);
+        printf("connect to non-routable address failed after %ld ms\n", elapsed);
+        CHECK(failed && elapsed < CONNECT_TIMEOUT + 700);
+    }
+
+    // a listener that never accepts drops connects once its backlog is full, such that they fail after the connect timeout,
+    // independent of the network the test runs in
+    {
+        SmaModbusSocket listener;
+        listener.listen("127.0.0.1", CLOSED_PORT, 0);
+        bool failed = false;
+        long elapsed = 0;
+        for (size_t i = 0; i < 8 && !failed; ++i) {
+            elapsed = timeConnect("127.0.0.1", CLOSED_PORT, CONNECT_TIMEOUT, failed);
+        }
+        printf("connect to full backlog failed after %ld ms\n", elapsed);
+        CHECK(failed && elapsed >= CONNECT_TIMEOUT - 50 && elapsed < CONNECT_TIMEOUT + 700);
+    }
+    return SmaModbusTest::result();
+}
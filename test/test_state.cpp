@@ -0,0 +1,154 @@
+#include <cstdio>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <SmaModbus.hpp>
+#include <SmaModbusSimulator.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const uint16_t PORT = 15606;
+static const SmaModbusUnitID UNIT_ID = SmaModbusUnitID::DEVICE_0;
+static const char* PATH = "test_state.state";
+static const char* CORRUPT_PATH = "test_state.corrupt";
+
+// registers on both sides of a hole from 30061 to 30081 of the simulated register map
+static const uint16_t ADDRESSES[] = { 30001, 30003, 30051, 30059, 30081, 30099 };
+
+
+static std::vector<SmaModbus::RegisterDefinition> createRegisters(size_t num_registers) {
+    std::vector<SmaModbus::RegisterDefinition> registers;
+    for (size_t i = 0; i < num_registers; ++i) {
+        registers.push_back(SmaModbus::RegisterDefinition(ADDRESSES[i], 2, DataType::U32, DataFormat::RAW,
+            SmaModbus::AccessMode::RO, SmaModbus::Category::Normal, "Test.State"));
+    }
+    return registers;
+}
+
+
+static std::string readFile(const char* path) {
+    std::string content;
+    FILE* file = fopen(path, "r");
+    if (file != NULL) {
+        char buffer[256];
+        size_t n = 0;
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            content.append(buffer, n);
+        }
+        fclose(file);
+    }
+    return content;
+}
+
+
+// load a copy of the saved state with the first occurrence of the given text replaced
+static bool loadCorrupted(const std::string& state, const std::string& text, const std::string& replacement) {
+    std::string content = state;
+    const size_t position = content.find(text);
+    if (!CHECK(position != std::string::npos)) {
+        return true;
+    }
+    content.replace(position, text.size(), replacement);
+    FILE* file = fopen(CORRUPT_PATH, "w");
+    fwrite(content.data(), 1, content.size(), file);
+    fclose(file);
+
+    SmaModbus device("127.0.0.1", PORT, UNIT_ID);
+    SmaModbus::ReadPlan plan = device.createReadPlan(createRegisters(6));
+    bool restored = true;
+    const bool result = device.loadState(CORRUPT_PATH, &plan, &restored);
+    CHECK(result || (!restored && device.getNameplate().serialNumber == 0));
+    return result;
+}
+
+
+int main(int argc, char** argv) {
+    SmaModbusSimulator simulator(PORT);
+    simulator.addRange(UNIT_ID, 30001, 30061);
+    simulator.addRange(UNIT_ID, 30081, 30101);
+    if (!CHECK(simulator.start())) {
+        return SmaModbusTest::result();
+    }
+
+    // discover the device and refine a read plan, then save the state
+    SmaModbus discovered("127.0.0.1", PORT, UNIT_ID);
+    const SmaModbus::Nameplate nameplate = discovered.readNameplate();
+    CHECK(nameplate.serialNumber != 0);
+    SmaModbus::ReadPlan saved_plan = discovered.createReadPlan(createRegisters(6));
+    discovered.readRegisters(saved_plan);
+    CHECK(saved_plan.blocks.size() == 3);
+    CHECK(discovered.saveState(PATH, &saved_plan));
+    const std::string state = readFile(PATH);
+    CHECK(state.compare(0, 18, "smamodbus-state 2\n") == 0);
+
+    // a restart restores the nameplate, the device limits and the refined blocks; polls are not rejected anymore
+    {
+        SmaModbus device("127.0.0.1", PORT, UNIT_ID);
+        SmaModbus::ReadPlan plan = device.createReadPlan(createRegisters(6));
+        CHECK(plan.blocks.size() == 1);
+        bool restored = false;
+        CHECK(device.loadState(PATH, &plan, &restored));
+        CHECK(restored);
+        CHECK(device.getUnitID() == UNIT_ID);
+        CHECK(device.getNameplate().serialNumber == nameplate.serialNumber && device.getNameplate().packageRevision == nameplate.packageRevision);
+        CHECK(device.getDeviceLimits().isUnreadable(UNIT_ID, 30001, 100) && device.getDeviceLimits().isReadable(UNIT_ID, 30001, 52));
+        CHECK(plan.blocks.size() == saved_plan.blocks.size());
+        for (size_t i = 0; i < plan.blocks.size() && i < saved_plan.blocks.size(); ++i) {
+            CHECK(plan.blocks[i].addr == saved_plan.blocks[i].addr && plan.blocks[i].size == saved_plan.blocks[i].size &&
+                  plan.blocks[i].first == saved_plan.blocks[i].first && plan.blocks[i].count == saved_plan.blocks[i].count);
+        }
+        const uint64_t rejected = simulator.getStatistics().rejected;
+        device.readRegisters(plan);
+        CHECK(std::count(plan.valid.begin(), plan.valid.end(), true) == 6);
+        CHECK(simulator.getStatistics().rejected == rejected);
+    }
+
+    // a plan of other registers keeps its blocks, and the caller learns that they have not been restored
+    {
+        SmaModbus device("127.0.0.1", PORT, UNIT_ID);
+        SmaModbus::ReadPlan plan = device.createReadPlan(createRegisters(5));
+        const size_t num_blocks = plan.blocks.size();
+        bool restored = true;
+        CHECK(device.loadState(PATH, &plan, &restored));
+        CHECK(!restored);
+        CHECK(plan.blocks.size() == num_blocks);
+        CHECK(device.getNameplate().serialNumber == nameplate.serialNumber);
+
+        SmaModbus::ReadPlan other_units = device.createReadPlan(createRegisters(6), std::vector<SmaModbusUnitID>(6, (SmaModbusUnitID)4));
+        CHECK(device.loadState(PATH, &other_units, &restored));
+        CHECK(!restored);
+    }
+
+    // the state of another device, i.e. with a different serial number, is rejected
+    {
+        const uint16_t word = simulator.getWord(UNIT_ID, 30006);
+        simulator.setWord(UNIT_ID, 30006, (uint16_t)(word + 1));
+        SmaModbus device("127.0.0.1", PORT, UNIT_ID);
+        SmaModbus::ReadPlan plan = device.createReadPlan(createRegisters(6));
+        bool restored = true;
+        CHECK(!device.loadState(PATH, &plan, &restored));
+        CHECK(!restored && plan.blocks.size() == 1);
+        CHECK(device.getNameplate().serialNumber == 0 && device.getDeviceLimits().getUnreadableSpans().empty());
+        simulator.setWord(UNIT_ID, 30006, word);
+    }
+
+    // corrupt or outdated files are rejected as a whole
+    {
+        const std::string first_block = "block 3 30001 52 0 3\n";
+        CHECK(!loadCorrupted(state, first_block, "block 3 30001 52 0 4\n"));     // overlaps the next block
+        CHECK(!loadCorrupted(state, first_block, "block 3 30001 52 0 2\n"));     // leaves a register uncovered
+        CHECK(!loadCorrupted(state, first_block, "block 3 30003 50 0 3\n"));     // starts after its first register
+        CHECK(!loadCorrupted(state, first_block, "block 3 30001 50 0 3\n"));     // ends before its last register
+        CHECK(!loadCorrupted(state, first_block, "block 3 30001 200 0 3\n"));    // exceeds the maximum read size
+        CHECK(!loadCorrupted(state, first_block, "block 4 30001 52 0 3\n"));     // other unit id
+        CHECK(!loadCorrupted(state, first_block, "block 3 30001\n"));            // truncated
+        CHECK(!loadCorrupted(state, first_block, ""));                           // missing
+        CHECK(!loadCorrupted(state, "register 30001 3\n", "register 30001\n"));  // register without unit id
+        CHECK(!loadCorrupted(state, "smamodbus-state 2\n", "smamodbus-state 1\n"));
+        CHECK(loadCorrupted(state, "limits\n", "limits\n"));                    // unchanged
+    }
+    remove(PATH);
+    remove(CORRUPT_PATH);
+    return SmaModbusTest::result();
+}
@@ -0,0 +1,214 @@
+#include <map>
+#include <vector>
+#include <SmaModbus.hpp>
+#include <SmaModbusSimulator.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const uint16_t PORT = 15602;
+static const uint8_t UNIT_ID = SmaModbusUnitID::DEVICE_0;
+static const uint32_t FIRST = 30000;    // even, i.e. not on the register grid
+static const uint32_t END = 31000;
+
+// readable ranges of the simulated register map; all other addresses are rejected
+static const uint32_t RANGES[][2] = { { 30001, 30061 }, { 30193, 30235 }, { 30843, 30869 }, { 30955, 30957 } };
+
+// registers around Register40236(), which starts at an even address, off the register grid
+static const uint32_t OFF_GRID_RANGES[][2] = { { 40229, 40235 }, { 40236, 40238 }, { 40239, 40243 } };
+
+typedef std::map<uint16_t, uint16_t> WordMap;
+
+
+static bool isMapped(uint32_t addr, uint32_t size) {
+    for (const auto& range : RANGES) {
+        if (addr >= range[0] && addr + size <= range[1]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// run a sweep from the given cursor to its end, collecting the words; interrupted sweeps are resumed from a copy of the
+// cursor on a new connection, as a restarted process would do with a saved cursor
+static WordMap sweep(SmaModbus::SweepCursor& cursor, uint64_t max_requests, size_t max_runs_per_call, size_t& num_calls, size_t& num_duplicates) {
+    WordMap words;
+    num_calls = 0;
+    num_duplicates = 0;
+    while (!cursor.isDone() && num_calls < 1000) {
+        SmaModbus device("127.0.0.1", PORT, (SmaModbusUnitID)UNIT_ID);
+        SmaModbus::SweepCursor saved = cursor;
+        size_t num_runs = 0;
+        device.sweepRegisters(saved, [&](SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* run, size_t num_words) {
+            for (size_t i = 0; i < num_words; ++i) {
+                num_duplicates += words.count((uint16_t)(addr + i));
+                words[(uint16_t)(addr + i)] = run[i];
+            }
+            return (max_runs_per_call == 0 || ++num_runs < max_runs_per_call);
+        }, max_requests);
+        cursor = saved;
+        ++num_calls;
+    }
+    return words;
+}
+
+
+static void checkWords(const WordMap& words) {
+    size_t num_expected = 0;
+    size_t num_wrong = 0;
+    for (uint32_t addr = FIRST; addr <= END; ++addr) {
+        if (isMapped(addr, 1)) {
+            ++num_expected;
+            auto it = words.find((uint16_t)addr);
+            num_wrong += (it == words.end() || it->second != SmaModbusSimulator::getDefaultWord(UNIT_ID, (uint16_t)addr) ? 1 : 0);
+        }
+    }
+    CHECK(words.size() == num_expected);
+    CHECK(num_wrong == 0);
+}
+
+
+int main(int argc, char** argv) {
+    SmaModbusSimulator simulator(PORT);
+    for (const auto& range : RANGES) {
+        simulator.addRange(UNIT_ID, range[0], range[1]);
+    }
+    for (const auto& range : OFF_GRID_RANGES) {
+        simulator.addRange(UNIT_ID, range[0], range[1]);
+    }
+    simulator.setAligned(true);
+    if (!CHECK(simulator.start())) {
+        return SmaModbusTest::result();
+    }
+    size_t num_mapped = 0;
+    for (const auto& range : RANGES) {
+        num_mapped += range[1] - range[0];
+    }
+
+    // a sweep from an even start address is aligned to the register grid; rejected blocks are bisected down to single registers
+    {
+        SmaModbus device("127.0.0.1", PORT, (SmaModbusUnitID)UNIT_ID);
+        SmaModbus::SweepCursor cursor((SmaModbusUnitID)UNIT_ID, FIRST, END);
+        WordMap words;
+        size_t num_duplicates = 0;
+        CHECK(device.sweepRegisters(cursor, [&](SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* run, size_t num_words) {
+            CHECK(unit_id == UNIT_ID);
+            CHECK((addr & 1) == 1 && (num_words & 1) == 0);
+            for (size_t i = 0; i < num_words; ++i) {
+                num_duplicates += words.count((uint16_t)(addr + i));
+                words[(uint16_t)(addr + i)] = run[i];
+            }
+            return true;
+        }));
+        printf("full sweep: %lu requests, %lu words read, %lu words rejected\n", (unsigned long)cursor.requests,
+            (unsigned long)cursor.wordsRead, (unsigned long)cursor.wordsRejected);
+        checkWords(words);
+        CHECK(num_duplicates == 0);
+        CHECK(cursor.isDone());
+        CHECK(cursor.wordsRead == num_mapped);
+        CHECK(cursor.wordsRead + cursor.wordsRejected == END - FIRST);     // the last register 30999 ends at END + 1
+        CHECK(simulator.getStatistics().reads + simulator.getStatistics().rejected == cursor.requests);
+
+        // the first block spans a hole and has been bisected; the learned limits reflect this
+        CHECK(device.getDeviceLimits().isUnreadable(UNIT_ID, (uint16_t)(FIRST + 1), 124));
+        CHECK(device.getDeviceLimits().isReadable(UNIT_ID, 30001, 30));
+    }
+
+    // a sweep resumed from saved cursors after request limits and sink interruptions yields the same words exactly once
+    {
+        SmaModbus::SweepCursor cursor((SmaModbusUnitID)UNIT_ID, FIRST, END);
+        size_t num_calls = 0;
+        size_t num_duplicates = 0;
+        WordMap words = sweep(cursor, 7, 2, num_calls, num_duplicates);
+        printf("resumed sweep: %lu calls, %lu requests\n", (unsigned long)num_calls, (unsigned long)cursor.requests);
+        checkWords(words);
+        CHECK(num_duplicates == 0);
+        CHECK(num_calls > 10);
+        CHECK(cursor.wordsRead == num_mapped);
+    }
+
+    // connection drops interrupt the sweep, which completes when resumed
+    {
+        SmaModbusSimulator::Faults faults;
+        faults.dropRate = 0.05;
+        simulator.setFaults(faults);
+        SmaModbus::SweepCursor cursor((SmaModbusUnitID)UNIT_ID, FIRST, END);
+        size_t num_calls = 0;
+        size_t num_duplicates = 0;
+        WordMap words = sweep(cursor, 0, 0, num_calls, num_duplicates);
+        printf("sweep with faults: %lu calls, %lu drops\n", (unsigned long)num_calls, (unsigned long)simulator.getStatistics().drops);
+        checkWords(words);
+        CHECK(num_duplicates == 0);
+        CHECK(simulator.getStatistics().drops > 0);
+        simulator.setFaults(SmaModbusSimulator::Faults());
+    }
+
+    // registers of the register catalog are decoded from the sweep
+    {
+        SmaModbus device("127.0.0.1", PORT, (SmaModbusUnitID)UNIT_ID);
+        SmaModbus::SweepCursor cursor((SmaModbusUnitID)UNIT_ID, FIRST, END);
+        std::vector<uint16_t> found;
+        CHECK(device.sweepKnownRegisters(cursor, [&](SmaModbusUnitID unit_id, const SmaModbus::RawRegisterView& view) {
+            const SmaModbus::RegisterDefinition& reg = view.getRegister();
+            CHECK(SmaModbus::findRegister(reg.addr) == &reg);
+            uint64_t expected = 0;
+            for (size_t i = 0; i < reg.size; ++i) {
+                expected = (expected << 16) | SmaModbusSimulator::getDefaultWord(UNIT_ID, (uint16_t)(reg.addr + i));
+            }
+            CHECK(view.u64() == expected);
+            found.push_back(reg.addr);
+            return true;
+        }));
+        std::vector<uint16_t> expected;
+        for (const SmaModbus::RegisterDefinition& reg : SmaModbus::getRegisterCatalog()) {
+            if (reg.addr >= FIRST && reg.addr < END && isMapped(reg.addr, reg.size)) {
+                expected.push_back(reg.addr);
+            }
+        }
+        printf("catalog registers found: %lu of %lu\n", (unsigned long)found.size(), (unsigned long)SmaModbus::getRegisterCatalog().size());
+        CHECK(found == expected);
+        CHECK(found.size() == 15);
+        CHECK(SmaModbus::findRegister(30233) != NULL && SmaModbus::findRegister(30233)->identifier == "Inverter.WMax");
+        CHECK(SmaModbus::findRegister(30234) == NULL);
+    }
+
+    // a catalog register at an even address is read on its own, between registers on the register grid
+    {
+        SmaModbus device("127.0.0.1", PORT, (SmaModbusUnitID)UNIT_ID);
+        SmaModbus::SweepCursor cursor((SmaModbusUnitID)UNIT_ID, 40200, 40300);
+        WordMap words;
+        CHECK(device.sweepRegisters(cursor, [&](SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* run, size_t num_words) {
+            CHECK(((addr & 1) == 1 || addr == 40236) && (num_words & 1) == 0);
+            for (size_t i = 0; i < num_words; ++i) {
+                words[(uint16_t)(addr + i)] = run[i];
+            }
+            return true;
+        }));
+        size_t num_expected = 0;
+        for (const auto& range : OFF_GRID_RANGES) {
+            for (uint32_t addr = range[0]; addr < range[1]; ++addr, ++num_expected) {
+                CHECK(words.count((uint16_t)addr) == 1 && words[(uint16_t)addr] == SmaModbusSimulator::getDefaultWord(UNIT_ID, (uint16_t)addr));
+            }
+        }
+        CHECK(words.size() == num_expected);
+
+        SmaModbus::SweepCursor known((SmaModbusUnitID)UNIT_ID, 40200, 40300);
+        std::vector<uint16_t> found;
+        CHECK(device.sweepKnownRegisters(known, [&](SmaModbusUnitID unit_id, const SmaModbus::RawRegisterView& view) {
+            found.push_back(view.getRegister().addr);
+            CHECK(view.u64() == ((uint64_t)SmaModbusSimulator::getDefaultWord(UNIT_ID, 40236) << 16 | SmaModbusSimulator::getDefaultWord(UNIT_ID, 40237)));
+            return true;
+        }));
+        CHECK(found.size() == 1 && found[0] == 40236);
+    }
+
+    // blocks near the end of the address space stay even sized, and a sweep to the last address terminates
+    {
+        SmaModbus device("127.0.0.1", PORT, (SmaModbusUnitID)UNIT_ID);
+        SmaModbus::SweepCursor cursor((SmaModbusUnitID)UNIT_ID, 0xfff0, 0x10000);
+        CHECK(device.sweepRegisters(cursor, [&](SmaModbusUnitID unit_id, uint16_t addr, const uint16_t* run, size_t num_words) { return true; }));
+        CHECK(cursor.isDone() && cursor.wordsRead == 0 && cursor.wordsRejected == 14);
+    }
+    return SmaModbusTest::result();
+}
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <SmaModbusTrace.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const size_t NUM_THREADS = 64;
+static const size_t NUM_CONCURRENT = 8;
+
+
+// buffers of finished threads are reused, and exports running concurrently with recording never see torn spans
+int main(int argc, char** argv) {
+    SmaModbusTrace::setEnabled(true);
+
+    // threads recording in batches allocate buffers for one batch only; the threads of a batch record at the same time
+    for (size_t batch = 0; batch < NUM_THREADS / NUM_CONCURRENT; ++batch) {
+        std::vector<std::thread> threads;
+        std::atomic<size_t> num_started(0);
+        for (size_t i = 0; i < NUM_CONCURRENT; ++i) {
+            threads.push_back(std::thread([&num_started] {
+                SmaModbusTrace::record("batch", 0, 1);
+                ++num_started;
+                while (num_started < NUM_CONCURRENT) {
+                    std::this_thread::yield();
+                }
+            }));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    printf("%lu buffers for %lu threads\n", (unsigned long)SmaModbusTrace::getNumBuffers(), (unsigned long)NUM_THREADS);
+    CHECK(SmaModbusTrace::getNumBuffers() == NUM_CONCURRENT);
+    SmaModbusTrace::clear();
+
+    // every recorded span lasts exactly 1 ns; a span mixing fields of two records would have a different duration
+    std::atomic<bool> running(true);
+    std::thread writer([&running] {
+        for (uint64_t j = 0; running; j += 1000) {
+            SmaModbusTrace::record("span", j, j + 1);
+        }
+    });
+    const char* path = "test_trace.json";
+    size_t num_spans = 0;
+    size_t num_torn = 0;
+    for (size_t i = 0; i < 50; ++i) {
+        CHECK(SmaModbusTrace::writeChromeTrace(path));
+        FILE* file = fopen(path, "r");
+        if (!CHECK(file != NULL)) {
+            break;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), file) != NULL) {
+            if (strstr(line, "\"name\":\"span\"") != NULL) {
+                ++num_spans;
+                num_torn += (strstr(line, "\"dur\":0.001}") == NULL ? 1 : 0);
+            }
+        }
+        fclose(file);
+    }
+    running = false;
+    writer.join();
+    remove(path);
+    printf("%lu spans exported, %lu torn\n", (unsigned long)num_spans, (unsigned long)num_torn);
+    CHECK(num_spans > 0);
+    CHECK(num_torn == 0);
+    return SmaModbusTest::result();
+}
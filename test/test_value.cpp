@@ -0,0 +1,80 @@
+#include <cstring>
+#include <random>
+#include <SmaModbusValueOracle.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const size_t NUM_RANDOM_INPUTS = 1000000;
+
+
+// build an input from a data type, a data format, a register bit pattern and a double
+static SmaModbusValueOracle::Input makeInput(DataType type, DataFormat format, uint64_t bits, double value) {
+    uint8_t data[18];
+    data[0] = (uint8_t)type;
+    data[1] = (uint8_t)((uint8_t)format - 1);
+    for (size_t i = 0; i < 8; ++i) {
+        data[2 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    memcpy(data + 10, &value, sizeof(double));
+    return SmaModbusValueOracle::decodeInput(data, sizeof(data));
+}
+
+
+// compare SmaModbusValue against the reference implementation for every data type and data format, using edge cases and
+// random inputs; the same comparison is run by fuzz_value on fuzzer generated inputs
+int main(int argc, char** argv) {
+    const uint64_t edge_bits[] = {
+        0, 1, 9, 10, 99999, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000, 0x80000001, 0xfffffffe, 0xffffffff, 0x00fffffd,
+        0x00fffffe, 0x100000000, 0x1fffffffffffff, 0x20000000000001, 0x7fffffffffffffff, 0x8000000000000000,
+        0x8000000000000001, 0xfffffffffffffffe, 0xffffffffffffffff, 0xffffffff80000000, 0xffffffff00000000
+    };
+    const double edge_values[] = {
+        0.0, -0.0, 0.3, -0.3, 0.5, -0.5, 0.49999999999999994, -0.49999999999999994, 1.5, -1.5, 2.5, -2.5,
+        0.05, 0.15, 1.005, 123.4567, -123.4567, 4294967294.4, 4294967294.5, 4294967295.0, 4294967296.0,
+        2147483647.4, 2147483647.5, -2147483647.5, -2147483648.0, -2147483648.5, 16777213.0,
+        9007199254740993.0, 9223372036854775807.0, -9223372036854775808.0, 18446744073709549568.0, 18446744073709551616.0,
+        1e300, -1e300, INFINITY, -INFINITY, NAN, -NAN, 4.9e-324
+    };
+
+    size_t num_checks = 0;
+    std::string failure;
+    for (uint8_t t = 0; t <= (uint8_t)DataType::STR32; ++t) {
+        for (uint8_t f = (uint8_t)DataFormat::FIX0; f <= (uint8_t)DataFormat::FIRMWARE; ++f) {
+            for (uint64_t bits : edge_bits) {
+                for (double value : edge_values) {
+                    ++num_checks;
+                    if (!SmaModbusValueOracle::check(makeInput((DataType)t, (DataFormat)f, bits, value), failure)) {
+                        CHECK(failure.empty());
+                        printf("  %s\n", failure.c_str());
+                        failure.clear();
+                    }
+                }
+            }
+        }
+    }
+
+    // random bit patterns, random doubles and random doubles of register magnitude, e.g. scaled power values
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> magnitude(-5e9, 5e9);
+    size_t num_failures = 0;
+    for (size_t i = 0; i < NUM_RANDOM_INPUTS; ++i) {
+        uint8_t data[18];
+        const uint64_t bits[3] = { random(), random(), random() };
+        memcpy(data, bits, sizeof(data));
+        if ((i & 1) != 0) {
+            const double value = magnitude(random) / (double)(1u << (i % 16));
+            memcpy(data + 10, &value, sizeof(double));
+        }
+        ++num_checks;
+        if (!SmaModbusValueOracle::check(SmaModbusValueOracle::decodeInput(data, sizeof(data)), failure) && ++num_failures <= 10) {
+            CHECK(failure.empty());
+            printf("  %s\n", failure.c_str());
+            failure.clear();
+        }
+    }
+    CHECK(num_failures == 0);
+
+    printf("%lu inputs checked\n", (unsigned long)num_checks);
+    return SmaModbusTest::result();
+}
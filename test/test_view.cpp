@@ -0,0 +1,60 @@
+#include <cmath>
+#include <string>
+#include <SmaModbus.hpp>
+#include <SmaModbusTest.hpp>
+
+using namespace libsmamodbus;
+
+static const uint16_t STRING_WORDS[16] = { 0x5342, 0x5333, 0x2e37, 0x2d31, 0x3000 };     // "SBS3.7-10" and '\0' padding
+
+
+static void addRegister(SmaModbus::ReadPlan& plan, const SmaModbus::RegisterDefinition& reg, const uint16_t* words, bool valid) {
+    plan.registers.push_back(reg);
+    plan.unitIDs.push_back(SmaModbusUnitID::DEVICE_0);
+    plan.offsets.push_back(plan.words.size());
+    plan.words.insert(plan.words.end(), words, words + reg.size);
+    plan.valid.push_back(valid);
+}
+
+
+int main(int argc, char** argv) {
+    static const uint16_t current[2] = { 0xffff, (uint16_t)-1234 };
+    SmaModbus::ReadPlan plan;
+    addRegister(plan, SmaModbus::Register30843(), current, true);
+    addRegister(plan, SmaModbus::Register30857(), current, false);
+    addRegister(plan, SmaModbus::RegisterDefinition(40631, 16, DataType::STR32, DataFormat::UTF8, SmaModbus::AccessMode::RW,
+        SmaModbus::Category::Normal, "Nameplate.Location"), STRING_WORDS, true);
+
+    // views decode lazily from the words of the plan, i.e. a view reflects the words at the time of access
+    {
+        const SmaModbus::RawRegisterView view = plan.getView(0);
+        CHECK(view.getWords() == &plan.words[plan.offsets[0]] && view.getNumWords() == 2);
+        CHECK(view.isNumeric() && view.isValid() && view.u64() == 0xfffffb2e && view.toDouble() == -1.234 && view.toString() == "-1.234");
+        plan.words[plan.offsets[0] + 1] = 80;
+        CHECK(view.u64() == 0xffff0050 && view.toValue().u64 == 0xffff0050);
+        plan.words[plan.offsets[0]] = 0x8000;
+        plan.words[plan.offsets[0] + 1] = 0x0000;
+        CHECK(view.isNumeric() && !view.isValid() && std::isnan(view.toDouble()) && view.toString() == "NaN");
+    }
+
+    // registers that could not be read have no words, are not numeric and decode to invalid values
+    {
+        const SmaModbus::RawRegisterView view = plan.getView(1);
+        CHECK(view.getWords() == NULL && view.getNumWords() == 0);
+        CHECK(!view.isNumeric() && !view.isValid() && view.u64() == 0 && std::isnan(view.toDouble()));
+        CHECK(view.toValue().type == DataType::INVALID && view.str().empty() && view.toString() == "NaN");
+    }
+
+    // STR32 registers are not numeric; str() keeps the '\0' padding of the register
+    {
+        const SmaModbus::RawRegisterView view = plan.getView(2);
+        CHECK(view.getNumWords() == 16 && !view.isNumeric() && !view.isValid() && view.u64() == 0 && std::isnan(view.toDouble()));
+        CHECK(view.str().size() == 32 && view.str().compare(0, 10, "SBS3.7-10\0", 10) == 0 && view.str()[31] == '\0');
+        CHECK(view.toValue().type == DataType::STR32 && view.toValue().str == view.str() && view.toString() == view.str());
+
+        // a STR32 register that could not be read
+        plan.valid[2] = false;
+        CHECK(plan.getView(2).str().empty() && plan.getView(2).toValue().type == DataType::INVALID);
+    }
+    return SmaModbusTest::result();
+}